@@ -109,6 +109,7 @@ class Igor : Program
         input_vcf_files.push_back(l000g_vcf_file);
         sr = new BCFSyncedReader(input_vcf_files, intervals, false);
         odw = new BCFOrderedWriter(output_vcf_file);
+        odw->enable_index();
         odw->link_hdr(sr->hdrs[0]);
         bcf_hdr_append(sr->hdrs[0], "##INFO=<ID=1000G,Number=0,Type=Flag,Description=\"1000 Genomes variant\">");
         odw->write_hdr();
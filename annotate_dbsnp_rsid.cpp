@@ -109,6 +109,7 @@ class Igor : Program
         input_vcf_files.push_back(dbsnp_vcf_file);
         sr = new BCFSyncedReader(input_vcf_files, intervals, false);
         odw = new BCFOrderedWriter(output_vcf_file);
+        odw->enable_index();
         odw->link_hdr(sr->hdrs[0]);
         odw->write_hdr();
 
@@ -168,7 +168,9 @@ class Igor : Program
         //i/o initialization//
         //////////////////////
         odr = new BCFOrderedReader(input_vcf_file, intervals);
+        if (get_n_hts_threads()>1) odr->enable_prefetch(BCF_UN_INFO);
         odw = new BCFOrderedWriter(output_vcf_file, 10000);
+        odw->enable_index();
         odw->link_hdr(odr->hdr);
 
         //////////////////////////////
@@ -236,6 +238,7 @@ class Igor : Program
         vm = new VariantManip(ref_fasta_file);
         va = new VNTRAnnotator(ref_fasta_file, debug);
         rs = new ReferenceSequence(ref_fasta_file);
+        rs->set_streaming(true);
     }
 
     void print_options()
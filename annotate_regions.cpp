@@ -43,6 +43,7 @@ class Igor : Program
     std::string regions_file;
     std::string REGIONS_TAG;
     std::string REGIONS_TAG_DESC;
+    std::string tmp_dir;
     uint32_t left_window; 
     uint32_t right_window;
     bool use_bed;
@@ -63,8 +64,8 @@ class Igor : Program
     /////////
     //stats//
     /////////
-    int32_t no_variants_annotated;
-    int32_t no_variants;
+    std::atomic<int32_t> no_variants_annotated;
+    std::atomic<int32_t> no_variants;
 
     ////////////////
     //common tools//
@@ -73,6 +74,15 @@ class Igor : Program
     OrderedRegionOverlapMatcher *orom_regions;
     OrderedBCFOverlapMatcher *obom_regions;
 
+    ////////////////
+    //worker tools//
+    ////////////////
+    //tools of the workers of process_chunks(), reused across the chunks of a worker
+    std::vector<VariantManip*> worker_vms;
+    std::vector<Filter*> worker_filters;
+    std::vector<OrderedRegionOverlapMatcher*> worker_orom_regions;
+    std::vector<OrderedBCFOverlapMatcher*> worker_obom_regions;
+
     Igor(int argc, char **argv)
     {
         version = "0.5";
@@ -95,6 +105,8 @@ class Igor : Program
             TCLAP::ValueArg<std::string> arg_fexp("f", "f", "filter expression []", false, "", "str", cmd);
             TCLAP::ValueArg<uint32_t> arg_left_window("l", "l", "left window size for overlap []", false, 0, "int", cmd);
             TCLAP::ValueArg<uint32_t> arg_right_window("r", "r", "right window size for overlap []", false, 0, "int", cmd);
+            TCLAP::ValueArg<std::string> arg_tmp_dir("T", "tmp-dir", "directory for temporary files of --threads, by default beside the output file\n"
+                 "              or in $TMPDIR if the output is the standard output []", false, "", "str", cmd);
             TCLAP::UnlabeledValueArg<std::string> arg_input_vcf_file("<in.vcf>", "input VCF file", true, "","file", cmd);
 
             cmd.parse(argc, argv);
@@ -108,6 +120,7 @@ class Igor : Program
             right_window = arg_right_window.getValue();
             REGIONS_TAG = arg_REGIONS_TAG.getValue();
             REGIONS_TAG_DESC = arg_REGIONS_TAG_DESC.getValue();            
+            tmp_dir = arg_tmp_dir.getValue();
         }
         catch (TCLAP::ArgException &e)
         {
@@ -125,6 +138,7 @@ class Igor : Program
         ////////////////////
         odr = new BCFOrderedReader(input_vcf_file, intervals);
         odw = new BCFOrderedWriter(output_vcf_file);
+        odw->enable_index();
         odw->link_hdr(odr->hdr);
 
         std::string hrec = "##INFO=<ID=" + REGIONS_TAG + ",Number=0,Type=Flag,Description=\"" + REGIONS_TAG_DESC + "\">";
@@ -139,6 +153,7 @@ class Igor : Program
         ///////////////////////
         //tool initialization//
         ///////////////////////
+        vm = new VariantManip();
         if (str_ends_with(regions_file, ".bed") || str_ends_with(regions_file, ".bed.gz"))
         {    
             use_bed = true;
@@ -175,6 +190,7 @@ class Igor : Program
         print_str_op("         [m] regions file            ", regions_file);
         print_num_op("         [l] left window             ", left_window);
         print_num_op("         [r] right window            ", right_window);
+        print_str_op("         [T] temporary directory     ", tmp_dir);
         print_int_op("         [i] intervals               ", intervals);
         std::clog << "\n";
     }
@@ -190,49 +206,118 @@ class Igor : Program
     {
         odw->write_hdr();
 
-        bcf_hdr_t *h = odr->hdr;
+        //annotate chunks of an indexed file in parallel
+        int32_t no_threads = get_n_hts_threads();
+        if (no_threads>1)
+        {
+            worker_vms.assign(no_threads, NULL);
+            worker_filters.assign(no_threads, NULL);
+            worker_orom_regions.assign(no_threads, NULL);
+            worker_obom_regions.assign(no_threads, NULL);
+
+            bool processed = process_chunks(input_vcf_file, intervals, odw, no_threads, tmp_dir);
+
+            for (int32_t i=0; i<no_threads; ++i)
+            {
+                if (worker_vms[i]) delete worker_vms[i];
+                if (worker_filters[i]) delete worker_filters[i];
+                if (worker_orom_regions[i]) delete worker_orom_regions[i];
+                if (worker_obom_regions[i]) delete worker_obom_regions[i];
+            }
+
+            if (processed)
+            {
+                odw->close();
+                return;
+            }
+        }
+
         bcf1_t *v = bcf_init1();
-        std::vector<Interval*> overlaps;
         Variant variant;
-        kstring_t s = {0,0,0};
         while (odr->read(v))
         {
-            bcf_unpack(v, BCF_UN_STR);
-            if (filter_exists)
+            if (annotate_region(odr->hdr, v, variant, vm, filter, orom_regions, obom_regions))
             {
-                vm->classify_variant(h, v, variant);
-                if (!filter.apply(h, v, &variant, false))
-                {
-                    continue;
-                }
+                odw->write(v);
             }
-           
-            std::string chrom = bcf_get_chrom(odr->hdr,v);
-            int32_t start1 = bcf_get_pos1(v);
-            int32_t end1 = bcf_get_end1(v);
+        }
+
+        odw->close();
+    };
 
+    /**
+     * Annotates a chunk with the tools of the worker as these are not
+     * thread safe.  The tools are created for the first chunk of a worker
+     * and reused for its later chunks which follow in coordinate order.
+     */
+    void process_chunk(int32_t worker, GenomeChunk& chunk, BCFOrderedReader* odr, BCFOrderedWriter* odw)
+    {
+        if (!worker_vms[worker])
+        {
+            worker_vms[worker] = new VariantManip();
+            worker_filters[worker] = new Filter();
+            worker_filters[worker]->parse(fexps[0].c_str(), false);
             if (use_bed)
             {
-                if (orom_regions->overlaps_with(chrom, start1-left_window, end1+right_window))
-                {
-                    bcf_update_info_flag(odr->hdr, v, REGIONS_TAG.c_str(), "", 1);
-                    ++no_variants_annotated;
-                }
+                worker_orom_regions[worker] = new OrderedRegionOverlapMatcher(regions_file);
             }
             else
             {
-                if (obom_regions->overlaps_with(chrom, start1-left_window, end1+right_window))
-                {
-                    bcf_update_info_flag(odr->hdr, v, REGIONS_TAG.c_str(), "", 1);
-                    ++no_variants_annotated;
-                }
+                worker_obom_regions[worker] = new OrderedBCFOverlapMatcher(regions_file, intervals, fexps[1]);
+            }
+        }
+
+        bcf1_t *v = bcf_init1();
+        Variant variant;
+        while (read_chunk(chunk, odr, v))
+        {
+            if (annotate_region(odw->hdr, v, variant, worker_vms[worker], *worker_filters[worker], worker_orom_regions[worker], worker_obom_regions[worker]))
+            {
+                odw->write(v);
             }
+        }
+        bcf_destroy(v);
+    };
 
-            ++no_variants;
-            odw->write(v);
+    /**
+     * Annotates a variant, returns false if the variant is filtered out.
+     */
+    bool annotate_region(bcf_hdr_t *h, bcf1_t *v, Variant& variant, VariantManip *vm, Filter& filter,
+                         OrderedRegionOverlapMatcher *orom_regions, OrderedBCFOverlapMatcher *obom_regions)
+    {
+        bcf_unpack(v, BCF_UN_STR);
+        if (filter_exists)
+        {
+            vm->classify_variant(h, v, variant);
+            if (!filter.apply(h, v, &variant, false))
+            {
+                return false;
+            }
         }
 
-        odw->close();
+        std::string chrom = bcf_get_chrom(h,v);
+        int32_t start1 = bcf_get_pos1(v);
+        int32_t end1 = bcf_get_end1(v);
+
+        if (use_bed)
+        {
+            if (orom_regions->overlaps_with(chrom, start1-left_window, end1+right_window))
+            {
+                bcf_update_info_flag(h, v, REGIONS_TAG.c_str(), "", 1);
+                ++no_variants_annotated;
+            }
+        }
+        else
+        {
+            if (obom_regions->overlaps_with(chrom, start1-left_window, end1+right_window))
+            {
+                bcf_update_info_flag(h, v, REGIONS_TAG.c_str(), "", 1);
+                ++no_variants_annotated;
+            }
+        }
+
+        ++no_variants;
+        return true;
     };
 
     private:
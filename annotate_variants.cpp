@@ -42,6 +42,7 @@ class Igor : Program
     std::string interval_list;
     std::string lc_bed_file;
     std::string cds_bed_file;
+    std::string tmp_dir;
     bool annotate_lc;
     bool annotate_cds;
 
@@ -61,7 +62,7 @@ class Igor : Program
     /////////
     //stats//
     /////////
-    int32_t no_variants_annotated;
+    std::atomic<int32_t> no_variants_annotated;
 
     ////////////////
     //common tools//
@@ -70,6 +71,15 @@ class Igor : Program
     OrderedRegionOverlapMatcher *orom_lc;
     OrderedRegionOverlapMatcher *orom_cds;
 
+    ////////////////
+    //worker tools//
+    ////////////////
+    //tools of the workers of process_chunks(), reused across the chunks of a worker
+    std::vector<VariantManip*> worker_vms;
+    std::vector<Filter*> worker_filters;
+    std::vector<OrderedRegionOverlapMatcher*> worker_orom_lcs;
+    std::vector<OrderedRegionOverlapMatcher*> worker_orom_cdss;
+
     Igor(int argc, char **argv)
     {
         version = "0.5";
@@ -90,6 +100,8 @@ class Igor : Program
             TCLAP::ValueArg<std::string> arg_ref_fasta_file("r", "r", "reference sequence fasta file []", true, "", "str", cmd);
             TCLAP::ValueArg<std::string> arg_lc_bed_file("m", "m", "low complexity regions BED file []", false, "", "file", cmd);
             TCLAP::ValueArg<std::string> arg_cds_bed_file("g", "g", "coding regions BED file []", false, "", "str", cmd);
+            TCLAP::ValueArg<std::string> arg_tmp_dir("T", "tmp-dir", "directory for temporary files of --threads, by default beside the output file\n"
+                 "              or in $TMPDIR if the output is the standard output []", false, "", "str", cmd);
             TCLAP::UnlabeledValueArg<std::string> arg_input_vcf_file("<in.vcf>", "input VCF file", true, "","file", cmd);
 
             cmd.parse(argc, argv);
@@ -104,6 +116,7 @@ class Igor : Program
             annotate_lc = lc_bed_file != "" ? true : false;
             cds_bed_file = arg_cds_bed_file.getValue();
             annotate_cds = cds_bed_file != "" ? true : false;
+            tmp_dir = arg_tmp_dir.getValue();
         }
         catch (TCLAP::ArgException &e)
         {
@@ -121,6 +134,7 @@ class Igor : Program
         //////////////////////
         odr = new BCFOrderedReader(input_vcf_file, intervals);
         odw = new BCFOrderedWriter(output_vcf_file);
+        odw->enable_index();
         odw->link_hdr(odr->hdr);
         bcf_hdr_append(odw->hdr, "##INFO=<ID=VT,Number=1,Type=String,Description=\"Variant Type - SNP, MNP, INDEL, CLUMPED, STR, VNTR, SV.\">");
         bcf_hdr_append(odw->hdr, "##INFO=<ID=RU,Number=1,Type=String,Description=\"Repeat unit in a STR or Homopolymer.\">");
@@ -165,6 +179,7 @@ class Igor : Program
         print_str_op("         [m] low complexity BED file  ", lc_bed_file);
         print_str_op("         [g] coding sequence BED file ", cds_bed_file);
         print_ref_op("         [r] ref FASTA file           ", ref_fasta_file);
+        print_str_op("         [T] temporary directory      ", tmp_dir);
         print_int_op("         [i] intervals                ", intervals);
         std::clog << "\n";
     }
@@ -180,71 +195,135 @@ class Igor : Program
     {
         odw->write_hdr();
 
+        //annotate chunks of an indexed file in parallel
+        int32_t no_threads = get_n_hts_threads();
+        if (no_threads>1)
+        {
+            worker_vms.assign(no_threads, NULL);
+            worker_filters.assign(no_threads, NULL);
+            worker_orom_lcs.assign(no_threads, NULL);
+            worker_orom_cdss.assign(no_threads, NULL);
+
+            bool processed = process_chunks(input_vcf_file, intervals, odw, no_threads, tmp_dir);
+
+            for (int32_t i=0; i<no_threads; ++i)
+            {
+                if (worker_vms[i]) delete worker_vms[i];
+                if (worker_filters[i]) delete worker_filters[i];
+                if (worker_orom_lcs[i]) delete worker_orom_lcs[i];
+                if (worker_orom_cdss[i]) delete worker_orom_cdss[i];
+            }
+
+            if (processed)
+            {
+                odw->close();
+                return;
+            }
+        }
+
         bcf1_t *v = bcf_init1();
-        std::vector<Interval*> overlaps;
         Variant variant;
-        kstring_t s = {0,0,0};
         while (odr->read(v))
         {
-            bcf_unpack(v, BCF_UN_STR);
-            int32_t vtype = vm->classify_variant(odr->hdr, v, variant);
-
-            if (filter_exists)
+            if (annotate_variant(odr->hdr, v, variant, vm, filter, orom_lc, orom_cds))
             {
-                if (!filter.apply(odr->hdr, v, &variant, false))
-                {
-                    continue;
-                }
+                odw->write(v);
             }
+        }
 
-            std::string str = Variant::vtype2string(vtype);
-            if (str.size()!=0)
+        odw->close();
+    };
+
+    /**
+     * Annotates a chunk with the tools of the worker as these are not
+     * thread safe.  The tools are created for the first chunk of a worker
+     * and reused for its later chunks which follow in coordinate order.
+     */
+    void process_chunk(int32_t worker, GenomeChunk& chunk, BCFOrderedReader* odr, BCFOrderedWriter* odw)
+    {
+        if (!worker_vms[worker])
+        {
+            worker_vms[worker] = new VariantManip(ref_fasta_file);
+            worker_filters[worker] = new Filter();
+            worker_filters[worker]->parse(fexp.c_str(), false);
+            if (annotate_lc) worker_orom_lcs[worker] = new OrderedRegionOverlapMatcher(lc_bed_file);
+            if (annotate_cds) worker_orom_cdss[worker] = new OrderedRegionOverlapMatcher(cds_bed_file);
+        }
+
+        bcf1_t *v = bcf_init1();
+        Variant variant;
+        while (read_chunk(chunk, odr, v))
+        {
+            if (annotate_variant(odw->hdr, v, variant, worker_vms[worker], *worker_filters[worker], worker_orom_lcs[worker], worker_orom_cdss[worker]))
             {
-                bcf_update_info_string(odr->hdr, v, "VT", str.c_str());
+                odw->write(v);
             }
+        }
+        bcf_destroy(v);
+    };
 
-            std::string chrom = bcf_get_chrom(odr->hdr,v);
-            int32_t start1 = bcf_get_pos1(v);
-            int32_t end1 = bcf_get_end1(v);
+    /**
+     * Annotates a variant, returns false if the variant is filtered out.
+     */
+    bool annotate_variant(bcf_hdr_t *h, bcf1_t *v, Variant& variant, VariantManip *vm, Filter& filter,
+                          OrderedRegionOverlapMatcher *orom_lc, OrderedRegionOverlapMatcher *orom_cds)
+    {
+        bcf_unpack(v, BCF_UN_STR);
+        int32_t vtype = vm->classify_variant(h, v, variant);
 
-            if (annotate_lc)
+        if (filter_exists)
+        {
+            if (!filter.apply(h, v, &variant, false))
             {
-                if (orom_lc->overlaps_with(chrom, start1, end1))
-                {
-                    bcf_update_info_flag(odr->hdr, v, "LC", "", 1);
-                }
+                return false;
             }
+        }
 
-            if (vtype==VT_SNP)
-            {
-                //synonymous and non synonymous annotation
+        std::string str = Variant::vtype2string(vtype);
+        if (str.size()!=0)
+        {
+            bcf_update_info_string(h, v, "VT", str.c_str());
+        }
 
+        std::string chrom = bcf_get_chrom(h,v);
+        int32_t start1 = bcf_get_pos1(v);
+        int32_t end1 = bcf_get_end1(v);
+
+        if (annotate_lc)
+        {
+            if (orom_lc->overlaps_with(chrom, start1, end1))
+            {
+                bcf_update_info_flag(h, v, "LC", "", 1);
             }
-            else if (vtype&VT_INDEL)
+        }
+
+        if (vtype==VT_SNP)
+        {
+            //synonymous and non synonymous annotation
+
+        }
+        else if (vtype&VT_INDEL)
+        {
+            if (annotate_cds)
             {
-                if (annotate_cds)
+                bool overlap = false;
+                if ((overlap = orom_cds->overlaps_with(chrom, start1, end1)))
                 {
-                    bool overlap = false;
-                    if ((overlap = orom_cds->overlaps_with(chrom, start1, end1)))
+                    if (abs(variant.alleles[0].dlen)%3!=0)
                     {
-                        if (abs(variant.alleles[0].dlen)%3!=0)
-                        {
-                            bcf_update_info_flag(odr->hdr, v, "FS1", "", 1);
-                        }
-                        else
-                        {
-                            bcf_update_info_flag(odr->hdr, v, "NFS", "", 1);
-                        }
-
+                        bcf_update_info_flag(h, v, "FS1", "", 1);
+                    }
+                    else
+                    {
+                        bcf_update_info_flag(h, v, "NFS", "", 1);
                     }
+
                 }
             }
-
-            ++no_variants_annotated;
-            odw->write(v);
         }
 
-        odw->close();
+        ++no_variants_annotated;
+        return true;
     };
 
     private:
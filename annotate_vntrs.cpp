@@ -148,6 +148,7 @@ class Igor : Program
         //////////////////////
         odr = new BCFOrderedReader(input_vcf_file, intervals);
         odw = new BCFOrderedWriter(output_vcf_file, 10000);
+        odw->enable_index();
         odw->link_hdr(odr->hdr);
 
         //////////////////////////////
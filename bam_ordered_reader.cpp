@@ -68,6 +68,7 @@ BAMOrderedReader::BAMOrderedReader(std::string file_name, std::vector<GenomeInte
         exit(1);
     }
     ftype = file->format;
+    attach_hts_threads(file);
 
     if (ftype.format!=sam && ftype.format!=bam && ftype.format!=cram)
     {
@@ -23,6 +23,24 @@
 
 #include "bcf_ordered_reader.h"
 
+/**
+ * Backs off while waiting on a record queue, spinning for a
+ * few rounds before sleeping so that an idle side does not
+ * hold on to a core.
+ */
+static void prefetch_backoff(uint32_t& spins)
+{
+    if (spins<64)
+    {
+        ++spins;
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
 /**
  * Initialize files and intervals.
  *
@@ -40,8 +58,19 @@ BCFOrderedReader::BCFOrderedReader(std::string file_name, std::vector<GenomeInte
 
     this->intervals = intervals;
     interval_index = 0;
+    interval_skip_pos1 = 0;
     index_loaded = false;
 
+    prefetch_enabled = false;
+    prefetch_eof = false;
+    prefetch_unpack = 0;
+    prefetch_k = 0;
+    prefetcher = NULL;
+    prefetch_stop = false;
+    prefetch_spare = NULL;
+    ready_recs = NULL;
+    free_recs = NULL;
+
     file = hts_open(this->file_name.c_str(), "r");
     if (!file)
     {
@@ -49,6 +78,7 @@ BCFOrderedReader::BCFOrderedReader(std::string file_name, std::vector<GenomeInte
         exit(1);
     }
     ftype = file->format;
+    attach_hts_threads(file);
 
     if (ftype.format!=vcf && ftype.format!=bcf)
     {
@@ -106,8 +136,49 @@ BCFOrderedReader::BCFOrderedReader(std::string file_name, std::vector<GenomeInte
     }
 
     random_access_enabled = intervals_present && index_loaded;
+
+    if (random_access_enabled && this->intervals.size()>1)
+    {
+        merge_intervals();
+        bgzf_set_cache_size(hts_get_bgzfp(file), 128*BGZF_MAX_BLOCK_SIZE+1);
+    }
 };
 
+/**
+ * Sorts and merges the intervals per contig in the order of the index.
+ * Intervals on contigs that are not indexed are dropped.
+ */
+void BCFOrderedReader::merge_intervals()
+{
+    std::vector<std::pair<int32_t, int32_t> > order;
+    for (size_t i=0; i<intervals.size(); ++i)
+    {
+        const char* seq = intervals[i].seq.c_str();
+        int32_t tid = ftype.format==bcf ? bcf_hdr_name2id(hdr, seq) : tbx_name2id(tbx, seq);
+        if (tid>=0)
+        {
+            order.push_back(std::make_pair(tid, i));
+        }
+    }
+
+    std::vector<GenomeInterval> merged;
+    std::sort(order.begin(), order.end(), IntervalOrder(intervals));
+    for (size_t i=0; i<order.size(); ++i)
+    {
+        GenomeInterval& interval = intervals[order[i].second];
+        if (i && order[i].first==order[i-1].first && interval.start1<=merged.back().end1+1)
+        {
+            merged.back().end1 = std::max(merged.back().end1, interval.end1);
+        }
+        else
+        {
+            merged.push_back(interval);
+        }
+    }
+
+    intervals = merged;
+}
+
 /**
  * Destructor.
  */
@@ -123,6 +194,9 @@ BCFOrderedReader::~BCFOrderedReader()
  */
 bool BCFOrderedReader::jump_to_interval(GenomeInterval& interval)
 {
+    stop_prefetch();
+    prefetch_eof = false;
+
     if (index_loaded)
     {
         intervals_present = true;
@@ -130,6 +204,7 @@ bool BCFOrderedReader::jump_to_interval(GenomeInterval& interval)
         intervals.clear();
         intervals.push_back(interval);
         interval_index = 0;
+        interval_skip_pos1 = 0;
         if (ftype.format==bcf)
         {
             intervals[interval_index++].to_string(&s);
@@ -189,6 +264,13 @@ bool BCFOrderedReader::initialize_next_interval()
 {
     while (interval_index!=intervals.size())
     {
+        //records overlapping the previous interval on the same contig were already read
+        interval_skip_pos1 = 0;
+        if (interval_index && intervals[interval_index].seq==intervals[interval_index-1].seq)
+        {
+            interval_skip_pos1 = intervals[interval_index-1].end1;
+        }
+
         if (ftype.format==bcf)
         {
             intervals[interval_index++].to_string(&s);
@@ -220,6 +302,162 @@ bool BCFOrderedReader::initialize_next_interval()
  * Reads next record, hides the random access of different regions from the user.
  */
 bool BCFOrderedReader::read(bcf1_t *v)
+{
+    if (prefetch_enabled)
+    {
+        if (!prefetcher)
+        {
+            if (prefetch_eof) return false;
+            start_prefetch();
+        }
+
+        bcf1_t *r = NULL;
+        uint32_t spins = 0;
+        while (!ready_recs->pop(r))
+        {
+            prefetch_backoff(spins);
+        }
+
+        //end of file is signalled by a NULL record
+        if (r==NULL)
+        {
+            stop_prefetch();
+            prefetch_eof = true;
+            return false;
+        }
+
+        //swap contents so that the caller's record is recycled by the producer
+        bcf1_t t = *v;
+        *v = *r;
+        *r = t;
+        free_recs->push(r);
+
+        return true;
+    }
+
+    return read_next(v);
+}
+
+/**
+ * Enables prefetching of records by a background thread.
+ */
+void BCFOrderedReader::enable_prefetch(int32_t unpack, uint32_t k)
+{
+    prefetch_enabled = true;
+    prefetch_unpack = unpack;
+    prefetch_k = k;
+}
+
+/**
+ * Starts the prefetching thread.
+ */
+void BCFOrderedReader::start_prefetch()
+{
+    ready_recs = new BCFRecordQueue(prefetch_k);
+    free_recs = new BCFRecordQueue(prefetch_k);
+
+    //one slot of ready_recs is reserved for the end of file marker
+    for (uint32_t i=0; i<free_recs->mask; ++i)
+    {
+        bcf1_t *r;
+        if (!pool.empty())
+        {
+            r = pool.front();
+            pool.pop_front();
+        }
+        else
+        {
+            r = bcf_init();
+        }
+        free_recs->push(r);
+    }
+
+    prefetch_stop = false;
+    prefetcher = new std::thread(&BCFOrderedReader::prefetch, this);
+}
+
+/**
+ * Stops the prefetching thread and returns all records to the pool.
+ */
+void BCFOrderedReader::stop_prefetch()
+{
+    if (!prefetcher) return;
+
+    prefetch_stop = true;
+    prefetcher->join();
+    delete prefetcher;
+    prefetcher = NULL;
+
+    if (prefetch_spare)
+    {
+        pool.push_back(prefetch_spare);
+        prefetch_spare = NULL;
+    }
+
+    bcf1_t *r;
+    while (ready_recs->pop(r))
+    {
+        if (r) pool.push_back(r);
+    }
+    while (free_recs->pop(r))
+    {
+        pool.push_back(r);
+    }
+
+    delete ready_recs;
+    ready_recs = NULL;
+    delete free_recs;
+    free_recs = NULL;
+}
+
+/**
+ * Reads and unpacks records into ready_recs, run by the prefetching thread.
+ */
+void BCFOrderedReader::prefetch()
+{
+    //free_recs is only ever pushed by the consumer, records that
+    //are not handed over are kept in prefetch_spare and returned
+    //to the pool by stop_prefetch() after the thread is joined
+    bcf1_t *r = NULL;
+    uint32_t spins = 0;
+    while (!prefetch_stop)
+    {
+        if (!free_recs->pop(r))
+        {
+            prefetch_backoff(spins);
+            continue;
+        }
+        spins = 0;
+
+        if (!read_next(r))
+        {
+            prefetch_spare = r;
+            r = NULL;
+        }
+        else
+        {
+            bcf_unpack(r, prefetch_unpack);
+        }
+
+        while (!ready_recs->push(r))
+        {
+            if (prefetch_stop)
+            {
+                if (r) prefetch_spare = r;
+                return;
+            }
+            prefetch_backoff(spins);
+        }
+        spins = 0;
+
+        if (r==NULL) return;
+    }
+}
+
+/**
+ * Reads next record from the file.
+ */
+bool BCFOrderedReader::read_next(bcf1_t *v)
 {
     if (random_access_enabled)
     {
@@ -229,6 +467,7 @@ bool BCFOrderedReader::read(bcf1_t *v)
             {
                 if (itr && bcf_itr_next(file, itr, v)>=0)
                 {
+                    if (bcf_get_pos1(v)<=interval_skip_pos1) continue;
                     return true;
                 }
                 else if (!initialize_next_interval())
@@ -244,6 +483,7 @@ bool BCFOrderedReader::read(bcf1_t *v)
                 if (itr && tbx_itr_next(file, tbx, itr, &s)>=0)
                 {
                     vcf_parse1(&s, hdr, v);
+                    if (bcf_get_pos1(v)<=interval_skip_pos1) continue;
                     return true;
                 }
                 else if (!initialize_next_interval())
@@ -273,6 +513,13 @@ bool BCFOrderedReader::read(bcf1_t *v)
  */
 void BCFOrderedReader::close()
 {
+    stop_prefetch();
+    while (!pool.empty())
+    {
+        bcf_destroy(pool.front());
+        pool.pop_front();
+    }
+
     if (file && bcf_close(file))
     {
         fprintf(stderr, "[%s:%d %s] Cannot close %s\n", __FILE__, __LINE__, __FUNCTION__, file_name.c_str());
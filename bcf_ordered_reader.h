@@ -24,10 +24,83 @@
 #ifndef BCF_ORDERED_READER_H
 #define BCF_ORDERED_READER_H
 
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <atomic>
 #include "hts_utils.h"
 #include "utils.h"
 #include "genome_interval.h"
 
+/**
+ * A bounded lock free queue of records for exactly one producer thread
+ * and one consumer thread.  The capacity is 2^k.
+ */
+class BCFRecordQueue
+{
+    public:
+    std::vector<bcf1_t*> recs;
+    uint32_t mask;
+    std::atomic<uint32_t> head; //next slot to pop, owned by the consumer
+    std::atomic<uint32_t> tail; //next slot to push, owned by the producer
+
+    BCFRecordQueue(uint32_t k)
+    {
+        recs.resize(1<<k, NULL);
+        mask = (1<<k)-1;
+        head = 0;
+        tail = 0;
+    };
+
+    /**
+     * Pushes a record, returns false if the queue is full.
+     */
+    bool push(bcf1_t *v)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t-head.load(std::memory_order_acquire)>mask)
+        {
+            return false;
+        }
+        recs[t&mask] = v;
+        tail.store(t+1, std::memory_order_release);
+        return true;
+    };
+
+    /**
+     * Pops a record, returns false if the queue is empty.
+     */
+    bool pop(bcf1_t*& v)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h==tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        v = recs[h&mask];
+        head.store(h+1, std::memory_order_release);
+        return true;
+    };
+};
+
+/**
+ * Orders intervals, given as pairs of contig index and interval
+ * index, by contig and start position.
+ */
+class IntervalOrder
+{
+    public:
+    std::vector<GenomeInterval>& intervals;
+
+    IntervalOrder(std::vector<GenomeInterval>& intervals) : intervals(intervals) {};
+
+    bool operator()(const std::pair<int32_t, int32_t>& a, const std::pair<int32_t, int32_t>& b)
+    {
+        if (a.first!=b.first) return a.first<b.first;
+        return intervals[a.second].start1<intervals[b.second].start1;
+    }
+};
+
 /**
  * A class for reading ordered VCF/BCF files.
  *
@@ -49,6 +122,15 @@
  * This class hides the handling of indices from
  * the user and also allows for the selection of
  * records in intervals in both cases 1 and 2.
+ *
+ * For indexed files, the intervals are sorted and
+ * merged per contig in the order of the index so
+ * that each record is read once and the decompressed
+ * blocks are reused between adjacent intervals.
+ *
+ * Records may optionally be prefetched by a background
+ * thread that reads and unpacks records ahead of the
+ * caller, see enable_prefetch().
  */
 
 class BCFOrderedReader
@@ -75,10 +157,22 @@ class BCFOrderedReader
     //list of intervals
     std::vector<GenomeInterval> intervals;
     uint32_t interval_index;
+    int32_t interval_skip_pos1; //records up to here were read in the previous interval
 
     //for storing unused bcf records
     std::list<bcf1_t*> pool;
 
+    //for prefetching records in a background thread
+    bool prefetch_enabled;
+    bool prefetch_eof;
+    int32_t prefetch_unpack;
+    uint32_t prefetch_k;
+    std::thread *prefetcher;
+    std::atomic<bool> prefetch_stop;
+    bcf1_t *prefetch_spare;     //record held back by the producer at end of file or on stop
+    BCFRecordQueue *ready_recs; //records read by the producer
+    BCFRecordQueue *free_recs;  //records returned by the consumer
+
     //shared objects for string manipulation
     kstring_t s;
 
@@ -107,6 +201,15 @@ class BCFOrderedReader
      */
     bool read(bcf1_t *v);
 
+    /**
+     * Enables prefetching of records by a background thread.
+     * The thread is started on the first read and reads up to
+     * 2^k-1 records ahead, unpacking each record with the
+     * unpack flags (BCF_UN_*).  The header should declare all
+     * fields of the file as it is shared with the thread.
+     */
+    void enable_prefetch(int32_t unpack=BCF_UN_STR, uint32_t k=8);
+
     /**
     * Initialize next interval.
     * Returns false only if all intervals are accessed.
@@ -134,6 +237,32 @@ class BCFOrderedReader
     void close();
 
     private:
+
+    /**
+     * Returns next vcf record from the file.
+     */
+    bool read_next(bcf1_t *v);
+
+    /**
+     * Sorts and merges the intervals per contig in the order of the index.
+     * Intervals on contigs that are not indexed are dropped.
+     */
+    void merge_intervals();
+
+    /**
+     * Starts the prefetching thread.
+     */
+    void start_prefetch();
+
+    /**
+     * Stops the prefetching thread and returns all records to the pool.
+     */
+    void stop_prefetch();
+
+    /**
+     * Reads and unpacks records into ready_recs, run by the prefetching thread.
+     */
+    void prefetch();
 };
 
 #endif
@@ -23,10 +23,88 @@
 
 #include "bcf_ordered_writer.h"
 
-BCFOrderedWriter::BCFOrderedWriter(std::string output_vcf_file_name, int32_t window, int32_t compression)
+/**
+ * Constructor.
+ * @window - size of the sorting window in base pairs
+ */
+BCFSortWindow::BCFSortWindow(int32_t window)
+{
+    this->window = window;
+    buffer_rid = -1;
+    buffer_max_pos1 = 0;
+    buffer_seq = 0;
+}
+
+/**
+ * Inserts a record, the window takes ownership of it until it is
+ * released.  Warns if the record is before the window.
+ */
+void BCFSortWindow::insert(bcf_hdr_t *h, bcf1_t *v)
+{
+    int32_t pos1 = bcf_get_pos1(v);
+
+    if (!buffer.empty())
+    {
+        if (bcf_get_rid(v)==buffer_rid)
+        {
+            if (pos1<buffer.top().pos1)
+            {
+                int32_t cutoff_pos1 =  std::max(buffer_max_pos1-window,1);
+                if (pos1<cutoff_pos1)
+                {
+                    fprintf(stderr, "[%s:%d %s] Might not be sorted for window size %d at current record %s:%d < %d (%d [last record] - %d), please increase window size to at least %d.\n", __FILE__,__LINE__,__FUNCTION__, window, bcf_get_chrom(h, v), pos1, cutoff_pos1, buffer_max_pos1, window, buffer_max_pos1-pos1+1);
+                }
+            }
+        }
+        else
+        {
+            while (!buffer.empty())
+            {
+                released.push_back(buffer.top().v);
+                buffer.pop();
+            }
+        }
+    }
+
+    if (buffer.empty())
+    {
+        buffer_rid = bcf_get_rid(v);
+        buffer_max_pos1 = pos1;
+    }
+    else if (pos1>buffer_max_pos1)
+    {
+        buffer_max_pos1 = pos1;
+    }
+
+    buffer.push(bcf1_buffered(pos1, buffer_seq++, v));
+}
+
+/**
+ * Releases the next sorted record, all remaining records in order
+ * if forced.  Returns NULL if no record can be released.
+ */
+bcf1_t* BCFSortWindow::release(bool force)
+{
+    bcf1_t *v = NULL;
+    if (!released.empty())
+    {
+        v = released.front();
+        released.pop_front();
+    }
+    else if (!buffer.empty() && (force || (buffer.size()>1 && buffer.top().pos1<=std::max(buffer_max_pos1-window,1))))
+    {
+        v = buffer.top().v;
+        buffer.pop();
+    }
+
+    return v;
+}
+
+BCFOrderedWriter::BCFOrderedWriter(std::string output_vcf_file_name, int32_t window, int32_t compression) : buffer(window)
 {
     this->file_name = output_vcf_file_name;
     this->window = window;
+    n_threads = get_n_hts_threads();
     file = NULL;
 
     kstring_t mode = {0,0,0};
@@ -89,6 +167,10 @@ BCFOrderedWriter::BCFOrderedWriter(std::string output_vcf_file_name, int32_t win
         exit(1);
     }
 
+    idx = NULL;
+    idx_enabled = false;
+    idx_format = HTS_FMT_CSI;
+
     hdr = bcf_hdr_init("w");
     bcf_hdr_set_version(hdr, "VCFv4.2");
     linked_hdr = false;
@@ -125,7 +207,34 @@ void BCFOrderedWriter::link_hdr(bcf_hdr_t *hdr)
  */
 void BCFOrderedWriter::write_hdr()
 {
+    //virtual offsets of queued blocks are unknown with multithreaded
+    //compression, so an index is built with single threaded compression
+    if (!idx_enabled) attach_hts_threads(file, n_threads);
     bcf_hdr_write(file, hdr);
+    if (idx_enabled) init_index();
+}
+
+/**
+ * Indexes the file while writing if requested with --write-index.
+ * This is invoked before the header is written and only for the
+ * final output of a program, temporary files are never indexed.
+ */
+void BCFOrderedWriter::enable_index()
+{
+    if (get_write_index() && file->format.compression==bgzf)
+    {
+        idx_enabled = true;
+        idx_format = file->format.format==binary_format ? HTS_FMT_CSI : HTS_FMT_TBI;
+    }
+}
+
+/**
+ * Sets the number of BGZF compression threads, the number given
+ * with --threads by default.  To be invoked before the header is written.
+ */
+void BCFOrderedWriter::set_threads(int32_t n_threads)
+{
+    this->n_threads = n_threads;
 }
 
 /**
@@ -136,52 +245,14 @@ void BCFOrderedWriter::write(bcf1_t *v)
     //place into appropriate position in the buffer
     if (window)
     {
-        if (!buffer.empty())
-        {
-            if (bcf_get_rid(v)==bcf_get_rid(buffer.back()))
-            {
-                std::list<bcf1_t*>::iterator i = buffer.begin();
-
-                for (i=buffer.begin(); i!=buffer.end(); ++i)
-                {
-                    //equal sign ensures records are kept in original order
-                    if (bcf_get_pos1(v)>=bcf_get_pos1(*i))
-                    {
-                        buffer.insert(i,v);
-                        flush(false);
-                        return;
-                    }
-                }
-
-                if (i==buffer.end())
-                {
-                    int32_t cutoff_pos1 =  std::max(bcf_get_pos1(buffer.front())-window,1);
-                    if (bcf_get_pos1(v)<cutoff_pos1)
-                    {
-                        fprintf(stderr, "[%s:%d %s] Might not be sorted for window size %d at current record %s:%d < %d (%d [last record] - %d), please increase window size to at least %d.\n", __FILE__,__LINE__,__FUNCTION__, window, bcf_get_chrom(hdr, v), bcf_get_pos1(v), cutoff_pos1, bcf_get_pos1(buffer.front()), window, bcf_get_pos1(buffer.front())-bcf_get_pos1(v)+1);
-                    }
-                }
-
-                buffer.insert(i,v);
-                flush(false);
-            }
-            else
-            {
-                flush(true);
-                buffer.push_front(v);
-            }
-        }
-        else
-        {
-            buffer.push_front(v);
-        }
-
+        buffer.insert(hdr, v);
+        flush(false);
         v = NULL;
     }
     else
     {
         //todo:  add a mechanism to populate header similar to vcf_parse in vcf_format which is called by bcf_write
-        bcf_write(file, hdr, v);
+        write_record(v);
     }
 }
 
@@ -227,37 +298,11 @@ bcf1_t* BCFOrderedWriter::get_bcf1_from_pool()
  */
 void BCFOrderedWriter::flush(bool force)
 {
-    if (force)
+    bcf1_t *v;
+    while ((v = buffer.release(force)))
     {
-        while (!buffer.empty())
-        {
-            bcf_write(file, hdr, buffer.back());
-            bcf_destroy(buffer.back());
-            //store_bcf1_into_pool(buffer.back());
-            buffer.pop_back();
-        }
-    }
-    else
-    {
-        if (buffer.size()>1)
-        {
-            int32_t cutoff_pos1 =  std::max(bcf_get_pos1(buffer.front())-window,1);
-
-            while (buffer.size()>1)
-            {
-                if (bcf_get_pos1(buffer.back())<=cutoff_pos1)
-                {
-                    bcf_write(file, hdr, buffer.back());
-                    bcf_destroy(buffer.back());
-                    //store_bcf1_into_pool(buffer.back());
-                    buffer.pop_back();
-                }
-                else
-                {
-                    return;
-                }
-            }
-        }
+        write_record(v);
+        bcf_destroy(v);
     }
 }
 
@@ -267,7 +312,17 @@ void BCFOrderedWriter::flush(bool force)
 void BCFOrderedWriter::close()
 {
     flush(true);
+    if (idx) finish_index();
     bcf_close(file);
+    if (idx)
+    {
+        if (hts_idx_save(idx, file_name.c_str(), idx_format))
+        {
+            fprintf(stderr, "[%s:%d %s] Cannot save index for %s\n", __FILE__,__LINE__,__FUNCTION__, file_name.c_str());
+        }
+        hts_idx_destroy(idx);
+        idx = NULL;
+    }
     if (!linked_hdr && hdr) bcf_hdr_destroy(hdr);
 //    while (buffer.size()!=0)
 //    {
@@ -285,3 +340,94 @@ void BCFOrderedWriter::close()
 //        }
 //    }
 }
+
+/**
+ * Writes a record to the file and adds it to the index.
+ */
+void BCFOrderedWriter::write_record(bcf1_t *v)
+{
+    bcf_write(file, hdr, v);
+
+    if (idx)
+    {
+        int32_t tid = bcf_get_rid(v);
+        if (idx_format==HTS_FMT_TBI)
+        {
+            if (tid>=idx_tids.size()) idx_tids.resize(tid+1, -1);
+            if (idx_tids[tid]<0)
+            {
+                idx_tids[tid] = idx_seqnames.size();
+                idx_seqnames.push_back(std::string(bcf_get_chrom(hdr, v)));
+            }
+            tid = idx_tids[tid];
+        }
+
+        if (hts_idx_push(idx, tid, v->pos, v->pos+v->rlen, bgzf_tell(file->fp.bgzf), 1)<0)
+        {
+            fprintf(stderr, "[%s:%d %s] Records are not sorted, %s will not be indexed\n", __FILE__,__LINE__,__FUNCTION__, file_name.c_str());
+            hts_idx_destroy(idx);
+            idx = NULL;
+        }
+    }
+}
+
+/**
+ * Initializes the index, invoked after the header is written.
+ * The number of levels of a CSI index are set as in bcf_index_build.
+ */
+void BCFOrderedWriter::init_index()
+{
+    if (idx) hts_idx_destroy(idx);
+    idx_tids.clear();
+    idx_seqnames.clear();
+
+    if (idx_format==HTS_FMT_CSI)
+    {
+        int32_t min_shift = 14;
+        int64_t max_len = 0;
+        for (int32_t i=0; i<hdr->n[BCF_DT_CTG]; ++i)
+        {
+            if (hdr->id[BCF_DT_CTG][i].val && max_len<hdr->id[BCF_DT_CTG][i].val->info[0])
+            {
+                max_len = hdr->id[BCF_DT_CTG][i].val->info[0];
+            }
+        }
+        max_len += 256;
+
+        int32_t n_lvls = 0;
+        for (int64_t s=1<<min_shift; max_len>s; ++n_lvls, s<<=3);
+
+        idx = hts_idx_init(hdr->n[BCF_DT_CTG], HTS_FMT_CSI, bgzf_tell(file->fp.bgzf), min_shift, n_lvls);
+    }
+    else
+    {
+        idx = hts_idx_init(0, HTS_FMT_TBI, bgzf_tell(file->fp.bgzf), 14, 5);
+    }
+}
+
+/**
+ * Completes and saves the index, invoked before the file is closed.
+ * A TBI index carries the tabix configuration and the sequence names.
+ */
+void BCFOrderedWriter::finish_index()
+{
+    bgzf_flush(file->fp.bgzf);
+    hts_idx_finish(idx, bgzf_tell(file->fp.bgzf));
+
+    if (idx_format==HTS_FMT_TBI)
+    {
+        kstring_t meta = {0,0,0};
+        int32_t conf[7] = {tbx_conf_vcf.preset, tbx_conf_vcf.sc, tbx_conf_vcf.bc, tbx_conf_vcf.ec,
+                           tbx_conf_vcf.meta_char, tbx_conf_vcf.line_skip, 0};
+        for (size_t i=0; i<idx_seqnames.size(); ++i)
+        {
+            conf[6] += idx_seqnames[i].size()+1;
+        }
+        kputsn((char*)conf, sizeof(conf), &meta);
+        for (size_t i=0; i<idx_seqnames.size(); ++i)
+        {
+            kputsn(idx_seqnames[i].c_str(), idx_seqnames[i].size()+1, &meta);
+        }
+        hts_idx_set_meta(idx, meta.l, (uint8_t*) meta.s, 0);
+    }
+}
@@ -24,9 +24,88 @@
 #ifndef BCF_ORDERED_WRITER_H
 #define BCF_ORDERED_WRITER_H
 
+#include <deque>
 #include "hts_utils.h"
 #include "utils.h"
 
+/**
+ * Wrapper for a record in the local sort buffer.
+ * The sequence number records the order of insertion.
+ */
+class bcf1_buffered
+{
+    public:
+    int32_t pos1;
+    uint64_t seq;
+    bcf1_t *v;
+
+    bcf1_buffered(int32_t pos1, uint64_t seq, bcf1_t *v)
+    {
+        this->pos1 = pos1;
+        this->seq = seq;
+        this->v = v;
+    };
+};
+
+/**
+ * Comparator for bcf1_buffered.  Used in priority_queue; ensures that
+ * records are ordered by position and records with the same position
+ * are kept in the order they were written.
+ */
+class CompareBCF1Buffered
+{
+    public:
+    bool operator()(const bcf1_buffered& a, const bcf1_buffered& b)
+    {
+        if (a.pos1 == b.pos1)
+        {
+            return a.seq > b.seq;
+        }
+
+        return a.pos1 > b.pos1;
+    }
+};
+
+/**
+ * A window for locally sorting the records of a contig.  A record is
+ * released once it is window base pairs before the largest position
+ * inserted, all records of a contig are released when the next contig
+ * starts.  Records with the same position keep the order of insertion.
+ */
+class BCFSortWindow
+{
+    public:
+
+    //buffer for containing records to be sorted, smallest position on top
+    std::priority_queue<bcf1_buffered, std::vector<bcf1_buffered>, CompareBCF1Buffered> buffer;
+    int32_t buffer_rid;      //contig of the records in the buffer
+    int32_t buffer_max_pos1; //largest position in the buffer
+    uint64_t buffer_seq;     //number of records inserted into the buffer
+
+    //sorted records of the previous contig
+    std::deque<bcf1_t*> released;
+
+    int32_t window;
+
+    /**
+     * Constructor.
+     * @window - size of the sorting window in base pairs
+     */
+    BCFSortWindow(int32_t window);
+
+    /**
+     * Inserts a record, the window takes ownership of it until it is
+     * released.  Warns if the record is before the window.
+     */
+    void insert(bcf_hdr_t *h, bcf1_t *v);
+
+    /**
+     * Releases the next sorted record, all remaining records in order
+     * if forced.  Returns NULL if no record can be released.
+     */
+    bcf1_t* release(bool force);
+};
+
 /**
  * A class for writing ordered VCF/BCF files.
  *
@@ -49,10 +128,18 @@ class BCFOrderedWriter
     bool linked_hdr;
 
     //buffer for containing records to be written out
-    std::list<bcf1_t*> buffer; //most recent records in the front
+    BCFSortWindow buffer;
     std::list<bcf1_t*> pool;
 
     int32_t window;
+    int32_t n_threads; //number of BGZF compression threads
+
+    //for indexing while writing
+    bool idx_enabled;
+    hts_idx_t *idx;
+    int32_t idx_format;                    //HTS_FMT_CSI for BCF, HTS_FMT_TBI for VCF.GZ
+    std::vector<int32_t> idx_tids;         //TBI sequence ids by rid, -1 if not seen yet
+    std::vector<std::string> idx_seqnames; //TBI sequence names in order of appearance
 
     /**
      * Initialize output file.
@@ -77,6 +164,18 @@ class BCFOrderedWriter
      */
     void write_hdr();
 
+    /**
+     * Indexes the file while writing if requested with --write-index.
+     * To be invoked before the header is written for final outputs only.
+     */
+    void enable_index();
+
+    /**
+     * Sets the number of BGZF compression threads, the number given
+     * with --threads by default.  To be invoked before the header is written.
+     */
+    void set_threads(int32_t n_threads);
+
     /**
      * Reads next record, hides the random access of different regions from the user.
      */
@@ -111,6 +210,21 @@ class BCFOrderedWriter
      * Flush writable records from buffer.
      */
     void flush(bool force);
+
+    /**
+     * Writes a record to the file and adds it to the index.
+     */
+    void write_record(bcf1_t *v);
+
+    /**
+     * Initializes the index, invoked after the header is written.
+     */
+    void init_index();
+
+    /**
+     * Completes and saves the index, invoked before the file is closed.
+     */
+    void finish_index();
 };
 
 #endif
\ No newline at end of file
@@ -43,6 +43,7 @@ BCFSyncedReader::BCFSyncedReader(std::vector<std::string>& file_names, std::vect
     current_pos1 = 0;
 
     buffer.resize(nfiles);
+    tree.resize(nfiles, 0);
     s = {0, 0, 0};
 
     random_access = (intervals.size()!=0);
@@ -82,6 +83,7 @@ BCFSyncedReader::BCFSyncedReader(std::vector<std::string>& file_names, std::vect
 //            toexit = true;        
         }
         ftypes[i] = files[i]->format;
+        attach_hts_threads(files[i]);
 
         //check format
         if (ftypes[i].format!=vcf && ftypes[i].format!=bcf)
@@ -266,9 +268,9 @@ void BCFSyncedReader::print_buffer()
     for (int32_t i = 0; i<nfiles; ++i)
     {
         std::cerr << "#" << i << " ";
-        for (std::list<bcf1_t *>::iterator j = buffer[i].begin(); j!=buffer[i].end(); ++j)
+        for (size_t j=0; j<buffer[i].size(); ++j)
         {
-            bcf1_t *v = *j;
+            bcf1_t *v = buffer[i][j]->v;
             std::cerr << " " << v->rid << ":" << (v->pos+1) << ":" << v->d.allele[0] << ":" << v->d.allele[1];
         }
         std::cerr << "\n";
@@ -289,19 +291,118 @@ void BCFSyncedReader::close()
         bcf_itr_destroy(itrs[i]);
     }
 
+    for (size_t i=0; i<nfiles; ++i)
+    {
+        for (size_t j=0; j<buffer[i].size(); ++j)
+        {
+            bcf_destroy(buffer[i][j]->v);
+            delete buffer[i][j];
+        }
+        buffer[i].clear();
+    }
+
     while (pool.size()!=0)
     {
-        bcf_destroy(pool.front());
-        pool.pop_front();
+        bcf_destroy(pool.back());
+        pool.pop_back();
+    }
+
+    while (bcfptr_pool.size()!=0)
+    {
+        delete bcfptr_pool.back();
+        bcfptr_pool.pop_back();
     }
 }
 
 /**
- * Inserts a record into pq.
+ * Inserts a record into the sorted buffer of file i.
  */
-void BCFSyncedReader::insert_into_pq(int32_t i, bcf1_t *v)
+void BCFSyncedReader::insert_into_buffer(int32_t i, bcf1_t *v)
 {
-    pq.push(new bcfptr(i, bcf_get_rid(v), bcf_get_pos1(v), hdrs[i], v, sync_by_pos));
+    bcfptr *b = get_bcfptr_from_pool();
+    b->set(i, hdrs[i], v, sync_by_pos);
+
+    //records with the same key are kept in file order
+    std::vector<bcfptr *>& buf = buffer[i];
+    size_t j = buf.size();
+    buf.push_back(b);
+    while (j && bcfptr_cmp(buf[j-1], b)>0)
+    {
+        buf[j] = buf[j-1];
+        --j;
+    }
+    buf[j] = b;
+}
+
+/**
+ * Returns true if the first record of file i precedes that of file j.
+ * Files with empty buffers are ordered last.
+ */
+bool BCFSyncedReader::file_precedes(int32_t i, int32_t j)
+{
+    if (buffer[i].empty())
+    {
+        return false;
+    }
+    else if (buffer[j].empty())
+    {
+        return true;
+    }
+
+    int32_t d = bcfptr_cmp(buffer[i].front(), buffer[j].front());
+
+    return d<0 || (d==0 && i<j);
+}
+
+/**
+ * Builds the loser tree from the first record of every file.
+ *
+ * The files are the leaves nfiles to 2*nfiles-1 of an implicit binary tree,
+ * internal node n keeps the loser of the match between the winners of its
+ * subtrees and tree[0] keeps the overall winner.
+ */
+void BCFSyncedReader::build_tree()
+{
+    std::vector<int32_t> winners(2*nfiles);
+    for (int32_t i=0; i<nfiles; ++i)
+    {
+        winners[nfiles+i] = i;
+    }
+
+    for (int32_t n=nfiles-1; n>0; --n)
+    {
+        int32_t l = winners[2*n];
+        int32_t r = winners[2*n+1];
+        if (file_precedes(r, l))
+        {
+            winners[n] = r;
+            tree[n] = l;
+        }
+        else
+        {
+            winners[n] = l;
+            tree[n] = r;
+        }
+    }
+
+    tree[0] = nfiles==1 ? 0 : winners[1];
+}
+
+/**
+ * Replays the matches of file i up the loser tree after its first record
+ * has changed.  File i must be the previous winner.
+ */
+void BCFSyncedReader::replay_tree(int32_t i)
+{
+    int32_t winner = i;
+    for (int32_t n=(nfiles+i)>>1; n>0; n>>=1)
+    {
+        if (file_precedes(tree[n], winner))
+        {
+            std::swap(tree[n], winner);
+        }
+    }
+    tree[0] = winner;
 }
 
 /**
@@ -311,8 +412,8 @@ bcf1_t* BCFSyncedReader::get_bcf1_from_pool()
 {
     if(!pool.empty())
     {
-        bcf1_t* v = pool.front();
-        pool.pop_front();
+        bcf1_t* v = pool.back();
+        pool.pop_back();
         bcf_clear(v);
         return v;
     }
@@ -334,49 +435,43 @@ void BCFSyncedReader::store_bcf1_into_pool(bcf1_t* v)
 }
 
 /**
- * Compares records based on type of comparison.
+ * Gets record wrapper from pool, creates a new wrapper if necessary
  */
-int32_t BCFSyncedReader::bcfptr_cmp(bcfptr *a, bcfptr *b)
+bcfptr* BCFSyncedReader::get_bcfptr_from_pool()
 {
-    if (random_access)
+    if(!bcfptr_pool.empty())
     {
-        if (a->pos1 == b->pos1)
-        {
-            if (a->alleles.l!=0 && b->alleles.l!=0)
-            {
-                int32_t d = strcmp(a->alleles.s, b->alleles.s);
-                return d;
-            }
-            else
-            {
-                return 0;
-            }
-        }
-
-        return a->pos1 >= b->pos1 ? 1 : -1;
+        bcfptr* b = bcfptr_pool.back();
+        bcfptr_pool.pop_back();
+        return b;
     }
     else
     {
-        if (a->rid == b->rid)
-        {
-            if (a->pos1 == b->pos1)
-            {
-                if (a->alleles.l!=0 && b->alleles.l!=0)
-                {
-                    int32_t d = strcmp(a->alleles.s, b->alleles.s);
-                    return d;
-                }
-                else
-                {
-                    return 0;
-                }
-            }
+        return new bcfptr();
+    }
+}
 
-            return a->pos1 >= b->pos1 ? 1 : -1;
-        }
+/**
+ * Compares records by contig, position and allele fingerprint.
+ */
+int32_t BCFSyncedReader::bcfptr_cmp(bcfptr *a, bcfptr *b)
+{
+    if (a->rid != b->rid)
+    {
+        return a->rid < b->rid ? -1 : 1;
+    }
 
-        return a->rid >= b->rid ? 1 : -1;
+    if (a->pos1 != b->pos1)
+    {
+        return a->pos1 < b->pos1 ? -1 : 1;
     }
+
+    if (a->fingerprint != b->fingerprint)
+    {
+        return a->fingerprint < b->fingerprint ? -1 : 1;
+    }
+
+    return 0;
 }
 
 /**
@@ -391,36 +486,30 @@ bool BCFSyncedReader::read_next_position(std::vector<bcfptr*>& current_recs)
     for (size_t i=0; i<current_recs.size(); ++i)
     {
         store_bcf1_into_pool(current_recs[i]->v);
-        delete current_recs[i];
+        bcfptr_pool.push_back(current_recs[i]);
     }
     current_recs.clear();
 
-    //process records in priority queue or initialize next interval if pq is empty
-    //initialize_next_interval tops up the pq
+    //process records in the loser tree or initialize next interval if all buffers are empty
+    //initialize_next_interval tops up the buffers
     //initialize_next_interval will never be invoked until the end for non indexed reading
-    if (pq.size()!=0 || initialize_next_interval())
+    if (!buffer[tree[0]].empty() || initialize_next_interval())
     {
-        //dequeue pqueue most recent position and return it
-        bcfptr* variant = pq.top();
-        bcfptr* cvariant = variant;
+        //dequeue the records that are equal to the winning record
+        bcfptr* variant = buffer[tree[0]].front();
 
-        while (bcfptr_cmp(cvariant, variant)==0)
+        while (true)
         {
-            bcfptr *b = pq.top();
-            current_recs.push_back(b);
-
-            buffer[b->file_index].remove(b->v);
-            fill_buffer(b->file_index);
-            pq.pop();
-
-            if (pq.size()==0)
+            int32_t i = tree[0];
+            if (buffer[i].empty() || bcfptr_cmp(buffer[i].front(), variant)!=0)
             {
                 break;
             }
-            else
-            {
-                cvariant = pq.top();
-            }
+
+            current_recs.push_back(buffer[i].front());
+            buffer[i].erase(buffer[i].begin());
+            fill_buffer(i);
+            replay_tree(i);
         }
 
         return true;
@@ -463,10 +552,11 @@ bool BCFSyncedReader::initialize_next_interval()
                 fill_buffer(i);
             }
 
-            //make sure pq is not empty
-            //it is possible for the pq to be empty as iterators may be returned
+            //make sure the buffers are not empty
+            //it is possible for the buffers to be empty as iterators may be returned
             //as the sequence might be a valid sequence stated in the header
-            if (pq.size()!=0)
+            build_tree();
+            if (!buffer[tree[0]].empty())
             {
                 return true;
             }
@@ -481,7 +571,8 @@ bool BCFSyncedReader::initialize_next_interval()
             fill_buffer(i);
         }
 
-        if (pq.size()!=0)
+        build_tree();
+        if (!buffer[tree[0]].empty())
         {
             return true;
         }
@@ -502,7 +593,7 @@ void BCFSyncedReader::fill_buffer(int32_t i)
 
     if (random_access)
     {
-        int32_t pos1 = buffer[i].size()==0 ? 0 : bcf_get_pos1(buffer[i].front());
+        int32_t pos1 = buffer[i].size()==0 ? 0 : buffer[i].front()->pos1;
 
         if (ftypes[i].format==bcf)
         {
@@ -517,15 +608,14 @@ void BCFSyncedReader::fill_buffer(int32_t i)
                 //check to ensure order
                 if (!buffer[i].empty())
                 {
-                    if (!bcf_is_in_order(buffer[i].back(), v))
+                    if (!bcf_is_in_order(buffer[i].back()->v, v))
                     {
                         fprintf(stderr, "[E:%s:%d %s] VCF file not in order: %s\n", __FILE__, __LINE__, __FUNCTION__, file_names[i].c_str());
                         exit(1);
                     }
                 }
                 
-                buffer[i].push_back(v);
-                insert_into_pq(i, v);
+                insert_into_buffer(i, v);
 
                 if (pos1==0)
                 {
@@ -556,15 +646,14 @@ void BCFSyncedReader::fill_buffer(int32_t i)
                 //check to ensure order
                 if (!buffer[i].empty())
                 {
-                    if (!bcf_is_in_order(buffer[i].back(), v))
+                    if (!bcf_is_in_order(buffer[i].back()->v, v))
                     {
                         fprintf(stderr, "[E:%s:%d %s] VCF file not in order: %s\n", __FILE__, __LINE__, __FUNCTION__, file_names[i].c_str());
                         exit(1);
                     }
                 }
                 
-                buffer[i].push_back(v);
-                insert_into_pq(i, v);
+                insert_into_buffer(i, v);
 
                 if (pos1==0)
                 {
@@ -580,8 +669,8 @@ void BCFSyncedReader::fill_buffer(int32_t i)
     }
     else
     {
-        int32_t rid = buffer[i].size()==0 ? -1 : bcf_get_rid(buffer[i].front());
-        int32_t pos1 = buffer[i].size()==0 ? 0 : bcf_get_pos1(buffer[i].front());
+        int32_t rid = buffer[i].size()==0 ? -1 : buffer[i].front()->rid;
+        int32_t pos1 = buffer[i].size()==0 ? 0 : buffer[i].front()->pos1;
 
         bcf1_t *v = get_bcf1_from_pool();
         bool populated = false;
@@ -594,15 +683,14 @@ void BCFSyncedReader::fill_buffer(int32_t i)
             //check to ensure order
             if (!buffer[i].empty())
             {
-                if (!bcf_is_in_order(buffer[i].back(), v))
+                if (!bcf_is_in_order(buffer[i].back()->v, v))
                 {
                     fprintf(stderr, "[E:%s:%d %s] VCF file not in order: %s\n", __FILE__, __LINE__, __FUNCTION__, file_names[i].c_str());
                     exit(1);
                 }
             }
             
-            buffer[i].push_back(v);
-            insert_into_pq(i, v);
+            insert_into_buffer(i, v);
 
             if (rid==-1)
             {
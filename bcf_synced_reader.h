@@ -33,7 +33,7 @@
 
 /**
  * Wrapper class for the bcf object.
- * Stores the alleles in lexical order.
+ * Stores a fingerprint of the alleles in lexical order.
  */
 class bcfptr
 {
@@ -41,73 +41,33 @@ class bcfptr
     int32_t file_index;
     int32_t rid;
     int32_t pos1;
+    uint64_t fingerprint;
     bcf_hdr_t *h;
     bcf1_t *v;
-    kstring_t alleles;
 
     bcfptr()
     {
         file_index = -1;
         rid = -1;
         pos1 = -1;
+        fingerprint = 0;
+        h = NULL;
         v = NULL;
-        alleles = {0,0,0};
     };
 
-    bcfptr(int32_t file_index, int32_t rid, int32_t pos1, bcf_hdr_t *h, bcf1_t *v, bool sync_by_pos)
+    /**
+     * Sets the record.  The allele fingerprint is computed only when
+     * synchronizing by variant and is 0 otherwise.
+     */
+    void set(int32_t file_index, bcf_hdr_t *h, bcf1_t *v, bool sync_by_pos)
     {
         this->file_index = file_index;
-        this->rid = rid;
-        this->pos1 = pos1;
+        this->rid = bcf_get_rid(v);
+        this->pos1 = bcf_get_pos1(v);
         this->h = h;
         this->v = v;
-        alleles = {0,0,0};
-        if (!sync_by_pos)
-        {
-            //bcf_alleles2string(h, v, &alleles);
-            bcf_alleles2string_sorted(h, v, &alleles);
-        }
+        fingerprint = sync_by_pos ? 0 : bcf_alleles_fingerprint(v);
     };
-
-    ~bcfptr()
-    {
-        if (alleles.m)
-        {
-           free(alleles.s);
-           alleles.m = 0;
-        }
-    }
-};
-
-/**
- * Comparator for BCFPtr class.  Used in priority_queue; ensures that
- * records are ordered according to file order.
- */
-class CompareBCFPtr
-{
-    public:
-    bool operator()(bcfptr *a, bcfptr *b)
-    {
-        if (a->rid == b->rid)
-        {
-            if (a->pos1 == b->pos1)
-            {
-                if (a->alleles.l!=0 && b->alleles.l!=0)
-                {
-                    int32_t d = strcmp(a->alleles.s, b->alleles.s);
-                    return d>=0;
-                }
-                else
-                {
-                    return true;
-                }
-            }
-
-            return a->pos1 >= b->pos1;
-        }
-
-        return a->rid >= b->rid;
-    }
 };
 
 /**
@@ -136,6 +96,11 @@ class CompareBCFPtr
  * A) By start position
  * B) By variant
  *
+ * The records of each file are merged with a loser tree over
+ * the first record of each file.  Records are ordered by
+ * contig, position and, when synchronizing by variant, by a
+ * fingerprint of the sorted alleles.  Ties between files are
+ * broken by the file index.
  */
 class BCFSyncedReader
 {
@@ -172,11 +137,13 @@ class BCFSyncedReader
     kstring_t s;
 
     //buffer for records in use, this is indexed by the file index
-    std::vector<std::list<bcf1_t *> > buffer;
+    //and the records for each file are kept in sorted order
+    std::vector<std::vector<bcfptr *> > buffer;
     //empty records that can be reused
-    std::list<bcf1_t *> pool;
-    //contains the most recent position to process
-    std::priority_queue<bcfptr, std::vector<bcfptr *>, CompareBCFPtr> pq;
+    std::vector<bcf1_t *> pool;
+    std::vector<bcfptr *> bcfptr_pool;
+    //loser tree of file indices, tree[0] is the file with the smallest record
+    std::vector<int32_t> tree;
 
     //useful stuff
 
@@ -186,7 +153,7 @@ class BCFSyncedReader
     BCFSyncedReader(std::vector<std::string>& _vcf_files, std::vector<GenomeInterval>& _intervals, bool sync_by_pos=true);
 
     /**
-     * Compares records based on type of comparison.
+     * Compares records by contig, position and allele fingerprint.
      */
     int32_t bcfptr_cmp(bcfptr *a, bcfptr *b);
 
@@ -243,9 +210,26 @@ class BCFSyncedReader
     void print_buffer();
 
     /**
-     * Inserts a record into pq.
+     * Inserts a record into the sorted buffer of file i.
      */
-    void insert_into_pq(int32_t i, bcf1_t *v);
+    void insert_into_buffer(int32_t i, bcf1_t *v);
+
+    /**
+     * Returns true if the first record of file i precedes that of file j.
+     * Files with empty buffers are ordered last.
+     */
+    bool file_precedes(int32_t i, int32_t j);
+
+    /**
+     * Builds the loser tree from the first record of every file.
+     */
+    void build_tree();
+
+    /**
+     * Replays the matches of file i up the loser tree after its first record
+     * has changed.  File i must be the previous winner.
+     */
+    void replay_tree(int32_t i);
 
     /**
      * Gets records for the most recent position and fills up the buffer for file i.
@@ -272,6 +256,11 @@ class BCFSyncedReader
      */
     void store_bcf1_into_pool(bcf1_t* v);
 
+    /**
+     * Gets record wrapper from pool, creates a new wrapper if necessary
+     */
+    bcfptr* get_bcfptr_from_pool();
+
     /**
      * Gets records for the most recent position and fills up the buffer from file i.
      * returns true if buffer is filled or it is not necessary to fill buffer.
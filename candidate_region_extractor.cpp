@@ -29,12 +29,9 @@
 CandidateRegionExtractor::CandidateRegionExtractor(std::string& ref_fasta_file, bool debug)
 {
     vm = new VariantManip(ref_fasta_file.c_str());
-    fai = fai_load(ref_fasta_file.c_str());
-    if (fai==NULL)
-    {
-        fprintf(stderr, "[%s:%d %s] Cannot load genome index: %s\n", __FILE__, __LINE__, __FUNCTION__, ref_fasta_file.c_str());
-        exit(1);
-    }
+    vm->set_streaming(true);
+    //shares the streaming reference window of vm
+    rs = vm->rs;
 
     max_mlen = 10;
 
@@ -48,7 +45,6 @@ CandidateRegionExtractor::CandidateRegionExtractor(std::string& ref_fasta_file,
 CandidateRegionExtractor::~CandidateRegionExtractor()
 {
     delete vm;
-    fai_destroy(fai);
 
     if (factors)
     {
@@ -218,7 +214,7 @@ void CandidateRegionExtractor::extract_regions_by_exact_alignment(Variant& varia
         max_end1 = end1>max_end1 ? end1 : max_end1;
 
         int32_t seq_len;
-        char* seq = faidx_fetch_seq(fai, chrom, min_beg1-1, max_end1-1, &seq_len);
+        char* seq = rs->fetch_seq(chrom, min_beg1, max_end1, &seq_len);
 
         if (debug)
         {
@@ -230,7 +226,7 @@ void CandidateRegionExtractor::extract_regions_by_exact_alignment(Variant& varia
     }
 
     int32_t seq_len;
-    char* seq = faidx_fetch_seq(fai, chrom, min_beg1-1, max_end1-1, &seq_len);
+    char* seq = rs->fetch_seq(chrom, min_beg1, max_end1, &seq_len);
 
     if (debug)
     {
@@ -255,7 +251,7 @@ void CandidateRegionExtractor::left_align(const char* chrom, int32_t& pos1, std:
     char* seq;
     while (ref.at(ref.size()-1)==alt.at(alt.size()-1) && pos1>1)
     {
-        seq = faidx_fetch_seq(fai, chrom, pos1-2, pos1-2, &seq_len);
+        seq = rs->fetch_seq(chrom, pos1-1, pos1-1, &seq_len);
         if (seq_len)
         {
             ref.erase(ref.size()-1,1);
@@ -282,7 +278,7 @@ void CandidateRegionExtractor::right_align(const char* chrom, int32_t& pos1, std
     char* seq;
     while (ref.at(0)==alt.at(0))
     {
-        seq = faidx_fetch_seq(fai, chrom, pos1, pos1, &seq_len);
+        seq = rs->fetch_seq(chrom, pos1+1, pos1+1, &seq_len);
         if (seq_len)
         {
             ref.erase(0,1);
@@ -339,7 +335,7 @@ void CandidateRegionExtractor::extract_regions_by_fuzzy_alignment(Variant& varia
         max_end1 = fuzzy_right_align(chrom, pos1 + ref.size() - 1, ref, alt, 3);
 
         int32_t seq_len;
-        char* seq = faidx_fetch_seq(fai, chrom, min_beg1-1, max_end1-1, &seq_len);
+        char* seq = rs->fetch_seq(chrom, min_beg1, max_end1, &seq_len);
         if (debug)
         {
             std::cerr << "FUZZY REGION " << min_beg1 << "-" << max_end1 << " (" << max_end1-min_beg1+1 <<") " << "\n";
@@ -350,7 +346,7 @@ void CandidateRegionExtractor::extract_regions_by_fuzzy_alignment(Variant& varia
     }
 
     int32_t seq_len;
-    char* seq = faidx_fetch_seq(fai, chrom, min_beg1-1, max_end1-1, &seq_len);
+    char* seq = rs->fetch_seq(chrom, min_beg1, max_end1, &seq_len);
 
     if (debug)
     {
@@ -387,7 +383,7 @@ uint32_t CandidateRegionExtractor::fuzzy_left_align(const char* chrom, int32_t p
     char* seq;
     while (ref.at(ref.size()-1)==alt.at(alt.size()-1) && pos1>1)
     {
-        seq = faidx_fetch_seq(fai, chrom, pos1-2, pos1-2, &seq_len);
+        seq = rs->fetch_seq(chrom, pos1-1, pos1-1, &seq_len);
         if (seq_len)
         {
             ref.erase(ref.size()-1,1);
@@ -411,7 +407,7 @@ uint32_t CandidateRegionExtractor::fuzzy_left_align(const char* chrom, int32_t p
         uint32_t pos1_ins = pos1;
 
         //substitution
-        seq = faidx_fetch_seq(fai, chrom, pos1-2, pos1-2, &seq_len);
+        seq = rs->fetch_seq(chrom, pos1-1, pos1-1, &seq_len);
         if (seq_len)
         {
             std::string new_ref = ref;
@@ -475,7 +471,7 @@ uint32_t CandidateRegionExtractor::fuzzy_right_align(const char* chrom, int32_t
     char* seq;
     while (ref.at(0)==alt.at(0))
     {
-        seq = faidx_fetch_seq(fai, chrom, pos1, pos1, &seq_len);
+        seq = rs->fetch_seq(chrom, pos1+1, pos1+1, &seq_len);
         if (seq_len)
         {
             ref.erase(0,1);
@@ -499,7 +495,7 @@ uint32_t CandidateRegionExtractor::fuzzy_right_align(const char* chrom, int32_t
         uint32_t pos1_ins = pos1;
 
         //substitution
-        seq = faidx_fetch_seq(fai, chrom, pos1, pos1, &seq_len);
+        seq = rs->fetch_seq(chrom, pos1+1, pos1+1, &seq_len);
         if (seq_len)
         {
             std::string new_ref = ref;
@@ -54,7 +54,7 @@ class CandidateRegionExtractor
     //tools
     ///////
     VariantManip *vm;
-    faidx_t* fai;
+    ReferenceSequence* rs;
    
     //for retrieving sequences
     int8_t* seq;
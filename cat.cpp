@@ -124,6 +124,7 @@ class Igor : Program
         }
         odr = new BCFOrderedReader(input_vcf_files[0], intervals);
         odw = new BCFOrderedWriter(output_vcf_file, sort_window_size, compression_level);
+        odw->enable_index();
         if (no_subset_samples==-1)
         {
             odw->set_hdr(odr->hdr);
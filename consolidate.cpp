@@ -159,7 +159,9 @@ class Igor : Program
         //i/o initialization//
         //////////////////////
         odr = new BCFOrderedReader(input_vcf_file, intervals);
+        if (get_n_hts_threads()>1) odr->enable_prefetch(BCF_UN_STR);
         odw = new BCFOrderedWriter(output_vcf_file, 0);
+        odw->enable_index();
         odw->link_hdr(odr->hdr);
         bcf_hdr_append(odw->hdr, "##FILTER=<ID=overlap_snp,Description=\"Overlaps with SNP.\">");
         bcf_hdr_append(odw->hdr, "##FILTER=<ID=overlap_indel,Description=\"Overlaps with Indel.\">");
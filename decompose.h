@@ -25,6 +25,7 @@
 #define DECOMPOSE_H
 
 #include "program.h"
+#include "multiallelics_decomposer.h"
 
 void decompose(int argc, char ** argv);
 
@@ -41,6 +41,57 @@ struct Triple
     {}
 };
 
+/**
+ * Gets the offsets at which 2 sequences of the same length differ.
+ */
+void find_mismatches(const char* a, const char* b, int32_t len, std::vector<int32_t>& offsets)
+{
+    offsets.clear();
+    int32_t l = 0;
+#if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+    //the first of 8 bases is the least significant byte of a word
+    for (; l+8<=len; l+=8)
+    {
+        uint64_t x, y;
+        memcpy(&x, a+l, 8);
+        memcpy(&y, b+l, 8);
+        uint64_t d = x^y;
+        while (d)
+        {
+            int32_t k = __builtin_ctzll(d)>>3;
+            offsets.push_back(l+k);
+            d &= ~((uint64_t)0xFF<<(k<<3));
+        }
+    }
+#endif
+    for (; l<len; ++l)
+    {
+        if (a[l]!=b[l]) offsets.push_back(l);
+    }
+}
+
+/**
+ * Phases the genotypes of a record in place without decoding them.
+ * Setting the lowest bit of the packed little endian values is the same
+ * as bcf_gt_phased(bcf_gt_allele(gt)) for all values, including the
+ * missing and vector end values.
+ */
+void set_genotypes_phased(bcf_hdr_t *h, bcf1_t *v)
+{
+    bcf_unpack(v, BCF_UN_FMT);
+    bcf_fmt_t *fmt = bcf_get_fmt(h, v, "GT");
+    if (!fmt || !fmt->p)
+    {
+        return;
+    }
+
+    int32_t size = fmt->type==BCF_BT_INT8 ? 1 : (fmt->type==BCF_BT_INT16 ? 2 : 4);
+    for (int32_t i=0; i<fmt->p_len; i+=size)
+    {
+        fmt->p[i] |= 1;
+    }
+}
+
 class Igor : Program
 {
     public:
@@ -65,6 +116,8 @@ class Igor : Program
     kstring_t s;
     kstring_t new_alleles;
     kstring_t old_alleles;
+    std::vector<int32_t> mismatches;
+    std::vector<int32_t> start_pos_of_phased_block;
 
     /////////
     //stats//
@@ -122,6 +175,7 @@ class Igor : Program
         odr = new BCFOrderedReader(input_vcf_file, intervals);
 
         odw = new BCFOrderedWriter(output_vcf_file, 1000);
+        odw->enable_index();
         odw->link_hdr(odr->hdr);
         bcf_hdr_append(odw->hdr, "##INFO=<ID=OLD_CLUMPED,Number=1,Type=String,Description=\"Original chr:pos:ref:alt encoding\">\n");
 
@@ -156,7 +210,7 @@ class Igor : Program
 
         while (odr->read(v))
         {
-            bcf_unpack(v, BCF_UN_ALL);
+            bcf_unpack(v, BCF_UN_SHR);
 
             int32_t n_allele = bcf_get_n_allele(v);
             char** allele = bcf_get_allele(v);
@@ -228,15 +282,18 @@ class Igor : Program
                 old_alleles.l = 0;
                 bcf_variant2string(odw->hdr, v, &old_alleles);
 
+                if (output_phased_genotypes && chunks.size())
+                {
+                    set_phased_block(v, pos1 + chunks[0].pos_ref);
+                }
+
                 for (size_t i=0; i<chunks.size(); ++i)
                 {
                     bcf1_t *nv = odw->get_bcf1_from_pool();
                     bcf_copy(nv, v);
-                    bcf_unpack(nv, BCF_UN_ALL);
+                    bcf_unpack(nv, BCF_UN_SHR);
                     bcf_set_pos1(nv, pos1+chunks[i].pos_ref);
-                    std::vector<int32_t> start_pos_of_phased_block;
-                    int32_t no_samples = bcf_get_n_sample(v);
-                        
+
                     new_alleles.l=0;
                     for (int j=chunks[i].pos_ref; j<chunks[i].pos_ref+chunks[i].len_ref; ++j)
                         kputc(ref[j], &new_alleles);
@@ -247,26 +304,6 @@ class Igor : Program
                     bcf_update_alleles_str(odw->hdr, nv, new_alleles.s);
                     bcf_update_info_string(odw->hdr, nv, "OLD_CLUMPED", old_alleles.s);
 
-                    if (output_phased_genotypes)
-                    {
-                        // Update genotypes with '|' to represent phased blocks, and add PS tag with pos of first
-                        // decomposed variant as block ID.
-                        start_pos_of_phased_block.resize(no_samples, pos1 + chunks[0].pos_ref);
-                        bcf_update_format_int32(odw->hdr, nv, "PS", &start_pos_of_phased_block[0], no_samples);
-
-                        int* gts = NULL; 
-                        int n_gts = 0;
-                        int ploidy = bcf_get_genotypes(odw->hdr, nv, &gts, &n_gts);
-
-                        for (int32_t igt=0; igt < n_gts; ++igt)
-                        {
-                            gts[igt] = bcf_gt_phased(bcf_gt_allele(gts[igt]));
-                        }
-
-                        bcf_update_genotypes(odw->hdr, nv, gts, n_gts);
-                        free(gts);
-                    }
-                    
                     odw->write(nv);
                     kputc('\0', &new_alleles);
 
@@ -283,9 +320,7 @@ class Igor : Program
             {
                 int32_t rid = bcf_get_rid(v);
                 int32_t pos1 = bcf_get_pos1(v);
-                std::vector<int32_t> start_pos_of_phased_block;
-                int32_t no_samples = bcf_get_n_sample(v);
-                
+
                 char** allele = bcf_get_allele(v);
                 char* ref = strdup(allele[0]);
                 char* alt = strdup(allele[1]);
@@ -293,49 +328,34 @@ class Igor : Program
                 old_alleles.l = 0;
                 bcf_variant2string(odw->hdr, v, &old_alleles);
 
-                for (size_t i=0; i<ref_len; ++i)
+                find_mismatches(ref, alt, ref_len, mismatches);
+
+                if (output_phased_genotypes && mismatches.size())
                 {
-                    if (ref[i]!=alt[i])
-                    {
-                        start_pos_of_phased_block.resize(no_samples, pos1 + i);
-                        
-                        bcf1_t *nv = odw->get_bcf1_from_pool();
-                        bcf_copy(nv, v);
-                        bcf_unpack(nv, BCF_UN_ALL);
-
-                        bcf_set_pos1(nv, pos1+i);
-                        new_alleles.l=0;
-                        kputc(ref[i], &new_alleles);
-                        kputc(',', &new_alleles);
-                        kputc(alt[i], &new_alleles);
-
-                        bcf_update_alleles_str(odw->hdr, nv, new_alleles.s);
-                        bcf_update_info_string(odw->hdr, nv, "OLD_CLUMPED", old_alleles.s);
-
-                        if (output_phased_genotypes)
-                        {
-                            // Update genotypes with '|' to represent phased blocks, and add PS tag with pos of first
-                            // decomposed variant as block ID.
-                            bcf_update_format_int32(odw->hdr, nv, "PS", &start_pos_of_phased_block[0], no_samples);
-
-                            int* gts = NULL; 
-                            int n_gts = 0;
-                            int ploidy = bcf_get_genotypes(odw->hdr, nv, &gts, &n_gts);
-
-                            for (int32_t igt=0; igt < n_gts; ++igt)
-                            {
-                                gts[igt] = bcf_gt_phased(bcf_gt_allele(gts[igt]));
-                            }
-
-                            bcf_update_genotypes(odw->hdr, nv, gts, n_gts);
-                            free(gts);
-                        }
-
-                        odw->write(nv);
-
-                        ++new_no_variants;
-                        ++no_additional_snps;
-                    }
+                    set_phased_block(v, pos1 + mismatches[0]);
+                }
+
+                for (size_t j=0; j<mismatches.size(); ++j)
+                {
+                    int32_t i = mismatches[j];
+
+                    bcf1_t *nv = odw->get_bcf1_from_pool();
+                    bcf_copy(nv, v);
+                    bcf_unpack(nv, BCF_UN_SHR);
+
+                    bcf_set_pos1(nv, pos1+i);
+                    new_alleles.l=0;
+                    kputc(ref[i], &new_alleles);
+                    kputc(',', &new_alleles);
+                    kputc(alt[i], &new_alleles);
+
+                    bcf_update_alleles_str(odw->hdr, nv, new_alleles.s);
+                    bcf_update_info_string(odw->hdr, nv, "OLD_CLUMPED", old_alleles.s);
+
+                    odw->write(nv);
+
+                    ++new_no_variants;
+                    ++no_additional_snps;
                 }
 
                 free(ref);
@@ -357,6 +377,24 @@ class Igor : Program
         odr->close();
     };
 
+    /**
+     * Updates genotypes with '|' to represent phased blocks, and adds a PS tag
+     * with the position of the first decomposed variant as block ID.  This is
+     * done once on the block substitution and carried over to the SNPs.
+     */
+    void set_phased_block(bcf1_t *v, int32_t ps)
+    {
+        int32_t no_samples = bcf_get_n_sample(v);
+        if (!no_samples)
+        {
+            return;
+        }
+
+        start_pos_of_phased_block.assign(no_samples, ps);
+        bcf_update_format_int32(odw->hdr, v, "PS", &start_pos_of_phased_block[0], no_samples);
+        set_genotypes_phased(odw->hdr, v);
+    };
+
     void print_options()
     {
         std::clog << "decompose_blocksub v" << version << "\n";
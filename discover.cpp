@@ -227,6 +227,7 @@ class Igor : Program
         s = bam_init1();
 
         odw = new BCFOrderedWriter(output_vcf_file, 0);
+        odw->enable_index();
         bam_hdr_transfer_contigs_to_bcf_hdr(odr->hdr, odw->hdr);
         bcf_hdr_append(odw->hdr, "##QUAL=Variant score of the alternative allele likelihood ratio: -10 * log10 [P(Non variant)/P(Variant)].");
         bcf_hdr_append(odw->hdr, "##ALT=<ID=RSC,Description=\"Right Soft Clip\">");
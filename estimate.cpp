@@ -225,6 +225,7 @@ class Igor : Program
         //////////////////////
         odr = new BCFOrderedReader(input_vcf_file, intervals);
         odw = new BCFOrderedWriter(output_vcf_file);
+        odw->enable_index();
         if (print_sites_only)
         {
             odw->link_hdr(bcf_hdr_subset(odr->hdr, 0, 0, 0));
@@ -23,866 +23,427 @@
 
 #include "filter.h"
 
+//opcodes of compiled filter programs, comparison and arithmetic
+//opcodes are offset by the operand types below
+#define VT_OP_NOT        0
+#define VT_OP_AND_SKIP   1
+#define VT_OP_OR_SKIP    2
+#define VT_OP_AND        3
+#define VT_OP_OR         4
+#define VT_OP_EQ         8
+#define VT_OP_NE         16
+#define VT_OP_LT         24
+#define VT_OP_LE         32
+#define VT_OP_GT         40
+#define VT_OP_GE         48
+#define VT_OP_MATCH      56
+#define VT_OP_NO_MATCH   57
+#define VT_OP_ADD        64
+#define VT_OP_SUB        72
+#define VT_OP_MUL        80
+#define VT_OP_DIV        88
+#define VT_OP_BIT_AND    96
+#define VT_OP_BIT_OR     97
+#define VT_OP_QUAL       104
+#define VT_OP_FILTER     105
+#define VT_OP_N_FILTER   106
+#define VT_OP_INFO_FLG   107
+#define VT_OP_INFO_INT   108
+#define VT_OP_INFO_FLT   109
+#define VT_OP_INFO_STR   110
+#define VT_OP_VTYPE      111
+#define VT_OP_DLEN       112
+#define VT_OP_LEN        113
+#define VT_OP_CONTAINS_N 114
+#define VT_OP_N_ALLELE   115
+#define VT_OP_COUNT      116
+#define VT_OP_ANY        117
+#define VT_OP_SUM        118
+#define VT_OP_MEAN       119
+#define VT_OP_MIN        120
+#define VT_OP_MAX        121
+
+//records over which logic operands are profiled before being reordered
+#define VT_FILTER_PROFILE_RECORDS 10000
+
+//operand types
+#define VT_OPD_II 0
+#define VT_OPD_IF 1
+#define VT_OPD_FI 2
+#define VT_OPD_FF 3
+#define VT_OPD_SS 4
+
+namespace
+{
+
 /**
- * Constructor.
+ * Returns the operand types of a numeric binary operation, -1 if not numeric.
  */
-Node::Node()
+int32_t numeric_operands(int32_t ltype, int32_t rtype)
 {
-    parent = NULL;
-    left = NULL;
-    right = NULL;
-    tag = {0,0,0};
-    s = {0,0,0};
-    regex_set = false;
-};
+    if (ltype&VT_INT)
+    {
+        if (rtype&VT_INT) return VT_OPD_II;
+        if (rtype&VT_FLT) return VT_OPD_IF;
+    }
+    else if (ltype&VT_FLT)
+    {
+        if (rtype&VT_INT) return VT_OPD_FI;
+        if (rtype&VT_FLT) return VT_OPD_FF;
+    }
+
+    return -1;
+}
 
 /**
- * Constructor with type initlialization.
+ * Orders ranked operands of a logic op.
  */
-Node::Node(int32_t type)
+bool compare_rank(const std::pair<float, Node*>& a, const std::pair<float, Node*>& b)
 {
-    parent = NULL;
-    left = NULL;
-    right = NULL;
-    tag = {0,0,0};
-    s = {0,0,0};
-    regex_set = false;
-    this->type = type;
-};
+    return a.first<b.first;
+}
 
 /**
- * Evaluates the actions for this node.
+ * Decodes the first value of an Integer INFO field, returns false if there is none.
  */
-void Node::evaluate(bcf_hdr_t *h, bcf1_t *v, Variant *variant, bool debug)
+inline bool get_info_int(bcf_info_t *info, int32_t &i)
 {
-    if (debug)
-        std::cerr << "evaluation  "  << type2string(type) << "\n";
+    if (!info || !info->vptr || info->len<=0) return false;
 
-    //by default
-    value_exists = true;
-
-    if (type&VT_LOGIC_OP)
+    if (info->len==1)
     {
-        if (!left->value_exists && type==VT_NOT)
+        switch (info->type)
         {
-            if (debug)
-                std::cerr << "\tVT_NOT "   <<  left->b << " \n";
-
-            b = true;
-            return;
-        }
-
-        //think about this, what happens when INFO values are not present, do you treat as a flag?
-        if (!left->value_exists)
-        {
-            b = false;
-            value_exists = false;
-            return;
+            case BCF_BT_INT8:  i = info->v1.i==bcf_int8_missing ? bcf_int32_missing : info->v1.i; return true;
+            case BCF_BT_INT16: i = info->v1.i==bcf_int16_missing ? bcf_int32_missing : info->v1.i; return true;
+            case BCF_BT_INT32: i = info->v1.i; return true;
         }
 
-        if (type==VT_NOT)
-        {
-            if (debug)
-                std::cerr << "\tVT_NOT "   <<  left->b << " \n";
-
-            b = !(left->b);
-            return;
-        }
+        return false;
+    }
 
-        if (!right->value_exists)
+    switch (info->type)
+    {
+        case BCF_BT_INT8:
         {
-            b = false;
-            value_exists = false;
-            return;
+            int8_t x = *(int8_t*)info->vptr;
+            if (x==bcf_int8_vector_end) return false;
+            i = x==bcf_int8_missing ? bcf_int32_missing : x;
+            return true;
         }
-
-        if (type==VT_AND)
+        case BCF_BT_INT16:
         {
-            if (debug)
-                std::cerr << "\tVT_AND "   <<  left->b << "&" << right->b    <<  " \n";
-            b = (left->b && right->b);
-            return;
+            int16_t x = *(int16_t*)info->vptr;
+            if (x==bcf_int16_vector_end) return false;
+            i = x==bcf_int16_missing ? bcf_int32_missing : x;
+            return true;
         }
-        else if (type==VT_OR)
+        case BCF_BT_INT32:
         {
-            b = (left->b || right->b);
-            return;
+            int32_t x = *(int32_t*)info->vptr;
+            if (x==bcf_int32_vector_end) return false;
+            i = x;
+            return true;
         }
     }
-    else if (type&VT_MATH_CMP)
-    {
-        if (!left->value_exists && !right->value_exists)
-        {
-            value_exists = false;
-            return;
-        }
 
-        if (type==VT_EQ)
-        {
-            //if an INFO field is involved and does not exist, then we evaluate as false
-            if (!left->value_exists || !right->value_exists)
-            {
-                value_exists = true;
-                b = false;
-                return;
-            }
-            
-            if ((left->type&VT_INT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    if (debug)
-                        std::cerr << "\tVT_EQ "   <<  left->i << "==" << right->i    <<  " \n";
-                    b = (left->i==right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    if (debug)
-                        std::cerr << "\tVT_EQ "   <<  left->i << "==" << right->f    <<  " \n";
-                    b = (left->i==right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_FLT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    if (debug)
-                        std::cerr << "\tVT_EQ "   <<  left->f << "==" << right->i    <<  " \n";
-                    b = (left->f==right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    if (debug)
-                        std::cerr << "\tVT_EQ "   <<  left->f << "==" << right->f    <<  " \n";
-                    b = (left->f==right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_STR) && (right->type&VT_STR))
-            {
-                if (debug)
-                    std::cerr << "\tVT_EQ "   <<  left->s.s << "&" << right->s.s    <<  " \n";
-                b = strcmp(left->s.s, right->s.s)==0 ? true : false;
-                return;
-            }
+    return false;
+}
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported : == %s %s\n", __FILE__, __LINE__, __FUNCTION__, type2string(left->type).c_str(), type2string(right->type).c_str());
-            exit(1);
-        }
-        else if (type==VT_MATCH)
-        {
-            //if an INFO field is involved and does not exist, then we evaluate as false
-            if (!left->value_exists || !right->value_exists)
-            {
-                value_exists = true;
-                b = false;
-                return;
-            }
-            
-            if ((left->type&VT_STR) && (right->type&VT_STR))
-            {
-                if (debug)
-                    std::cerr << "\tVT_MATCH "   <<  left->s.s << "&" << right->s.s    <<  " \n";
+/**
+ * Decodes the first value of a Float INFO field, returns false if there is none.
+ */
+inline bool get_info_float(bcf_info_t *info, float &f)
+{
+    if (!info || !info->vptr || info->len<=0 || info->type!=BCF_BT_FLOAT) return false;
 
-                if (!regex_set)
-                {
-                    pregex.set(right->s.s);
-                    regex_set = true;
-                }
+    if (info->len==1)
+    {
+        f = info->v1.f;
+        return true;
+    }
 
-                b = pregex.match(left->s.s);
+    f = *(float*)info->vptr;
+    return !bcf_float_is_vector_end(f);
+}
 
-                return;
-            }
+/**
+ * Checks if a FORMAT value is neither missing nor padding.
+ */
+inline bool is_value(int8_t x)
+{
+    return x!=bcf_int8_missing && x!=bcf_int8_vector_end;
+}
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported : =~ %s %s\n", __FILE__, __LINE__, __FUNCTION__, type2string(left->type).c_str(), type2string(right->type).c_str());
-            exit(1);
-        }
-        else if (type==VT_NO_MATCH)
-        {
-            //if an INFO field is involved and does not exist, then we evaluate as false
-            if (!left->value_exists || !right->value_exists)
-            {
-                value_exists = true;
-                b = false;
-                return;
-            }
-            
-            if ((left->type&VT_STR) && (right->type&VT_STR))
-            {
-                if (debug)
-                    std::cerr << "\tVT_NO_MATCH "   <<  left->s.s << "&" << right->s.s    <<  " \n";
+/**
+ * Checks if a FORMAT value is neither missing nor padding.
+ */
+inline bool is_value(int16_t x)
+{
+    return x!=bcf_int16_missing && x!=bcf_int16_vector_end;
+}
 
-                if (!regex_set)
-                {
-                    pregex.set(right->s.s);
-                    regex_set = true;
-                }
+/**
+ * Checks if a FORMAT value is neither missing nor padding.
+ */
+inline bool is_value(int32_t x)
+{
+    return x!=bcf_int32_missing && x!=bcf_int32_vector_end;
+}
 
-                b = !pregex.match(left->s.s);
+/**
+ * Checks if a FORMAT value is neither missing nor padding.
+ */
+inline bool is_value(float x)
+{
+    return !bcf_float_is_missing(x) && !bcf_float_is_vector_end(x);
+}
 
-                return;
-            }
+/**
+ * Counts the samples whose first value satisfies the comparison with c.
+ * The loops are kept free of branches so that they vectorize.
+ */
+template <class T>
+int32_t count_values(const uint8_t* p, int32_t n_sample, int32_t size, int32_t cmp, double c)
+{
+    int32_t count = 0;
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported : ~~ %s %s\n", __FILE__, __LINE__, __FUNCTION__, type2string(left->type).c_str(), type2string(right->type).c_str());
-            exit(1);
+    #define COUNT_VALUES(op) \
+        for (int32_t k=0; k<n_sample; ++k) \
+        { \
+            T x = *(const T*)(p+k*size); \
+            count += is_value(x) && x op c; \
         }
-        else if (type==VT_NE)
-        {
-            //fprintf(stderr, "[%s:%d %s] check: %s %s: !=\n", __FILE__, __LINE__, __FUNCTION__, type2string(left->type).c_str(), type2string(right->type).c_str());
-            
-            //if an INFO field is involved and does not exist, then we evaluate as false
-            if (!left->value_exists || !right->value_exists)
-            {
-                value_exists = true;
-                b = false;
-                return;
-            }
 
-            if ((left->type&VT_INT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    b = (left->i!=right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    b = (left->i!=right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_FLT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    b = (left->f!=right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    b = (left->f!=right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_STR) && (right->type&VT_STR))
-            {
-                b = strcmp(left->s.s, right->s.s)==0 ? false : true;
-                return;
-            }
+    switch (cmp)
+    {
+        case VT_EQ: COUNT_VALUES(==); break;
+        case VT_NE: COUNT_VALUES(!=); break;
+        case VT_LT: COUNT_VALUES(<); break;
+        case VT_LE: COUNT_VALUES(<=); break;
+        case VT_GT: COUNT_VALUES(>); break;
+        case VT_GE: COUNT_VALUES(>=); break;
+    }
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported: %s %s: !=\n", __FILE__, __LINE__, __FUNCTION__, type2string(left->type).c_str(), type2string(right->type).c_str());
-            exit(1);
-        }
-        else if (type==VT_LE)
-        {
-            //if an INFO field is involved and does not exist, then we evaluate as false
-            if (!left->value_exists || !right->value_exists)
-            {
-                value_exists = true;
-                b = false;
-                return;
-            }
-            
-            if ((left->type&VT_INT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    b = (left->i<=right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    b = (left->i<=right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_FLT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    type |= VT_INT;
-                    b = (left->f<=right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    b = (left->f<=right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_STR) && (right->type&VT_STR))
-            {
-                b = strcmp(left->s.s, right->s.s)<=0 ? true : false;
-                return;
-            }
+    #undef COUNT_VALUES
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported: %s %s: <=\n", __FILE__, __LINE__, __FUNCTION__, type2string(left->type).c_str(), type2string(right->type).c_str());
-            exit(1);
-        }
-        else if (type==VT_GE)
-        {
-            //if an INFO field is involved and does not exist, then we evaluate as false
-            if (!left->value_exists || !right->value_exists)
-            {
-                value_exists = true;
-                b = false;
-                return;
-            }
-            
-            if ((left->type&VT_INT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    b = (left->i>=right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    b = (left->i>=right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_FLT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    b = (left->f>=right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    b = (left->f>=right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_STR) && (right->type&VT_STR))
-            {
-                b = strcmp(left->s.s, right->s.s)>=0 ? true : false;
-                return;
-            }
+    return count;
+}
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported: %s %s: >=\n", __FILE__, __LINE__, __FUNCTION__, type2string(left->type).c_str(), type2string(right->type).c_str());
-            exit(1);
-        }
-        else if (type==VT_GT)
-        {
-            //if an INFO field is involved and does not exist, then we evaluate as false
-            if (!left->value_exists || !right->value_exists)
-            {
-                value_exists = true;
-                b = false;
-                return;
-            }
-            
-            if ((left->type&VT_INT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    b = (left->i>right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    b = (left->i>right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_FLT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    b = (left->f>right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    b = (left->f>right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_STR) && (right->type&VT_STR))
-            {
-                b = strcmp(left->s.s, right->s.s)>0 ? true : false;
-                return;
-            }
+/**
+ * Counts the samples whose genotype equals the encoded genotype gt.
+ */
+template <class T>
+int32_t count_genotypes(const uint8_t* p, int32_t n_sample, int32_t size, int32_t n, const std::vector<int32_t>& gt, T vector_end)
+{
+    //genotypes with more alleles than the maximum ploidy never match
+    int32_t ploidy = gt.size();
+    if (ploidy>n) return 0;
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported: %s %s: >\n", __FILE__, __LINE__, __FUNCTION__, type2string(left->type).c_str(), type2string(right->type).c_str());
-            exit(1);
+    int32_t count = 0;
+    for (int32_t k=0; k<n_sample; ++k)
+    {
+        const T* x = (const T*)(p+k*size);
+        bool equal = true;
+        for (int32_t j=0; j<ploidy; ++j)
+        {
+            equal = equal && x[j]==gt[j];
         }
-        else if (type==VT_LT)
+        for (int32_t j=ploidy; j<n; ++j)
         {
-            //if an INFO field is involved and does not exist, then we evaluate as false
-            if (!left->value_exists || !right->value_exists)
-            {
-                value_exists = true;
-                b = false;
-                return;
-            }
-            
-            if ((left->type&VT_INT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    if (debug)
-                        std::cerr << "\tVT_LT "   <<  left->i << "<" << right->i    <<  " \n";
-                        
-                    b = (left->i<right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    if (debug)
-                        std::cerr << "\tVT_LT "   <<  left->i << "<" << right->f    <<  " \n";
-                            
-                    b = (left->i<right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_FLT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    if (debug)
-                        std::cerr << "\tVT_LT "   <<  left->f << "<" << right->i    <<  " \n";
-                            
-                    b = (left->f<right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    if (debug)
-                        std::cerr << "\tVT_LT "   <<  left->f << "<" << right->f    <<  " \n";
-                            
-                    b = (left->f<right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_STR) && (right->type&VT_STR))
-            {
-                if (debug)
-                        std::cerr << "\tVT_LT "   <<  left->s.s << "<" << right->s.s    <<  " \n";
-                            
-                b = strcmp(left->s.s, right->s.s)<0 ? true : false;
-                return;
-            }
-
-            fprintf(stderr, "[%s:%d %s] evaluation not supported: %s %s: <\n", __FILE__, __LINE__, __FUNCTION__, type2string(left->type).c_str(), type2string(right->type).c_str());
-            exit(1);
+            equal = equal && x[j]==vector_end;
         }
+        count += equal;
     }
-    else if (type&VT_BCF_OP)
+
+    return count;
+}
+
+/**
+ * Counts the samples whose string equals s.
+ */
+int32_t count_strings(const uint8_t* p, int32_t n_sample, int32_t size, const char* s)
+{
+    int32_t len = strlen(s);
+    if (len>size) return 0;
+
+    int32_t count = 0;
+    for (int32_t k=0; k<n_sample; ++k)
     {
-        value_exists = true;
+        const char* x = (const char*)(p+k*size);
+        count += memcmp(x, s, len)==0 && (len==size || x[len]==0);
+    }
+
+    return count;
+}
+
+/**
+ * Counts the samples satisfying the comparison of a COUNT or ANY instruction.
+ */
+int32_t count_samples(bcf_fmt_t *fmt, int32_t n_sample, FilterInstruction& ins, FilterRegister& c)
+{
+    int32_t count = 0;
 
-        if (type==VT_QUAL)
+    if (ins.gt.size())
+    {
+        switch (fmt->type)
         {
-            if (bcf_float_is_missing(bcf_get_qual(v)))
-            {
-                f = -1;
-                value_exists = false;
-            }
-            else
-            {
-                f = bcf_get_qual(v);
-                value_exists = true;
-            }
+            case BCF_BT_INT8:  count = count_genotypes<int8_t>(fmt->p, n_sample, fmt->size, fmt->n, ins.gt, bcf_int8_vector_end); break;
+            case BCF_BT_INT16: count = count_genotypes<int16_t>(fmt->p, n_sample, fmt->size, fmt->n, ins.gt, bcf_int16_vector_end); break;
+            case BCF_BT_INT32: count = count_genotypes<int32_t>(fmt->p, n_sample, fmt->size, fmt->n, ins.gt, bcf_int32_vector_end); break;
         }
-        else if (type==VT_FILTER)
-        {
-            bcf_unpack(v, BCF_UN_FLT);
-            if (bcf_get_n_filter(v) && bcf_has_filter(h, v, tag.s))
-            {
-                b = true;
-            }
-            else
-            {
-                b = false;
-            }
-        }
-        else if (type==VT_N_FILTER)
-        {
-            i = bcf_get_n_filter(v);
-            f = i;
-            b = true;
-            value_exists = true;
-        }
-        else if (type==VT_INFO) //figure out type
-        {
-            if (!bcf_hdr_idinfo_exists(h, BCF_HL_INFO, bcf_hdr_id2int(h, BCF_DT_ID, tag.s)))
-            {
-                fprintf(stderr, "[%s:%d %s] INFO tag %s does not exist in header of VCF file.\n", __FILE__, __LINE__, __FUNCTION__, tag.s);
-                exit(1);
-            }
-
-            int32_t info_type = bcf_hdr_id2type(h, BCF_HL_INFO, bcf_hdr_id2int(h, BCF_DT_ID, tag.s));
-            bcf_unpack(v, BCF_UN_INFO);
-             
-            if (info_type==BCF_HT_FLAG)
-            {
-                type |= VT_FLG;
-                if (bcf_get_info_flag(h, v, tag.s, 0, 0)>0)
-                {
-                    i = 1;
-                    f = 1;
-                    b = true;
-                    s.l=0;
-                }
-                else
-                {
-                    b = false;
-                    value_exists = false;
-                }
-            }
-            else if (info_type==BCF_HT_INT)
-            {
-                type |= VT_INT;
-                int32_t ns = 0;
-                int32_t *is = NULL;
-                if (bcf_get_info_int32(h, v, tag.s, &is, &ns)>0)
-                {
-                    i = is[0];
-                    f = (float)is[0];
-                }
-                else
-                {
-                    b = false;
-                    value_exists = false;
-                }
-
-                if (ns) free(is);
-            }
-            else if (info_type==BCF_HT_REAL)
-            {
-                type |= VT_FLT;
-                int32_t ns = 0;
-                float *fs = NULL;
-                if (bcf_get_info_float(h, v, tag.s, &fs, &ns)>0)
-                {
-                    b = true;
-                    i = (int32_t)fs[0];
-                    f = fs[0];
-                }
-                else
-                {
-                    b = false;
-                    value_exists = false;
-                }
 
-                if (ns) free(fs);
-            }
-            else if (info_type==BCF_HT_STR)
-            {
-                type |= VT_STR;
-                //todo: how do you handle a vector of strings?
+        return ins.cmp==VT_EQ ? count : n_sample-count;
+    }
+    else if (fmt->type==BCF_BT_CHAR)
+    {
+        count = count_strings(fmt->p, n_sample, fmt->size, c.s.s);
+        return ins.cmp==VT_EQ ? count : n_sample-count;
+    }
 
-                int32_t n = s.m;
-                if (bcf_get_info_string(h, v, tag.s, &s.s, &n)>0)
-                {
-                    b = true;
-                    s.m = n;
-                }
-                else
-                {
-                    b = false;
-                    value_exists = false;
-                }
-            }
-        }
-        else if (type==(VT_INFO|VT_INT))
-        {
-            int32_t *data = NULL;
-            int32_t n=0;
+    double x = (c.type&VT_INT) ? c.i : c.f;
+    switch (fmt->type)
+    {
+        case BCF_BT_INT8:  return count_values<int8_t>(fmt->p, n_sample, fmt->size, ins.cmp, x);
+        case BCF_BT_INT16: return count_values<int16_t>(fmt->p, n_sample, fmt->size, ins.cmp, x);
+        case BCF_BT_INT32: return count_values<int32_t>(fmt->p, n_sample, fmt->size, ins.cmp, x);
+        case BCF_BT_FLOAT: return count_values<float>(fmt->p, n_sample, fmt->size, ins.cmp, x);
+    }
 
-            if (bcf_get_info_int32(h, v, tag.s, &data, &n)>0)
-            {
-                b = true;
-                i = data[0];
-                f = (float) i;
-            }
-            else
-            {
-                b = false;
-                value_exists = false;
-            }
+    return 0;
+}
 
-            if (n) free(data);
-        }
-        else if (type==(VT_INFO|VT_FLT))
+/**
+ * Sums the first values of the samples and finds their extremes, returns the number of values.
+ */
+template <class T>
+int32_t aggregate_values(const uint8_t* p, int32_t n_sample, int32_t size, double& sum, double& min, double& max)
+{
+    int32_t count = 0;
+    for (int32_t k=0; k<n_sample; ++k)
+    {
+        T x = *(const T*)(p+k*size);
+        if (is_value(x))
         {
-            float *data = NULL;
-            int32_t n = 0;
-
-            if (bcf_get_info_float(h, v, tag.s, &data, &n)>0)
-            {   
-                b = true;
-                i = (int32_t) data[0];
-                f = data[0];
-            }
-            else
-            {
-                b = false;
-                value_exists = false;
-            }
-
-            if (n) free(data);
+            sum += x;
+            min = (count==0 || x<min) ? x : min;
+            max = (count==0 || x>max) ? x : max;
+            ++count;
         }
-        else if (type==(VT_INFO|VT_STR))
-        {
-            int32_t n = s.m;
+    }
 
-            if (bcf_get_info_string(h, v, tag.s, &s.s, &n)>0)
-            {
-                b = true;
-                s.m = n;
-            }
-            else
-            {
-                b = false;
-                value_exists = false;
-            }
-        }
-        else if (type==(VT_INFO|VT_FLG))
-        {
-            if (bcf_get_info_flag(h, v, tag.s, 0, 0)>0)
-            {
-                b = true;
-            }
-            else
-            {
-                b = false;
-            }
+    return count;
+}
 
-            if (debug)
-                std::cerr << "\tVT_INFO|VT_FLG "   << i << " " << f << " " << b << " " << s.s <<  " \n";
-        }
-        else if (type==VT_VARIANT_TYPE)
-        {
-            if (debug)
-                std::cerr << "\tVTYPE "   <<  Variant::vtype2string(variant->type) <<  " \n";
-            i = variant->type;
-            b = i;
-        }
-        else if (type==VT_VARIANT_DLEN)
-        {
-            if (debug)
-                std::cerr << "\tDLEN "   <<  variant->alleles[0].dlen <<  " \n";
-            i = variant->alleles[0].dlen;
-            f = i;
-        }
-        else if (type==VT_VARIANT_LEN)
-        {
-            if (debug)
-                std::cerr << "\tLEN "   <<  abs(variant->alleles[0].dlen) <<  " \n";
-            i = abs(variant->alleles[0].dlen);
-            f = i;
-        }
-        else if (type==VT_VARIANT_CONTAINS_N)
-        {
-            if (debug)
-                std::cerr << "\tVARIANT_CONTAINS_N "   <<  variant->contains_N <<  " \n";
-            
-            bcf_unpack(v, BCF_UN_FLT);
-            b = variant->contains_N;
-        }
-        else if (type==VT_N_ALLELE)
-        {
-            if (debug)
-                std::cerr << "\tN_ALLELE "   <<  bcf_get_n_allele(v) <<  " \n";
-            i = bcf_get_n_allele(v);
-            f = i;
-        }
-    }
-    else if (type&VT_MATH_OP)
+/**
+ * Computes the SUM, MEAN, MIN or MAX of a FORMAT field over samples, returns false if no sample has a value.
+ */
+bool aggregate_samples(bcf_fmt_t *fmt, int32_t n_sample, int32_t op, double& x)
+{
+    double sum = 0, min = 0, max = 0;
+    int32_t count = 0;
+    if (fmt && fmt->p)
     {
-        if (!left->value_exists && !right->value_exists)
+        switch (fmt->type)
         {
-            value_exists = false;
-            return;
+            case BCF_BT_INT8:  count = aggregate_values<int8_t>(fmt->p, n_sample, fmt->size, sum, min, max); break;
+            case BCF_BT_INT16: count = aggregate_values<int16_t>(fmt->p, n_sample, fmt->size, sum, min, max); break;
+            case BCF_BT_INT32: count = aggregate_values<int32_t>(fmt->p, n_sample, fmt->size, sum, min, max); break;
+            case BCF_BT_FLOAT: count = aggregate_values<float>(fmt->p, n_sample, fmt->size, sum, min, max); break;
         }
+    }
 
-        if ((type&15)==11) //ADD
-        {
-            if ((left->type&VT_INT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    type |= VT_INT;
-                    i = (left->i+right->i);
-                    f = i;
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    type |= VT_FLT;
-                    f = (left->i+right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_FLT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    type |= VT_FLT;
-                    f = (left->f+right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    type |= VT_FLT;
-                    f = (left->f+right->f);
-                    return;
-                }
-            }
+    if (count)
+    {
+        x = op==VT_OP_SUM ? sum : (op==VT_OP_MEAN ? sum/count : (op==VT_OP_MIN ? min : max));
+    }
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported : +\n", __FILE__, __LINE__, __FUNCTION__);
-            exit(1);
-        }
-        else if ((type&15)==12) //SUB
-        {
-            if ((left->type&VT_INT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    type |= VT_INT;
-                    i = (left->i-right->i);
-                    f = i;
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    type |= VT_FLT;
-                    f = (left->i-right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_FLT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    type |= VT_FLT;
-                    f = (left->f-right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    type |= VT_FLT;
-                    f = (left->f-right->f);
-                    return;
-                }
-            }
+    return count>0;
+}
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported : -\n", __FILE__, __LINE__, __FUNCTION__);
-            exit(1);
-        }
-        else if ((type&15)==13) //MUL
-        {
-            if ((left->type&VT_INT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    type |= VT_INT;
-                    i = (left->i*right->i);
-                    f = i;
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    type |= VT_FLT;
-                    f = (left->i*right->f);
-                    return;
-                }
-            }
-            else if ((left->type&VT_FLT))
-            {
-                if ((right->type&VT_INT))
-                {
-                    type |= VT_FLT;
-                    f = (left->f*right->i);
-                    return;
-                }
-                else if ((right->type&VT_FLT))
-                {
-                    type |= VT_FLT;
-                    f = (left->f*right->f);
-                    return;
-                }
-            }
+}
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported : *\n", __FILE__, __LINE__, __FUNCTION__);
-            exit(1);
-        }
-        else if ((type&15)==14) //DIV
-        {
-            if (left->type&VT_INT)
-            {
-                if (right->type&VT_INT)
-                {
-                    type |= VT_FLT;
-                    f = ((float)left->i/right->i);
-                    return;
-                }
-                else if (right->type&VT_FLT)
-                {
-                    type |= VT_FLT;
-                    f = (left->i/right->f);
-                    return;
-                }
-            }
-            else if (left->type&VT_FLT)
-            {
-                if (right->type&VT_INT)
-                {
-                    type |= VT_FLT;
-                    f = (left->f/right->i);
-                    return;
-                }
-                else if (right->type&VT_FLT)
-                {
-                    type |= VT_FLT;
-                    f = (left->f/right->f);
-                    return;
-                }
-            }
+/**
+ * Constructor.
+ */
+Node::Node()
+{
+    parent = NULL;
+    left = NULL;
+    right = NULL;
+    tag = {0,0,0};
+    value_exists = false;
+    s = {0,0,0};
+    b = false;
+    i = 0;
+    f = 0;
+    regex_set = false;
+    no_evaluated = 0;
+    no_passed = 0;
+};
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported : /\n", __FILE__, __LINE__, __FUNCTION__);
-            exit(1);
-        }
-        else if ((type&15)==15) //BIT AND
-        {
-            if ((left->type&VT_INT) && (right->type&VT_INT))
-            {
-                i = (left->i & right->i);
-                b = i;
-                return;
-            }
+/**
+ * Constructor with type initlialization.
+ */
+Node::Node(int32_t type)
+{
+    parent = NULL;
+    left = NULL;
+    right = NULL;
+    tag = {0,0,0};
+    value_exists = false;
+    s = {0,0,0};
+    b = false;
+    i = 0;
+    f = 0;
+    regex_set = false;
+    no_evaluated = 0;
+    no_passed = 0;
+    this->type = type;
+};
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported for & :  %d %d\n", __FILE__, __LINE__, __FUNCTION__, left->type, right->type);
-            exit(1);
-        }
-        else if ((type&15)==16) //BIT OR
-        {
-            if ((left->type&VT_INT) && (right->type&VT_INT))
-            {
-                i = (left->i | right->i);
-                b = i;
-                return;
-            }
+/**
+ * Constructor.
+ */
+FilterRegister::FilterRegister()
+{
+    type = VT_UNKNOWN;
+    value_exists = false;
+    s = {0,0,0};
+    b = false;
+    i = 0;
+    f = 0;
+};
 
-            fprintf(stderr, "[%s:%d %s] evaluation not supported for | : %d %d\n", __FILE__, __LINE__, __FUNCTION__, left->type, right->type);
-            exit(1);
-        }
-        else
-        {
-            fprintf(stderr, "[%s:%d %s] math op not supported : %d\n", __FILE__, __LINE__, __FUNCTION__, (type&15));
-            exit(1);
-        }
+/**
+ * Grows the column to hold at least n records.
+ */
+void FilterColumn::resize(int32_t n)
+{
+    if ((int32_t)b.size()<n)
+    {
+        value_exists.resize(n);
+        b.resize(n);
+        i.resize(n);
+        f.resize(n);
     }
 }
 
+/**
+ * Constructor.
+ */
+FilterInstruction::FilterInstruction(int32_t op, int32_t dst, int32_t a, int32_t b, Node* node)
+{
+    this->op = op;
+    this->dst = dst;
+    this->a = a;
+    this->b = b;
+    this->jump = -1;
+    this->id = -1;
+    this->cmp = -1;
+    this->node = node;
+};
+
 /**
  * Converts type to string.
  */
@@ -991,6 +552,48 @@ std::string Node::type2string(int32_t type)
         s += "VARIANT_LEN";
     }
 
+    if (type==VT_FORMAT)
+    {
+        s += (s==""? "" : "|");
+        s += "FORMAT";
+    }
+
+    if (type==VT_COUNT)
+    {
+        s += (s==""? "" : "|");
+        s += "COUNT";
+    }
+
+    if (type==VT_ANY)
+    {
+        s += (s==""? "" : "|");
+        s += "ANY";
+    }
+
+    if (type==VT_SUM)
+    {
+        s += (s==""? "" : "|");
+        s += "SUM";
+    }
+
+    if (type==VT_MEAN)
+    {
+        s += (s==""? "" : "|");
+        s += "MEAN";
+    }
+
+    if (type==VT_MIN)
+    {
+        s += (s==""? "" : "|");
+        s += "MIN";
+    }
+
+    if (type==VT_MAX)
+    {
+        s += (s==""? "" : "|");
+        s += "MAX";
+    }
+
     return s;
 };
 
@@ -1000,6 +603,11 @@ std::string Node::type2string(int32_t type)
 Filter::Filter()
 {
     this->tree = NULL;
+    this->compiled_h = NULL;
+    this->batchable = false;
+    this->profile = true;
+    this->no_profiled_records = 0;
+    this->reordered = false;
 };
 
 /**
@@ -1008,6 +616,11 @@ Filter::Filter()
 Filter::Filter(std::string exp)
 {
     this->tree = NULL;
+    this->compiled_h = NULL;
+    this->batchable = false;
+    this->profile = true;
+    this->no_profiled_records = 0;
+    this->reordered = false;
     parse(exp.c_str(), false);
 };
 
@@ -1016,6 +629,10 @@ Filter::Filter(std::string exp)
  */
 void Filter::parse(const char* exp, bool debug)
 {
+    compiled_h = NULL;
+    profile = true;
+    no_profiled_records = 0;
+
     if (strlen(exp)!=0)
     {
         //trim the white spaces out of the string
@@ -1054,24 +671,43 @@ void Filter::parse(const char* exp, bool debug)
 /**
  * Applies filter to vcf record.
  */
-bool Filter::apply(bcf_hdr_t *h, bcf1_t *v, Variant *variant, bool debug) //recursive
+bool Filter::apply(bcf_hdr_t *h, bcf1_t *v, Variant *variant, bool debug)
 {
     if (tree==NULL)
     {
         return true;
     }
 
-    this->h = h;
+    //the program is specific to the tag IDs of a header
+    if (h!=compiled_h)
+    {
+        compile(h, debug);
+    }
+
+    //reorder logic operands by their observed pass rates
+    if (profile && no_profiled_records==VT_FILTER_PROFILE_RECORDS)
+    {
+        profile = false;
+        reordered = false;
+        simplify();
+        if (reordered)
+        {
+            compile(h, debug);
+        }
+    }
+
     this->v = v;
     this->variant = variant;
 
     if (debug) std::cerr << "==========\n";
-    apply(tree, debug);
+    execute(debug);
     if (debug) std::cerr << "==========\n";
 
-    if (tree->value_exists)
+    if (profile) ++no_profiled_records;
+
+    if (registers[result].value_exists)
     {
-        return tree->b;
+        return registers[result].b;
     }
     else
     {
@@ -1080,11 +716,50 @@ bool Filter::apply(bcf_hdr_t *h, bcf1_t *v, Variant *variant, bool debug) //recu
 }
 
 /**
- * Constructs the expression tree.
+ * Applies filter to a batch of n vcf records, pass[k] is set if the kth record passes.
  */
-void Filter::parse(const char* exp, int32_t len, Node *node, bool debug)
+void Filter::apply(bcf_hdr_t *h, bcf1_t **v, Variant *variants, int32_t n, std::vector<bool>& pass, bool debug)
 {
-    if (debug)
+    pass.resize(n);
+
+    if (tree==NULL)
+    {
+        pass.assign(n, true);
+        return;
+    }
+
+    if (h!=compiled_h)
+    {
+        compile(h, debug);
+    }
+
+    //records are evaluated one at a time while profiling and when values are carried over between records
+    if (profile || !batchable)
+    {
+        for (int32_t k=0; k<n; ++k)
+        {
+            pass[k] = apply(h, v[k], &variants[k], debug);
+        }
+        return;
+    }
+
+    if (debug) std::cerr << "==========\n";
+    execute(v, variants, n, debug);
+    if (debug) std::cerr << "==========\n";
+
+    FilterColumn& r = columns[result];
+    for (int32_t k=0; k<n; ++k)
+    {
+        pass[k] = r.value_exists[k] && r.b[k];
+    }
+}
+
+/**
+ * Constructs the expression tree.
+ */
+void Filter::parse(const char* exp, int32_t len, Node *node, bool debug)
+{
+    if (debug)
     {
         std::cerr << "parsing \"";
         for (int32_t i=0; i<len; ++i)
@@ -1099,6 +774,18 @@ void Filter::parse(const char* exp, int32_t len, Node *node, bool debug)
     while (exp[len-1]==' ') --len;
     trim_brackets(exp, len, debug);
 
+    //aggregation over samples
+    int32_t aggregate_type = is_aggregate(exp, len, debug);
+    if (aggregate_type)
+    {
+        node->type = aggregate_type;
+
+        const char* start = strchr(exp, '(')+1;
+        node->left = new Node();
+        parse(start, len-(start-exp)-1, node->left, debug);
+        return;
+    }
+
     //this is a literal
     if (is_literal(exp, len, debug))
     {
@@ -1192,6 +879,76 @@ bool Filter::is_unary_op(const char* exp, int32_t len, bool debug)
     return false;
 }
 
+/**
+ * Checks if exp is an aggregation over samples, returns its type, 0 otherwise.
+ */
+int32_t Filter::is_aggregate(const char* exp, int32_t len, bool debug)
+{
+    int32_t type = 0;
+    int32_t n = 0;
+
+    if (len>6 && strncmp(exp, "COUNT(", 6)==0)
+    {
+        type = VT_COUNT;
+        n = 5;
+    }
+    else if (len>5 && strncmp(exp, "MEAN(", 5)==0)
+    {
+        type = VT_MEAN;
+        n = 4;
+    }
+    else if (len>4 && strncmp(exp, "ANY(", 4)==0)
+    {
+        type = VT_ANY;
+        n = 3;
+    }
+    else if (len>4 && strncmp(exp, "SUM(", 4)==0)
+    {
+        type = VT_SUM;
+        n = 3;
+    }
+    else if (len>4 && strncmp(exp, "MIN(", 4)==0)
+    {
+        type = VT_MIN;
+        n = 3;
+    }
+    else if (len>4 && strncmp(exp, "MAX(", 4)==0)
+    {
+        type = VT_MAX;
+        n = 3;
+    }
+    else
+    {
+        return 0;
+    }
+
+    //the bracket after the name has to close the expression
+    int32_t opened_brackets = 0;
+    for (int32_t j=n; j<len; ++j)
+    {
+        if (exp[j]=='(')
+        {
+            ++opened_brackets;
+        }
+        else if (exp[j]==')')
+        {
+            --opened_brackets;
+            if (opened_brackets==0 && j!=len-1)
+            {
+                return 0;
+            }
+        }
+    }
+
+    if (opened_brackets!=0)
+    {
+        return 0;
+    }
+
+    if (debug) std::cerr << "\tis aggregate\n";
+    return type;
+}
+
 /**
  * Checks is expression is bracketed.
  */
@@ -1251,6 +1008,11 @@ bool Filter::is_literal(const char* exp, int32_t len, bool debug)
         return true;
     }
 
+    if (exp==strchr(exp,'"') && exp+len-1==strchr(exp+1,'"'))
+    {
+        return true;
+    }
+
     const char* q = exp;
     while (q-exp<len)
     {
@@ -1320,6 +1082,14 @@ void Filter::parse_literal(const char* exp, int32_t len, Node * node, bool debug
         if (debug) std::cerr << "\tis info_op\n";
         return;
     }
+    else if (strncmp(exp, "FMT.", 4)==0)
+    {
+        node->type = VT_FORMAT;
+        exp += 4;
+        kputsn(exp, len-4, &node->tag);
+        if (debug) std::cerr << "\tis format_op\n";
+        return;
+    }
     else if (strncmp(exp, "VTYPE", 5)==0)
     {
         node->type = VT_VARIANT_TYPE;
@@ -1437,7 +1207,7 @@ void Filter::parse_literal(const char* exp, int32_t len, Node * node, bool debug
         }
 
         //string type
-        if (exp[0]=='\'' && exp[len-1]=='\'')
+        if ((exp[0]=='\'' && exp[len-1]=='\'') || (exp[0]=='"' && exp[len-1]=='"'))
         {
             node->type = VT_STR;
             kputsn(exp+1, len-2, &node->tag);
@@ -1501,6 +1271,14 @@ void Filter::print_filter_help()
     fprintf(stderr, "  Passed Common biallelic SNPs only           : PASS&&VTYPE==SNP&&N_ALLELE==2&&INFO.AF>0.005\n");
     fprintf(stderr, "  Passed Common biallelic SNPs or rare indels : (PASS&&VTYPE==SNP&&N_ALLELE==2&&INFO.AF>0.005)||(VTYPE&INDEL&&INFO.AF<=0.005)\n");
     fprintf(stderr, "\n");
+    fprintf(stderr, "  FORMAT fields aggregated over samples\n");
+    fprintf(stderr, "    COUNT(FMT.<tag><op><value>), ANY(FMT.<tag><op><value>)\n");
+    fprintf(stderr, "    SUM(FMT.<tag>), MEAN(FMT.<tag>), MIN(FMT.<tag>), MAX(FMT.<tag>)\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  Variants with at least 10 samples of GQ>20    : COUNT(FMT.GQ>20)>=10\n");
+    fprintf(stderr, "  Variants with a homozygous alternate sample   : ANY(FMT.GT=='1/1')\n");
+    fprintf(stderr, "  Variants with a mean depth above 15           : MEAN(FMT.DP)>15\n");
+    fprintf(stderr, "\n");
     fprintf(stderr, "  Regular expressions for string fields using pcre2\n");
     fprintf(stderr, "\n");
     fprintf(stderr, "  Passed variants in intergenic regions or UTR : PASS&&INFO.ANNO=~'Intergenic|UTR'\n");
@@ -1679,132 +1457,1307 @@ int32_t Filter::peek_op(const char* &r, int32_t len, int32_t &oplen, bool debug)
         oplen = 2;
         return VT_MATCH;
     }
-    else if (*s=='~' && (s+1-r<len) && *(s+1)=='~')
+    else if (*s=='~' && (s+1-r<len) && *(s+1)=='~')
+    {
+        if (debug) std::cerr << "\tis ~~ operator\n";
+        oplen = 2;
+        return VT_NO_MATCH;
+    }
+    else if (*s=='>' && (s+1-r<len) && *(s+1)=='=')
+    {
+        if (debug) std::cerr << "\tis >= operator\n";
+        oplen = 2;
+        return VT_GE;
+    }
+    else if (*s=='<' && (s+1-r<len) && *(s+1)=='=')
+    {
+        if (debug) std::cerr << "\tis <= operator\n";
+        oplen = 2;
+        return VT_LE;
+    }
+    else if (*s=='!' && (s+1-r<len) && *(s+1)=='=')
+    {
+        if (debug) std::cerr << "\tis != operator\n";
+        oplen = 2;
+        return VT_NE;
+    }
+    else if (*s=='+')
+    {
+        if (debug) std::cerr << "\tis + operator\n";
+        oplen = 1;
+        return VT_ADD;
+    }
+    else if (*s=='-')
+    {
+        if (debug) std::cerr << "\tis - operator\n";
+        oplen = 1;
+        return VT_SUB;
+    }
+    else if (*s=='*')
+    {
+        if (debug) std::cerr << "\tis * operator\n";
+        oplen = 1;
+        return VT_MUL;
+    }
+    else if (*s=='/')
+    {
+        if (debug) std::cerr << "\tis / operator\n";
+        oplen = 1;
+        return VT_DIV;
+    }
+    else if (*s=='&')
+    {
+        if (debug) std::cerr << "\tis & operator\n";
+        oplen = 1;
+        return VT_BIT_AND;
+    }
+    else if (*s=='|')
+    {
+        if (debug) std::cerr << "\tis | operator\n";
+        oplen = 1;
+        return VT_BIT_OR;
+    }
+    else if (*s=='>')
+    {
+        if (debug) std::cerr << "\tis > operator\n";
+        oplen = 1;
+        return VT_GT;
+    }
+    else if (*s=='<')
+    {
+        if (debug) std::cerr << "\tis < operator\n";
+        oplen = 1;
+        return VT_LT;
+    }
+
+    return -1;
+}
+
+/**
+ * Attempts to simplify the expression tree by collapsing nodes that can be precomputed.
+ */
+void Filter::simplify()
+{
+    if (tree==NULL) return;
+
+    tree = simplify(tree);
+    tree->parent = NULL;
+}
+
+/**
+ * Recursive call for simplify, returns the node replacing node.
+ */
+Node* Filter::simplify(Node* node)
+{
+    if (node->left)
+    {
+        node->left = simplify(node->left);
+        node->left->parent = node;
+    }
+
+    if (node->right)
+    {
+        node->right = simplify(node->right);
+        node->right->parent = node;
+    }
+
+    if ((node->type&(VT_LOGIC_OP|VT_MATH_CMP|VT_MATH_OP)) && node->left && is_constant(node->left) && (node->right==NULL || is_constant(node->right)))
+    {
+        fold(node);
+        return node;
+    }
+
+    //a missing operand makes ~~x differ from x
+    if (node->type==VT_NOT && node->left->type==VT_NOT && is_total(node->left->left))
+    {
+        Node* x = node->left->left;
+        delete node->left;
+        delete node;
+        return x;
+    }
+
+    if (node->type==VT_AND || node->type==VT_OR)
+    {
+        return reorder(node);
+    }
+
+    return node;
+}
+
+/**
+ * Reorders the operands of a chain of ANDs or ORs, returns the node replacing node.
+ */
+Node* Filter::reorder(Node* node)
+{
+    int32_t type = node->type;
+    std::vector<Node*> operands;
+    std::vector<Node*> ops;
+    flatten(node, type, operands, ops);
+
+    //missing values do not commute, see Filter::execute
+    for (size_t i=0; i<operands.size(); ++i)
+    {
+        if (!is_total(operands[i])) return node;
+    }
+
+    //operands are ranked by their expected cost per record settled,
+    //pass rates default to 1/2 until profiled
+    std::vector<std::pair<float, Node*> > ranked;
+    for (size_t i=0; i<operands.size(); ++i)
+    {
+        Node* operand = operands[i];
+
+        if (is_constant(operand))
+        {
+            //a constant that settles the chain settles it for all records
+            if (operand->b == (type==VT_OR))
+            {
+                for (size_t j=0; j<operands.size(); ++j)
+                {
+                    if (operands[j]!=operand) delete operands[j];
+                }
+                for (size_t j=1; j<ops.size(); ++j) delete ops[j];
+                node = ops[0];
+                node->type = VT_BOOL;
+                node->b = operand->b;
+                node->left = NULL;
+                node->right = NULL;
+                delete operand;
+                return node;
+            }
+
+            delete operand;
+            continue;
+        }
+
+        float pass = 0.5;
+        if (operand->no_evaluated>=100)
+        {
+            pass = (float)operand->no_passed/operand->no_evaluated;
+            pass = std::min(std::max(pass, 0.01f), 0.99f);
+        }
+
+        ranked.push_back(std::make_pair(cost(operand)/(type==VT_AND ? 1-pass : pass), operand));
+    }
+
+    std::stable_sort(ranked.begin(), ranked.end(), compare_rank);
+
+    bool same = ranked.size()==operands.size();
+    for (size_t i=0; same && i<ranked.size(); ++i)
+    {
+        same = ranked[i].second==operands[i];
+    }
+
+    if (same)
+    {
+        return node;
+    }
+
+    reordered = true;
+
+    if (ranked.empty())
+    {
+        for (size_t j=1; j<ops.size(); ++j) delete ops[j];
+        node = ops[0];
+        node->type = VT_BOOL;
+        node->b = (type==VT_AND);
+        node->left = NULL;
+        node->right = NULL;
+        return node;
+    }
+
+    //rebuild the chain to the right, reusing the operators
+    Node* chain = ranked.back().second;
+    for (int32_t i=ranked.size()-2; i>=0; --i)
+    {
+        Node* op = ops[i];
+        op->left = ranked[i].second;
+        op->right = chain;
+        op->left->parent = op;
+        op->right->parent = op;
+        chain = op;
+    }
+
+    for (size_t j=ranked.size()-1; j<ops.size(); ++j) delete ops[j];
+
+    return chain;
+}
+
+/**
+ * Collects the operands and operators of a chain of logic ops of the given type.
+ */
+void Filter::flatten(Node* node, int32_t type, std::vector<Node*>& operands, std::vector<Node*>& ops)
+{
+    if (node->type==type)
+    {
+        ops.push_back(node);
+        flatten(node->left, type, operands, ops);
+        flatten(node->right, type, operands, ops);
+    }
+    else
+    {
+        operands.push_back(node);
+    }
+}
+
+/**
+ * Evaluates a node with literal operands and turns it into a literal.
+ */
+void Filter::fold(Node* node)
+{
+    clear_program();
+    int32_t r = compile(node);
+    execute();
+
+    FilterRegister& reg = registers[r];
+    node->type = (reg.type&VT_INT) ? VT_INT : ((reg.type&VT_FLT) ? VT_FLT : VT_BOOL);
+    node->value_exists = true;
+    node->b = reg.b;
+    node->i = reg.i;
+    node->f = reg.f;
+
+    delete node->left;
+    delete node->right;
+    node->left = NULL;
+    node->right = NULL;
+}
+
+/**
+ * Checks if node holds a constant.
+ */
+bool Filter::is_constant(Node* node)
+{
+    return node->type==VT_INT || node->type==VT_FLT || node->type==VT_STR || node->type==VT_BOOL;
+}
+
+/**
+ * Checks if node may evaluate to a missing value.
+ */
+bool Filter::may_be_missing(Node* node)
+{
+    int32_t type = node->type;
+
+    if (is_constant(node) || type==VT_NOT)
+    {
+        return false;
+    }
+    else if (type==VT_AND || type==VT_OR)
+    {
+        return may_be_missing(node->left) || may_be_missing(node->right);
+    }
+    else if (type&(VT_MATH_CMP|VT_MATH_OP))
+    {
+        return may_be_missing(node->left) && may_be_missing(node->right);
+    }
+    else if (type==VT_INFO)
+    {
+        //flags are either set or not
+        return h==NULL || bcf_hdr_id2type(h, BCF_HL_INFO, bcf_hdr_id2int(h, BCF_DT_ID, node->tag.s))!=BCF_HT_FLAG;
+    }
+
+    return type==VT_QUAL || type==VT_SUM || type==VT_MEAN || type==VT_MIN || type==VT_MAX;
+}
+
+/**
+ * Checks if node exists on every record and depends on the current record only.
+ */
+bool Filter::is_total(Node* node)
+{
+    return !may_be_missing(node) && !is_stale(node);
+}
+
+/**
+ * Checks if node may reuse values from earlier records.
+ */
+bool Filter::is_stale(Node* node)
+{
+    //arithmetic with a missing operand reuses the value it had on an earlier record
+    if ((node->type&VT_MATH_OP) && (may_be_missing(node->left) || may_be_missing(node->right)))
+    {
+        return true;
+    }
+
+    //regular expressions that are not literals are set on the first record
+    if ((node->type==VT_MATCH || node->type==VT_NO_MATCH) && !is_constant(node->right))
+    {
+        return true;
+    }
+
+    return (node->left && is_stale(node->left)) || (node->right && is_stale(node->right));
+}
+
+/**
+ * Estimates the cost of evaluating node.
+ */
+float Filter::cost(Node* node)
+{
+    int32_t type = node->type;
+
+    if (is_constant(node))
+    {
+        return 0;
+    }
+    else if (type==VT_INFO)
+    {
+        //INFO fields are searched for and decoded, strings are copied
+        if (h==NULL) return 5;
+        switch (bcf_hdr_id2type(h, BCF_HL_INFO, bcf_hdr_id2int(h, BCF_DT_ID, node->tag.s)))
+        {
+            case BCF_HT_FLAG: return 3;
+            case BCF_HT_INT:  return 4;
+            case BCF_HT_REAL: return 4;
+            default:          return 8;
+        }
+    }
+    else if (type==VT_FILTER)
+    {
+        return 2;
+    }
+    else if (type==VT_COUNT || type==VT_ANY || type==VT_SUM || type==VT_MEAN || type==VT_MIN || type==VT_MAX)
+    {
+        //a pass over all samples
+        return 20;
+    }
+    else if (type&VT_BCF_OP)
+    {
+        return 1;
+    }
+
+    float c = (type==VT_MATCH || type==VT_NO_MATCH) ? 40 : 1;
+    if (node->left) c += cost(node->left);
+    if (node->right) c += cost(node->right);
+
+    return c;
+}
+
+/**
+ * Lowers the expression tree into a program with tag IDs and types resolved against h.
+ */
+void Filter::compile(bcf_hdr_t *h, bool debug)
+{
+    this->h = h;
+    compiled_h = h;
+
+    simplify();
+    clear_program();
+    result = compile(tree, debug);
+
+    //recompiling resets the values that stale nodes carry over
+    if (tree && is_stale(tree))
+    {
+        profile = false;
+    }
+
+    //strings are not held in columns and stale values depend on the order of evaluation
+    batchable = tree && !is_stale(tree);
+    for (size_t i=0; i<program.size() && batchable; ++i)
+    {
+        int32_t op = program[i].op;
+        if (op==VT_OP_INFO_STR || op==VT_OP_MATCH || op==VT_OP_NO_MATCH ||
+            (op>=VT_OP_EQ && op<VT_OP_MATCH && (op&7)==VT_OPD_SS))
+        {
+            batchable = false;
+        }
+    }
+
+    if (debug)
+    {
+        std::cerr << "compiled program\n";
+        for (size_t i=0; i<program.size(); ++i)
+        {
+            FilterInstruction& ins = program[i];
+            std::cerr << "\t" << i << " op " << ins.op << " r" << ins.dst << " <- r" << ins.a << " r" << ins.b
+                      << " jump " << ins.jump << " id " << ins.id << " " << ins.node->type2string(ins.node->type) << "\n";
+        }
+        std::cerr << "\tresult r" << result << "\n";
+    }
+}
+
+/**
+ * Clears the compiled program.
+ */
+void Filter::clear_program()
+{
+    for (size_t i=0; i<registers.size(); ++i)
+    {
+        if (registers[i].s.m) free(registers[i].s.s);
+    }
+    program.clear();
+    registers.clear();
+}
+
+/**
+ * Adds a register of the given type.
+ */
+int32_t Filter::add_register(int32_t type)
+{
+    registers.push_back(FilterRegister());
+    registers.back().type = type;
+    return registers.size()-1;
+}
+
+/**
+ * Recursive call for compile, returns the register holding the value of node.
+ */
+int32_t Filter::compile(Node* node, bool debug)
+{
+    int32_t type = node->type;
+
+    //literals are loaded once
+    if (is_constant(node))
+    {
+        int32_t r = add_register(type);
+        registers[r].value_exists = true;
+        registers[r].b = node->b;
+        registers[r].i = node->i;
+        registers[r].f = node->f;
+        if (type==VT_STR) kputs(node->s.s, &registers[r].s);
+        return r;
+    }
+    else if (type==VT_NOT)
+    {
+        int32_t a = compile(node->left, debug);
+        int32_t r = add_register(VT_BOOL);
+        program.push_back(FilterInstruction(VT_OP_NOT, r, a, a, node));
+        return r;
+    }
+    else if (type==VT_AND || type==VT_OR)
+    {
+        //the right operand is skipped when the left one decides the outcome
+        int32_t a = compile(node->left, debug);
+        int32_t r = add_register(VT_BOOL);
+        int32_t skip = program.size();
+        program.push_back(FilterInstruction(type==VT_AND ? VT_OP_AND_SKIP : VT_OP_OR_SKIP, r, a, a, node));
+        int32_t b = compile(node->right, debug);
+        program.push_back(FilterInstruction(type==VT_AND ? VT_OP_AND : VT_OP_OR, r, a, b, node));
+        program[skip].jump = program.size();
+        return r;
+    }
+    else if (type&VT_MATH_CMP)
+    {
+        int32_t a = compile(node->left, debug);
+        int32_t b = compile(node->right, debug);
+        int32_t ltype = registers[a].type;
+        int32_t rtype = registers[b].type;
+        int32_t r = add_register(VT_BOOL);
+
+        if (type==VT_MATCH || type==VT_NO_MATCH)
+        {
+            if (!(ltype&VT_STR) || !(rtype&VT_STR))
+            {
+                fprintf(stderr, "[%s:%d %s] evaluation not supported : %s %s %s\n", __FILE__, __LINE__, __FUNCTION__, type==VT_MATCH ? "=~" : "~~", node->type2string(ltype).c_str(), node->type2string(rtype).c_str());
+                exit(1);
+            }
+
+            //regular expressions given as literals are compiled once
+            if (node->right->type==VT_STR && !node->regex_set)
+            {
+                node->pregex.set(node->right->s.s);
+                node->regex_set = true;
+            }
+
+            program.push_back(FilterInstruction(type==VT_MATCH ? VT_OP_MATCH : VT_OP_NO_MATCH, r, a, b, node));
+            return r;
+        }
+
+        int32_t op = 0;
+        const char* sym = "";
+        switch (type)
+        {
+            case VT_EQ: op = VT_OP_EQ; sym = "=="; break;
+            case VT_NE: op = VT_OP_NE; sym = "!="; break;
+            case VT_LT: op = VT_OP_LT; sym = "<"; break;
+            case VT_LE: op = VT_OP_LE; sym = "<="; break;
+            case VT_GT: op = VT_OP_GT; sym = ">"; break;
+            case VT_GE: op = VT_OP_GE; sym = ">="; break;
+        }
+
+        int32_t operands = numeric_operands(ltype, rtype);
+        if (operands==-1 && !(ltype&(VT_INT|VT_FLT)) && (ltype&VT_STR) && (rtype&VT_STR))
+        {
+            operands = VT_OPD_SS;
+        }
+
+        if (operands==-1)
+        {
+            fprintf(stderr, "[%s:%d %s] evaluation not supported: %s %s: %s\n", __FILE__, __LINE__, __FUNCTION__, node->type2string(ltype).c_str(), node->type2string(rtype).c_str(), sym);
+            exit(1);
+        }
+
+        program.push_back(FilterInstruction(op+operands, r, a, b, node));
+        return r;
+    }
+    else if (type&VT_MATH_OP)
     {
-        if (debug) std::cerr << "\tis ~~ operator\n";
-        oplen = 2;
-        return VT_NO_MATCH;
+        int32_t a = compile(node->left, debug);
+        int32_t b = compile(node->right, debug);
+        int32_t ltype = registers[a].type;
+        int32_t rtype = registers[b].type;
+
+        if (type==VT_BIT_AND || type==VT_BIT_OR)
+        {
+            if (!(ltype&VT_INT) || !(rtype&VT_INT))
+            {
+                fprintf(stderr, "[%s:%d %s] evaluation not supported for %s : %s %s\n", __FILE__, __LINE__, __FUNCTION__, type==VT_BIT_AND ? "&" : "|", node->type2string(ltype).c_str(), node->type2string(rtype).c_str());
+                exit(1);
+            }
+
+            int32_t r = add_register(VT_INT|VT_BOOL);
+            program.push_back(FilterInstruction(type==VT_BIT_AND ? VT_OP_BIT_AND : VT_OP_BIT_OR, r, a, b, node));
+            return r;
+        }
+
+        int32_t op = 0;
+        const char* sym = "";
+        switch (type)
+        {
+            case VT_ADD: op = VT_OP_ADD; sym = "+"; break;
+            case VT_SUB: op = VT_OP_SUB; sym = "-"; break;
+            case VT_MUL: op = VT_OP_MUL; sym = "*"; break;
+            case VT_DIV: op = VT_OP_DIV; sym = "/"; break;
+        }
+
+        int32_t operands = numeric_operands(ltype, rtype);
+        if (operands==-1)
+        {
+            fprintf(stderr, "[%s:%d %s] evaluation not supported : %s\n", __FILE__, __LINE__, __FUNCTION__, sym);
+            exit(1);
+        }
+
+        //integer arithmetic stays integral except for division
+        int32_t r = add_register((operands==VT_OPD_II && type!=VT_DIV) ? VT_INT : VT_FLT);
+        program.push_back(FilterInstruction(op+operands, r, a, b, node));
+        return r;
     }
-    else if (*s=='>' && (s+1-r<len) && *(s+1)=='=')
+    else if (type==VT_COUNT || type==VT_ANY || type==VT_SUM || type==VT_MEAN || type==VT_MIN || type==VT_MAX)
     {
-        if (debug) std::cerr << "\tis >= operator\n";
-        oplen = 2;
-        return VT_GE;
+        return compile_aggregate(node, debug);
     }
-    else if (*s=='<' && (s+1-r<len) && *(s+1)=='=')
+    else if (type==VT_FORMAT)
     {
-        if (debug) std::cerr << "\tis <= operator\n";
-        oplen = 2;
-        return VT_LE;
+        fprintf(stderr, "[%s:%d %s] FMT.%s can only be used in COUNT, ANY, SUM, MEAN, MIN or MAX.\n", __FILE__, __LINE__, __FUNCTION__, node->tag.s);
+        exit(1);
     }
-    else if (*s=='!' && (s+1-r<len) && *(s+1)=='=')
+    else if (type==VT_INFO)
     {
-        if (debug) std::cerr << "\tis != operator\n";
-        oplen = 2;
-        return VT_NE;
+        int32_t id = bcf_hdr_id2int(h, BCF_DT_ID, node->tag.s);
+        if (!bcf_hdr_idinfo_exists(h, BCF_HL_INFO, id))
+        {
+            fprintf(stderr, "[%s:%d %s] INFO tag %s does not exist in header of VCF file.\n", __FILE__, __LINE__, __FUNCTION__, node->tag.s);
+            exit(1);
+        }
+
+        int32_t op = 0;
+        int32_t r = 0;
+        switch (bcf_hdr_id2type(h, BCF_HL_INFO, id))
+        {
+            case BCF_HT_FLAG: op = VT_OP_INFO_FLG; r = add_register(VT_FLG); break;
+            case BCF_HT_INT:  op = VT_OP_INFO_INT; r = add_register(VT_INT); break;
+            case BCF_HT_REAL: op = VT_OP_INFO_FLT; r = add_register(VT_FLT); break;
+            default:          op = VT_OP_INFO_STR; r = add_register(VT_STR); break;
+        }
+
+        program.push_back(FilterInstruction(op, r, r, r, node));
+        program.back().id = id;
+        return r;
     }
-    else if (*s=='+')
+    else if (type==VT_FILTER)
     {
-        if (debug) std::cerr << "\tis + operator\n";
-        oplen = 1;
-        return VT_ADD;
+        const char* tag = strcmp(node->tag.s, ".") ? node->tag.s : "PASS";
+        int32_t id = bcf_hdr_id2int(h, BCF_DT_ID, tag);
+
+        int32_t r = add_register(VT_BOOL);
+        program.push_back(FilterInstruction(VT_OP_FILTER, r, r, r, node));
+        program.back().id = bcf_hdr_idinfo_exists(h, BCF_HL_FLT, id) ? id : -1;
+        return r;
     }
-    else if (*s=='-')
+    else if (type&VT_BCF_OP)
     {
-        if (debug) std::cerr << "\tis - operator\n";
-        oplen = 1;
-        return VT_SUB;
+        int32_t op = 0;
+        int32_t r = 0;
+        switch (type)
+        {
+            case VT_QUAL:               op = VT_OP_QUAL;       r = add_register(VT_FLT); break;
+            case VT_N_FILTER:           op = VT_OP_N_FILTER;   r = add_register(VT_INT); break;
+            case VT_VARIANT_TYPE:       op = VT_OP_VTYPE;      r = add_register(VT_INT|VT_BOOL); break;
+            case VT_VARIANT_DLEN:       op = VT_OP_DLEN;       r = add_register(VT_INT); break;
+            case VT_VARIANT_LEN:        op = VT_OP_LEN;        r = add_register(VT_INT); break;
+            case VT_VARIANT_CONTAINS_N: op = VT_OP_CONTAINS_N; r = add_register(VT_BOOL); break;
+            case VT_N_ALLELE:           op = VT_OP_N_ALLELE;   r = add_register(VT_INT); break;
+            default:
+                fprintf(stderr, "[%s:%d %s] evaluation not supported : %s\n", __FILE__, __LINE__, __FUNCTION__, node->type2string(type).c_str());
+                exit(1);
+        }
+
+        program.push_back(FilterInstruction(op, r, r, r, node));
+        return r;
     }
-    else if (*s=='*')
+
+    fprintf(stderr, "[%s:%d %s] evaluation not supported : %s\n", __FILE__, __LINE__, __FUNCTION__, node->type2string(type).c_str());
+    exit(1);
+}
+
+/**
+ * Compiles an aggregation over samples.
+ */
+int32_t Filter::compile_aggregate(Node* node, bool debug)
+{
+    int32_t type = node->type;
+    std::string name = node->type2string(type);
+    name = name.substr(name.rfind('|')+1);
+
+    Node* format = node->left;
+    Node* value = NULL;
+    int32_t cmp = -1;
+
+    if (type==VT_COUNT || type==VT_ANY)
     {
-        if (debug) std::cerr << "\tis * operator\n";
-        oplen = 1;
-        return VT_MUL;
+        Node* predicate = node->left;
+        cmp = predicate->type;
+        format = predicate->left;
+        value = predicate->right;
+
+        //constants on the left are mirrored to the right
+        if (format && is_constant(format) && value->type==VT_FORMAT)
+        {
+            std::swap(format, value);
+            cmp = cmp==VT_LT ? VT_GT : (cmp==VT_GT ? VT_LT : (cmp==VT_LE ? VT_GE : (cmp==VT_GE ? VT_LE : cmp)));
+        }
+
+        if ((cmp!=VT_EQ && cmp!=VT_NE && cmp!=VT_LT && cmp!=VT_LE && cmp!=VT_GT && cmp!=VT_GE) ||
+            format->type!=VT_FORMAT || !is_constant(value))
+        {
+            fprintf(stderr, "[%s:%d %s] %s takes a comparison of a FORMAT field with a constant, e.g. %s(FMT.GQ>20).\n", __FILE__, __LINE__, __FUNCTION__, name.c_str(), name.c_str());
+            exit(1);
+        }
     }
-    else if (*s=='/')
+    else if (format->type!=VT_FORMAT)
     {
-        if (debug) std::cerr << "\tis / operator\n";
-        oplen = 1;
-        return VT_DIV;
+        fprintf(stderr, "[%s:%d %s] %s takes a FORMAT field, e.g. %s(FMT.DP).\n", __FILE__, __LINE__, __FUNCTION__, name.c_str(), name.c_str());
+        exit(1);
     }
-    else if (*s=='&')
+
+    int32_t id = bcf_hdr_id2int(h, BCF_DT_ID, format->tag.s);
+    if (!bcf_hdr_idinfo_exists(h, BCF_HL_FMT, id))
     {
-        if (debug) std::cerr << "\tis & operator\n";
-        oplen = 1;
-        return VT_BIT_AND;
+        fprintf(stderr, "[%s:%d %s] FORMAT tag %s does not exist in header of VCF file.\n", __FILE__, __LINE__, __FUNCTION__, format->tag.s);
+        exit(1);
     }
-    else if (*s=='|')
+
+    int32_t format_type = bcf_hdr_id2type(h, BCF_HL_FMT, id);
+    bool is_gt = strcmp(format->tag.s, "GT")==0;
+    bool is_str = is_gt || format_type==BCF_HT_STR;
+
+    int32_t op = 0;
+    int32_t r = 0;
+    int32_t b = 0;
+
+    if (cmp!=-1)
     {
-        if (debug) std::cerr << "\tis | operator\n";
-        oplen = 1;
-        return VT_BIT_OR;
+        if (is_str ? (value->type!=VT_STR || (cmp!=VT_EQ && cmp!=VT_NE)) : (value->type!=VT_INT && value->type!=VT_FLT))
+        {
+            fprintf(stderr, "[%s:%d %s] evaluation not supported: FMT.%s %s %s\n", __FILE__, __LINE__, __FUNCTION__, format->tag.s, node->type2string(cmp).c_str(), node->type2string(value->type).c_str());
+            exit(1);
+        }
+
+        b = compile(value, debug);
+        op = type==VT_COUNT ? VT_OP_COUNT : VT_OP_ANY;
+        r = add_register(type==VT_COUNT ? VT_INT : VT_BOOL);
     }
-    else if (*s=='>')
+    else
     {
-        if (debug) std::cerr << "\tis > operator\n";
-        oplen = 1;
-        return VT_GT;
+        if (is_str)
+        {
+            fprintf(stderr, "[%s:%d %s] %s takes a numeric FORMAT field : FMT.%s\n", __FILE__, __LINE__, __FUNCTION__, name.c_str(), format->tag.s);
+            exit(1);
+        }
+
+        op = type==VT_SUM ? VT_OP_SUM : (type==VT_MEAN ? VT_OP_MEAN : (type==VT_MIN ? VT_OP_MIN : VT_OP_MAX));
+        r = add_register((type==VT_MEAN || format_type==BCF_HT_REAL) ? VT_FLT : VT_INT);
+        b = r;
     }
-    else if (*s=='<')
+
+    program.push_back(FilterInstruction(op, r, r, b, node));
+    FilterInstruction& ins = program.back();
+    ins.id = id;
+    ins.cmp = cmp;
+
+    //genotypes are encoded as in the BCF records
+    if (is_gt)
     {
-        if (debug) std::cerr << "\tis < operator\n";
-        oplen = 1;
-        return VT_LT;
+        const char* t = value->s.s;
+        int32_t is_phased = 0;
+        while (true)
+        {
+            if (*t=='.')
+            {
+                ++t;
+                ins.gt.push_back(is_phased);
+            }
+            else if (isdigit(*t))
+            {
+                char* end = NULL;
+                ins.gt.push_back((std::strtol(t, &end, 10)+1)<<1 | is_phased);
+                t = end;
+            }
+            else
+            {
+                break;
+            }
+
+            is_phased = *t=='|';
+            if (*t!='|' && *t!='/') break;
+            ++t;
+        }
+
+        if (*t || ins.gt.empty())
+        {
+            fprintf(stderr, "[%s:%d %s] genotype %s is not recognized.\n", __FILE__, __LINE__, __FUNCTION__, value->s.s);
+            exit(1);
+        }
     }
 
-    return -1;
+    return r;
 }
 
 /**
- * Recursive call for apply.
+ * Runs the compiled program on the current record.
  */
-void Filter::apply(Node* node, bool debug)
+void Filter::execute(bool debug)
 {
-    node->value_exists = false;
-
-    //evaluate downstream
-    if (node->left!=NULL)
+    int32_t n = program.size();
+    for (int32_t pc=0; pc<n; ++pc)
     {
-        apply(node->left, debug);
-    }
+        FilterInstruction& ins = program[pc];
+        FilterRegister& r = registers[ins.dst];
+        FilterRegister& a = registers[ins.a];
+        FilterRegister& b = registers[ins.b];
 
-    //can do some lazy evaluation here for && and || types.
-    if (node->type&VT_LOGIC_OP)
-    {
-        if (node->type==VT_AND)
+        if (ins.op>=VT_OP_EQ && ins.op<VT_OP_ADD)
         {
-            if (node->left->value_exists && !node->left->b)
+            //if an INFO field is involved and does not exist, then we evaluate as false
+            if (!a.value_exists || !b.value_exists)
             {
-                node->b = false;
-                node->value_exists = true;
-                return;
+                r.value_exists = a.value_exists || b.value_exists;
+                r.b = false;
+                continue;
             }
-            else
+
+            r.value_exists = true;
+        }
+        else if (ins.op>=VT_OP_ADD && ins.op<VT_OP_QUAL)
+        {
+            if (!a.value_exists && !b.value_exists)
             {
-                 apply(node->right, debug);
+                r.value_exists = false;
+                continue;
             }
+
+            r.value_exists = true;
         }
-        else if (node->type==VT_OR)
+
+        switch (ins.op)
         {
-            if (node->left->value_exists && node->left->b)
+            case VT_OP_NOT:
+                r.b = a.value_exists ? !a.b : true;
+                r.value_exists = true;
+                break;
+            case VT_OP_AND_SKIP:
+                if (profile)
+                {
+                    ++ins.node->left->no_evaluated;
+                    if (a.value_exists && a.b) ++ins.node->left->no_passed;
+                }
+                if (a.value_exists && !a.b)
+                {
+                    r.b = false;
+                    r.value_exists = true;
+                    pc = ins.jump-1;
+                }
+                break;
+            case VT_OP_OR_SKIP:
+                if (profile)
+                {
+                    ++ins.node->left->no_evaluated;
+                    if (a.value_exists && a.b) ++ins.node->left->no_passed;
+                }
+                if (a.value_exists && a.b)
+                {
+                    r.b = true;
+                    r.value_exists = true;
+                    pc = ins.jump-1;
+                }
+                break;
+            case VT_OP_AND:
+            case VT_OP_OR:
+                if (profile)
+                {
+                    ++ins.node->right->no_evaluated;
+                    if (b.value_exists && b.b) ++ins.node->right->no_passed;
+                }
+                r.value_exists = a.value_exists && b.value_exists;
+                r.b = r.value_exists && (ins.op==VT_OP_AND ? a.b && b.b : a.b || b.b);
+                break;
+
+            case VT_OP_EQ+VT_OPD_II: r.b = a.i==b.i; break;
+            case VT_OP_EQ+VT_OPD_IF: r.b = a.i==b.f; break;
+            case VT_OP_EQ+VT_OPD_FI: r.b = a.f==b.i; break;
+            case VT_OP_EQ+VT_OPD_FF: r.b = a.f==b.f; break;
+            case VT_OP_EQ+VT_OPD_SS: r.b = strcmp(a.s.s, b.s.s)==0; break;
+            case VT_OP_NE+VT_OPD_II: r.b = a.i!=b.i; break;
+            case VT_OP_NE+VT_OPD_IF: r.b = a.i!=b.f; break;
+            case VT_OP_NE+VT_OPD_FI: r.b = a.f!=b.i; break;
+            case VT_OP_NE+VT_OPD_FF: r.b = a.f!=b.f; break;
+            case VT_OP_NE+VT_OPD_SS: r.b = strcmp(a.s.s, b.s.s)!=0; break;
+            case VT_OP_LT+VT_OPD_II: r.b = a.i<b.i; break;
+            case VT_OP_LT+VT_OPD_IF: r.b = a.i<b.f; break;
+            case VT_OP_LT+VT_OPD_FI: r.b = a.f<b.i; break;
+            case VT_OP_LT+VT_OPD_FF: r.b = a.f<b.f; break;
+            case VT_OP_LT+VT_OPD_SS: r.b = strcmp(a.s.s, b.s.s)<0; break;
+            case VT_OP_LE+VT_OPD_II: r.b = a.i<=b.i; break;
+            case VT_OP_LE+VT_OPD_IF: r.b = a.i<=b.f; break;
+            case VT_OP_LE+VT_OPD_FI: r.b = a.f<=b.i; break;
+            case VT_OP_LE+VT_OPD_FF: r.b = a.f<=b.f; break;
+            case VT_OP_LE+VT_OPD_SS: r.b = strcmp(a.s.s, b.s.s)<=0; break;
+            case VT_OP_GT+VT_OPD_II: r.b = a.i>b.i; break;
+            case VT_OP_GT+VT_OPD_IF: r.b = a.i>b.f; break;
+            case VT_OP_GT+VT_OPD_FI: r.b = a.f>b.i; break;
+            case VT_OP_GT+VT_OPD_FF: r.b = a.f>b.f; break;
+            case VT_OP_GT+VT_OPD_SS: r.b = strcmp(a.s.s, b.s.s)>0; break;
+            case VT_OP_GE+VT_OPD_II: r.b = a.i>=b.i; break;
+            case VT_OP_GE+VT_OPD_IF: r.b = a.i>=b.f; break;
+            case VT_OP_GE+VT_OPD_FI: r.b = a.f>=b.i; break;
+            case VT_OP_GE+VT_OPD_FF: r.b = a.f>=b.f; break;
+            case VT_OP_GE+VT_OPD_SS: r.b = strcmp(a.s.s, b.s.s)>=0; break;
+            case VT_OP_MATCH:
+            case VT_OP_NO_MATCH:
+                if (!ins.node->regex_set)
+                {
+                    ins.node->pregex.set(b.s.s);
+                    ins.node->regex_set = true;
+                }
+                r.b = ins.node->pregex.match(a.s.s)==(ins.op==VT_OP_MATCH);
+                break;
+
+            case VT_OP_ADD+VT_OPD_II: r.i = a.i+b.i; r.f = r.i; break;
+            case VT_OP_ADD+VT_OPD_IF: r.f = a.i+b.f; break;
+            case VT_OP_ADD+VT_OPD_FI: r.f = a.f+b.i; break;
+            case VT_OP_ADD+VT_OPD_FF: r.f = a.f+b.f; break;
+            case VT_OP_SUB+VT_OPD_II: r.i = a.i-b.i; r.f = r.i; break;
+            case VT_OP_SUB+VT_OPD_IF: r.f = a.i-b.f; break;
+            case VT_OP_SUB+VT_OPD_FI: r.f = a.f-b.i; break;
+            case VT_OP_SUB+VT_OPD_FF: r.f = a.f-b.f; break;
+            case VT_OP_MUL+VT_OPD_II: r.i = a.i*b.i; r.f = r.i; break;
+            case VT_OP_MUL+VT_OPD_IF: r.f = a.i*b.f; break;
+            case VT_OP_MUL+VT_OPD_FI: r.f = a.f*b.i; break;
+            case VT_OP_MUL+VT_OPD_FF: r.f = a.f*b.f; break;
+            case VT_OP_DIV+VT_OPD_II: r.f = (float)a.i/b.i; break;
+            case VT_OP_DIV+VT_OPD_IF: r.f = a.i/b.f; break;
+            case VT_OP_DIV+VT_OPD_FI: r.f = a.f/b.i; break;
+            case VT_OP_DIV+VT_OPD_FF: r.f = a.f/b.f; break;
+            case VT_OP_BIT_AND: r.i = a.i & b.i; r.b = r.i; break;
+            case VT_OP_BIT_OR:  r.i = a.i | b.i; r.b = r.i; break;
+
+            case VT_OP_QUAL:
+                if (bcf_float_is_missing(bcf_get_qual(v)))
+                {
+                    r.f = -1;
+                    r.value_exists = false;
+                }
+                else
+                {
+                    r.f = bcf_get_qual(v);
+                    r.value_exists = true;
+                }
+                break;
+            case VT_OP_FILTER:
+                if (!(v->unpacked&BCF_UN_FLT)) bcf_unpack(v, BCF_UN_FLT);
+                r.b = false;
+                if (v->d.n_flt)
+                {
+                    //filters missing from the header always match
+                    r.b = ins.id==-1;
+                    for (int32_t i=0; i<v->d.n_flt && !r.b; ++i)
+                    {
+                        r.b = v->d.flt[i]==ins.id;
+                    }
+                }
+                r.value_exists = true;
+                break;
+            case VT_OP_N_FILTER:
+                r.i = bcf_get_n_filter(v);
+                r.f = r.i;
+                r.b = true;
+                r.value_exists = true;
+                break;
+            case VT_OP_INFO_FLG:
+                r.b = bcf_get_info_id(v, ins.id)!=NULL;
+                r.value_exists = true;
+                break;
+            case VT_OP_INFO_INT:
+                r.value_exists = get_info_int(bcf_get_info_id(v, ins.id), r.i);
+                r.b = r.value_exists;
+                if (r.value_exists) r.f = r.i;
+                break;
+            case VT_OP_INFO_FLT:
+                r.value_exists = get_info_float(bcf_get_info_id(v, ins.id), r.f);
+                r.b = r.value_exists;
+                if (r.value_exists) r.i = (int32_t) r.f;
+                break;
+            case VT_OP_INFO_STR:
             {
-                node->b = true;
-                node->value_exists = true;
-                return;
+                bcf_info_t *info = bcf_get_info_id(v, ins.id);
+                r.value_exists = info && info->vptr && info->len>0;
+                r.b = r.value_exists;
+                if (r.value_exists)
+                {
+                    r.s.l = 0;
+                    kputsn((char*)info->vptr, info->len, &r.s);
+                }
+                break;
             }
-            else
+            case VT_OP_VTYPE:
+                r.i = variant->type;
+                r.b = r.i;
+                r.value_exists = true;
+                break;
+            case VT_OP_DLEN:
+                r.i = variant->alleles[0].dlen;
+                r.f = r.i;
+                r.value_exists = true;
+                break;
+            case VT_OP_LEN:
+                r.i = abs(variant->alleles[0].dlen);
+                r.f = r.i;
+                r.value_exists = true;
+                break;
+            case VT_OP_CONTAINS_N:
+                if (!(v->unpacked&BCF_UN_FLT)) bcf_unpack(v, BCF_UN_FLT);
+                r.b = variant->contains_N;
+                r.value_exists = true;
+                break;
+            case VT_OP_N_ALLELE:
+                r.i = bcf_get_n_allele(v);
+                r.f = r.i;
+                r.value_exists = true;
+                break;
+            case VT_OP_COUNT:
+            case VT_OP_ANY:
+            {
+                bcf_fmt_t *fmt = bcf_get_fmt_id(v, ins.id);
+                r.i = (fmt && fmt->p) ? count_samples(fmt, v->n_sample, ins, b) : 0;
+                r.f = r.i;
+                r.b = r.i>0;
+                r.value_exists = true;
+                break;
+            }
+            case VT_OP_SUM:
+            case VT_OP_MEAN:
+            case VT_OP_MIN:
+            case VT_OP_MAX:
             {
-                 apply(node->right, debug);
+                double x = 0;
+                r.value_exists = aggregate_samples(bcf_get_fmt_id(v, ins.id), v->n_sample, ins.op, x);
+                r.b = r.value_exists;
+                if (r.value_exists)
+                {
+                    r.i = (int32_t) x;
+                    r.f = x;
+                }
+                break;
             }
         }
+
+        if (debug)
+            std::cerr << "\t" << pc << " " << ins.node->type2string(ins.node->type) << " exists " << r.value_exists << " b " << r.b << " i " << r.i << " f " << r.f << "\n";
     }
-    else
-    {
-        if (node->right!=NULL)
+}
+
+/**
+ * Runs the compiled program on a batch of n records, one instruction at a time over all records.
+ */
+void Filter::execute(bcf1_t **v, Variant *variants, int32_t n, bool debug)
+{
+    //constants are broadcast to every record
+    columns.resize(registers.size());
+    for (size_t j=0; j<registers.size(); ++j)
+    {
+        FilterRegister& x = registers[j];
+        FilterColumn& c = columns[j];
+        c.resize(n);
+        std::fill(c.value_exists.begin(), c.value_exists.begin()+n, x.value_exists);
+        std::fill(c.b.begin(), c.b.begin()+n, x.b);
+        std::fill(c.i.begin(), c.i.begin()+n, x.i);
+        std::fill(c.f.begin(), c.f.begin()+n, x.f);
+    }
+
+    //the loops over the columns are free of branches so that they vectorize
+    #define VT_BATCH_CMP(op, x, y) \
+        for (int32_t k=0; k<n; ++k) \
+        { \
+            rb[k] = ae[k] & be[k] & (x[k] op y[k]); \
+            re[k] = ae[k] | be[k]; \
+        } \
+        break;
+
+    #define VT_BATCH_INT(expr) \
+        for (int32_t k=0; k<n; ++k) \
+        { \
+            ri[k] = expr; \
+            rf[k] = ri[k]; \
+            re[k] = ae[k] | be[k]; \
+        } \
+        break;
+
+    #define VT_BATCH_FLT(expr) \
+        for (int32_t k=0; k<n; ++k) \
+        { \
+            rf[k] = expr; \
+            re[k] = ae[k] | be[k]; \
+        } \
+        break;
+
+    int32_t m = program.size();
+    for (int32_t pc=0; pc<m; ++pc)
+    {
+        FilterInstruction& ins = program[pc];
+        FilterColumn& r = columns[ins.dst];
+        FilterColumn& a = columns[ins.a];
+        FilterColumn& b = columns[ins.b];
+
+        uint8_t* re = &r.value_exists[0];
+        uint8_t* rb = &r.b[0];
+        int32_t* ri = &r.i[0];
+        float* rf = &r.f[0];
+        const uint8_t* ae = &a.value_exists[0];
+        const uint8_t* ab = &a.b[0];
+        const int32_t* ai = &a.i[0];
+        const float* af = &a.f[0];
+        const uint8_t* be = &b.value_exists[0];
+        const uint8_t* bb = &b.b[0];
+        const int32_t* bi = &b.i[0];
+        const float* bf = &b.f[0];
+
+        switch (ins.op)
+        {
+            case VT_OP_NOT:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    rb[k] = !(ae[k] & ab[k]);
+                    re[k] = 1;
+                }
+                break;
+
+            //both operands are evaluated for all records, AND and OR account for the skipped ones
+            case VT_OP_AND_SKIP:
+            case VT_OP_OR_SKIP:
+                break;
+            case VT_OP_AND:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    rb[k] = ae[k] & be[k] & ab[k] & bb[k];
+                    re[k] = ae[k] & ((ab[k]==0) | be[k]);
+                }
+                break;
+            case VT_OP_OR:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    rb[k] = ae[k] & (ab[k] | (be[k] & bb[k]));
+                    re[k] = ae[k] & (ab[k] | be[k]);
+                }
+                break;
+
+            case VT_OP_EQ+VT_OPD_II: VT_BATCH_CMP(==, ai, bi)
+            case VT_OP_EQ+VT_OPD_IF: VT_BATCH_CMP(==, ai, bf)
+            case VT_OP_EQ+VT_OPD_FI: VT_BATCH_CMP(==, af, bi)
+            case VT_OP_EQ+VT_OPD_FF: VT_BATCH_CMP(==, af, bf)
+            case VT_OP_NE+VT_OPD_II: VT_BATCH_CMP(!=, ai, bi)
+            case VT_OP_NE+VT_OPD_IF: VT_BATCH_CMP(!=, ai, bf)
+            case VT_OP_NE+VT_OPD_FI: VT_BATCH_CMP(!=, af, bi)
+            case VT_OP_NE+VT_OPD_FF: VT_BATCH_CMP(!=, af, bf)
+            case VT_OP_LT+VT_OPD_II: VT_BATCH_CMP(<, ai, bi)
+            case VT_OP_LT+VT_OPD_IF: VT_BATCH_CMP(<, ai, bf)
+            case VT_OP_LT+VT_OPD_FI: VT_BATCH_CMP(<, af, bi)
+            case VT_OP_LT+VT_OPD_FF: VT_BATCH_CMP(<, af, bf)
+            case VT_OP_LE+VT_OPD_II: VT_BATCH_CMP(<=, ai, bi)
+            case VT_OP_LE+VT_OPD_IF: VT_BATCH_CMP(<=, ai, bf)
+            case VT_OP_LE+VT_OPD_FI: VT_BATCH_CMP(<=, af, bi)
+            case VT_OP_LE+VT_OPD_FF: VT_BATCH_CMP(<=, af, bf)
+            case VT_OP_GT+VT_OPD_II: VT_BATCH_CMP(>, ai, bi)
+            case VT_OP_GT+VT_OPD_IF: VT_BATCH_CMP(>, ai, bf)
+            case VT_OP_GT+VT_OPD_FI: VT_BATCH_CMP(>, af, bi)
+            case VT_OP_GT+VT_OPD_FF: VT_BATCH_CMP(>, af, bf)
+            case VT_OP_GE+VT_OPD_II: VT_BATCH_CMP(>=, ai, bi)
+            case VT_OP_GE+VT_OPD_IF: VT_BATCH_CMP(>=, ai, bf)
+            case VT_OP_GE+VT_OPD_FI: VT_BATCH_CMP(>=, af, bi)
+            case VT_OP_GE+VT_OPD_FF: VT_BATCH_CMP(>=, af, bf)
+
+            case VT_OP_ADD+VT_OPD_II: VT_BATCH_INT(ai[k]+bi[k])
+            case VT_OP_ADD+VT_OPD_IF: VT_BATCH_FLT(ai[k]+bf[k])
+            case VT_OP_ADD+VT_OPD_FI: VT_BATCH_FLT(af[k]+bi[k])
+            case VT_OP_ADD+VT_OPD_FF: VT_BATCH_FLT(af[k]+bf[k])
+            case VT_OP_SUB+VT_OPD_II: VT_BATCH_INT(ai[k]-bi[k])
+            case VT_OP_SUB+VT_OPD_IF: VT_BATCH_FLT(ai[k]-bf[k])
+            case VT_OP_SUB+VT_OPD_FI: VT_BATCH_FLT(af[k]-bi[k])
+            case VT_OP_SUB+VT_OPD_FF: VT_BATCH_FLT(af[k]-bf[k])
+            case VT_OP_MUL+VT_OPD_II: VT_BATCH_INT(ai[k]*bi[k])
+            case VT_OP_MUL+VT_OPD_IF: VT_BATCH_FLT(ai[k]*bf[k])
+            case VT_OP_MUL+VT_OPD_FI: VT_BATCH_FLT(af[k]*bi[k])
+            case VT_OP_MUL+VT_OPD_FF: VT_BATCH_FLT(af[k]*bf[k])
+            case VT_OP_DIV+VT_OPD_II: VT_BATCH_FLT((float)ai[k]/bi[k])
+            case VT_OP_DIV+VT_OPD_IF: VT_BATCH_FLT(ai[k]/bf[k])
+            case VT_OP_DIV+VT_OPD_FI: VT_BATCH_FLT(af[k]/bi[k])
+            case VT_OP_DIV+VT_OPD_FF: VT_BATCH_FLT(af[k]/bf[k])
+            case VT_OP_BIT_AND:
+            case VT_OP_BIT_OR:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    ri[k] = ins.op==VT_OP_BIT_AND ? ai[k] & bi[k] : ai[k] | bi[k];
+                    rb[k] = ri[k]!=0;
+                    re[k] = ae[k] | be[k];
+                }
+                break;
+
+            case VT_OP_QUAL:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    float qual = bcf_get_qual(v[k]);
+                    re[k] = !bcf_float_is_missing(qual);
+                    rf[k] = re[k] ? qual : -1;
+                }
+                break;
+            case VT_OP_FILTER:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    if (!(v[k]->unpacked&BCF_UN_FLT)) bcf_unpack(v[k], BCF_UN_FLT);
+                    bool matched = false;
+                    if (v[k]->d.n_flt)
+                    {
+                        //filters missing from the header always match
+                        matched = ins.id==-1;
+                        for (int32_t i=0; i<v[k]->d.n_flt && !matched; ++i)
+                        {
+                            matched = v[k]->d.flt[i]==ins.id;
+                        }
+                    }
+                    rb[k] = matched;
+                    re[k] = 1;
+                }
+                break;
+            case VT_OP_N_FILTER:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    ri[k] = bcf_get_n_filter(v[k]);
+                    rf[k] = ri[k];
+                    rb[k] = 1;
+                    re[k] = 1;
+                }
+                break;
+            case VT_OP_INFO_FLG:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    rb[k] = bcf_get_info_id(v[k], ins.id)!=NULL;
+                    re[k] = 1;
+                }
+                break;
+            case VT_OP_INFO_INT:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    re[k] = get_info_int(bcf_get_info_id(v[k], ins.id), ri[k]);
+                    rb[k] = re[k];
+                    if (re[k]) rf[k] = ri[k];
+                }
+                break;
+            case VT_OP_INFO_FLT:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    re[k] = get_info_float(bcf_get_info_id(v[k], ins.id), rf[k]);
+                    rb[k] = re[k];
+                    if (re[k]) ri[k] = (int32_t) rf[k];
+                }
+                break;
+            case VT_OP_VTYPE:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    ri[k] = variants[k].type;
+                    rb[k] = ri[k]!=0;
+                    re[k] = 1;
+                }
+                break;
+            case VT_OP_DLEN:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    ri[k] = variants[k].alleles[0].dlen;
+                    rf[k] = ri[k];
+                    re[k] = 1;
+                }
+                break;
+            case VT_OP_LEN:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    ri[k] = abs(variants[k].alleles[0].dlen);
+                    rf[k] = ri[k];
+                    re[k] = 1;
+                }
+                break;
+            case VT_OP_CONTAINS_N:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    if (!(v[k]->unpacked&BCF_UN_FLT)) bcf_unpack(v[k], BCF_UN_FLT);
+                    rb[k] = variants[k].contains_N;
+                    re[k] = 1;
+                }
+                break;
+            case VT_OP_N_ALLELE:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    ri[k] = bcf_get_n_allele(v[k]);
+                    rf[k] = ri[k];
+                    re[k] = 1;
+                }
+                break;
+            case VT_OP_COUNT:
+            case VT_OP_ANY:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    bcf_fmt_t *fmt = bcf_get_fmt_id(v[k], ins.id);
+                    ri[k] = (fmt && fmt->p) ? count_samples(fmt, v[k]->n_sample, ins, registers[ins.b]) : 0;
+                    rf[k] = ri[k];
+                    rb[k] = ri[k]>0;
+                    re[k] = 1;
+                }
+                break;
+            case VT_OP_SUM:
+            case VT_OP_MEAN:
+            case VT_OP_MIN:
+            case VT_OP_MAX:
+                for (int32_t k=0; k<n; ++k)
+                {
+                    double x = 0;
+                    re[k] = aggregate_samples(bcf_get_fmt_id(v[k], ins.id), v[k]->n_sample, ins.op, x);
+                    rb[k] = re[k];
+                    if (re[k])
+                    {
+                        ri[k] = (int32_t) x;
+                        rf[k] = x;
+                    }
+                }
+                break;
+        }
+
+        if (debug)
         {
-            apply(node->right, debug);
+            int32_t no_exists = 0, no_true = 0;
+            for (int32_t k=0; k<n; ++k)
+            {
+                no_exists += re[k];
+                no_true += re[k] & rb[k];
+            }
+            std::cerr << "\t" << pc << " " << ins.node->type2string(ins.node->type) << " exists " << no_exists << "/" << n << " b " << no_true << "\n";
         }
     }
 
-    node->evaluate(h, v, variant, debug);
-};
\ No newline at end of file
+    #undef VT_BATCH_CMP
+    #undef VT_BATCH_INT
+    #undef VT_BATCH_FLT
+}
@@ -73,9 +73,21 @@
 #define VT_N_FILTER            (40|VT_INT|VT_BCF_OP)
 #define VT_INFO                (41|VT_BCF_OP)
 
+//aggregations of FORMAT fields over samples
+#define VT_FORMAT              (42|VT_BCF_OP)
+#define VT_COUNT               (43|VT_INT|VT_BCF_OP)
+#define VT_ANY                 (44|VT_BCF_OP|VT_BOOL)
+#define VT_SUM                 (45|VT_BCF_OP)
+#define VT_MEAN                (46|VT_BCF_OP|VT_FLT)
+#define VT_MIN                 (47|VT_BCF_OP)
+#define VT_MAX                 (48|VT_BCF_OP)
+
 //problems will arise once you pass 63.
 #define VT_UNKNOWN -1
 
+//number of records evaluated together by the batch filter
+#define VT_FILTER_BATCH_RECORDS 1024
+
 /**
  * Class for filtering VCF records.
  */
@@ -100,6 +112,9 @@ class Node
     PERLregex pregex;
     bool regex_set;
 
+    uint32_t no_evaluated; // times evaluated as an operand of a logic op while profiling
+    uint32_t no_passed;    // times it evaluated to true while profiling
+
     /**
      * Constructor.
      */
@@ -111,14 +126,71 @@ class Node
     Node(int32_t type);
 
     /**
-     * Evaluates the actions for this node.
+     * Converts type to string.
      */
-    void evaluate(bcf_hdr_t *h, bcf1_t *v, Variant *variant, bool debug=false);
+    std::string type2string(int32_t type);
+};
+
+/**
+ * Register of a compiled filter program.
+ */
+class FilterRegister
+{
+    public:
+
+    int32_t type;      // data type of the value held
+    bool value_exists; // if value exists
+
+    kstring_t s;   // string value
+    bool b;        // boolean value
+    int32_t i;     // integer value
+    float f;       // float value
 
     /**
-     * Converts type to string.
+     * Constructor.
      */
-    std::string type2string(int32_t type);
+    FilterRegister();
+};
+
+/**
+ * Register of a compiled filter program holding a value for each record of a batch.
+ */
+class FilterColumn
+{
+    public:
+
+    std::vector<uint8_t> value_exists; // if value exists
+    std::vector<uint8_t> b;            // boolean values
+    std::vector<int32_t> i;            // integer values
+    std::vector<float> f;              // float values
+
+    /**
+     * Grows the column to hold at least n records.
+     */
+    void resize(int32_t n);
+};
+
+/**
+ * Instruction of a compiled filter program.
+ */
+class FilterInstruction
+{
+    public:
+
+    int32_t op;    // opcode
+    int32_t dst;   // register written
+    int32_t a;     // first operand register
+    int32_t b;     // second operand register
+    int32_t jump;  // instruction to continue from when short circuiting
+    int32_t id;    // header id of the INFO, FILTER or FORMAT tag
+    int32_t cmp;   // comparison applied to each sample by COUNT and ANY
+    std::vector<int32_t> gt; // encoded genotype compared against FMT.GT
+    Node* node;    // node this instruction was lowered from
+
+    /**
+     * Constructor.
+     */
+    FilterInstruction(int32_t op, int32_t dst, int32_t a, int32_t b, Node* node);
 };
 
 /**
@@ -136,6 +208,21 @@ class Filter
     bcf1_t *v;
     Variant *variant;
 
+    //expression tree lowered to a linear program for a header
+    bcf_hdr_t *compiled_h;
+    std::vector<FilterInstruction> program;
+    std::vector<FilterRegister> registers;
+    int32_t result;
+
+    //registers of the program as columns when evaluating batches of records
+    bool batchable;
+    std::vector<FilterColumn> columns;
+
+    //pass rates of logic operands are profiled over the first records
+    bool profile;
+    uint32_t no_profiled_records;
+    bool reordered;
+
     /**
      * Constructor.
      */
@@ -156,11 +243,21 @@ class Filter
      */
     bool apply(bcf_hdr_t *h, bcf1_t *v, Variant *variant, bool debug=false);
 
+    /**
+     * Applies filter to a batch of n vcf records, pass[k] is set if the kth record passes.
+     */
+    void apply(bcf_hdr_t *h, bcf1_t **v, Variant *variants, int32_t n, std::vector<bool>& pass, bool debug=false);
+
     /**
      * Attempts to simplify the expression tree by collapsing nodes that can be precomputed.
      */
     void simplify();
 
+    /**
+     * Lowers the expression tree into a program with tag IDs and types resolved against h.
+     */
+    void compile(bcf_hdr_t *h, bool debug=false);
+
     private:
 
     /**
@@ -178,6 +275,11 @@ class Filter
      */
     bool is_unary_op(const char* exp, int32_t len, bool debug=false);
 
+    /**
+     * Checks if exp is an aggregation over samples, returns its type, 0 otherwise.
+     */
+    int32_t is_aggregate(const char* exp, int32_t len, bool debug=false);
+
     /**
      * Checks is expression is bracketed.
      */
@@ -205,9 +307,79 @@ class Filter
     int32_t peek_op(const char* &r, int32_t len, int32_t &oplen, bool debug);
 
     /**
-     * Recursive call for apply.
+     * Recursive call for simplify, returns the node replacing node.
+     */
+    Node* simplify(Node* node);
+
+    /**
+     * Reorders the operands of a chain of ANDs or ORs, returns the node replacing node.
+     */
+    Node* reorder(Node* node);
+
+    /**
+     * Collects the operands and operators of a chain of logic ops of the given type.
+     */
+    void flatten(Node* node, int32_t type, std::vector<Node*>& operands, std::vector<Node*>& ops);
+
+    /**
+     * Evaluates a node with literal operands and turns it into a literal.
+     */
+    void fold(Node* node);
+
+    /**
+     * Checks if node holds a constant.
+     */
+    bool is_constant(Node* node);
+
+    /**
+     * Checks if node may evaluate to a missing value.
+     */
+    bool may_be_missing(Node* node);
+
+    /**
+     * Checks if node exists on every record and depends on the current record only.
+     */
+    bool is_total(Node* node);
+
+    /**
+     * Checks if node may reuse values from earlier records.
+     */
+    bool is_stale(Node* node);
+
+    /**
+     * Estimates the cost of evaluating node.
+     */
+    float cost(Node* node);
+
+    /**
+     * Clears the compiled program.
+     */
+    void clear_program();
+
+    /**
+     * Recursive call for compile, returns the register holding the value of node.
+     */
+    int32_t compile(Node* node, bool debug=false);
+
+    /**
+     * Compiles an aggregation over samples.
+     */
+    int32_t compile_aggregate(Node* node, bool debug=false);
+
+    /**
+     * Adds a register of the given type.
+     */
+    int32_t add_register(int32_t type);
+
+    /**
+     * Runs the compiled program on the current record.
+     */
+    void execute(bool debug=false);
+
+    /**
+     * Runs the compiled program on a batch of n records, one instruction at a time over all records.
      */
-    void apply(Node* node, bool debug=false);
+    void execute(bcf1_t **v, Variant *variants, int32_t n, bool debug=false);
 
     /**
      * Help message on filter expressions.
@@ -0,0 +1,148 @@
+/* The MIT License
+
+   Copyright (c) 2016 Adrian Tan <atks@umich.edu>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+#include "fingerprint_set.h"
+
+/**
+ * Constructor.
+ *
+ * @capacity - initial number of slots, rounded up to a power of 2
+ */
+FingerprintSet::FingerprintSet(uint32_t capacity)
+{
+    this->capacity = 16;
+    while (this->capacity<capacity)
+    {
+        this->capacity <<= 1;
+    }
+
+    mask = this->capacity-1;
+    slots = (uint64_t*) calloc(this->capacity, sizeof(uint64_t));
+    n = 0;
+}
+
+/**
+ * Destructor.
+ */
+FingerprintSet::~FingerprintSet()
+{
+    free(slots);
+}
+
+/**
+ * Inserts a fingerprint, returns false if it is already present.
+ */
+bool FingerprintSet::insert(uint64_t fingerprint)
+{
+    if (!fingerprint) fingerprint = 1;
+
+    uint32_t i = fingerprint & mask;
+    while (slots[i])
+    {
+        if (slots[i]==fingerprint)
+        {
+            return false;
+        }
+
+        i = (i+1) & mask;
+    }
+
+    slots[i] = fingerprint;
+
+    //keep the load factor at most 1/2
+    if (++n > (capacity>>1))
+    {
+        resize(capacity<<1);
+    }
+
+    return true;
+}
+
+/**
+ * Checks if a fingerprint is present.
+ */
+bool FingerprintSet::contains(uint64_t fingerprint)
+{
+    if (!fingerprint) fingerprint = 1;
+
+    uint32_t i = fingerprint & mask;
+    while (slots[i])
+    {
+        if (slots[i]==fingerprint)
+        {
+            return true;
+        }
+
+        i = (i+1) & mask;
+    }
+
+    return false;
+}
+
+/**
+ * Removes all fingerprints, keeping the slots.
+ */
+void FingerprintSet::clear()
+{
+    if (n)
+    {
+        memset(slots, 0, capacity*sizeof(uint64_t));
+        n = 0;
+    }
+}
+
+/**
+ * Gets the number of fingerprints.
+ */
+uint32_t FingerprintSet::size()
+{
+    return n;
+}
+
+/**
+ * Resizes the table and reinserts the fingerprints.
+ */
+void FingerprintSet::resize(uint32_t capacity)
+{
+    uint64_t *old_slots = slots;
+    uint32_t old_capacity = this->capacity;
+
+    this->capacity = capacity;
+    mask = capacity-1;
+    slots = (uint64_t*) calloc(capacity, sizeof(uint64_t));
+
+    for (uint32_t j=0; j<old_capacity; ++j)
+    {
+        if (old_slots[j])
+        {
+            uint32_t i = old_slots[j] & mask;
+            while (slots[i])
+            {
+                i = (i+1) & mask;
+            }
+            slots[i] = old_slots[j];
+        }
+    }
+
+    free(old_slots);
+}
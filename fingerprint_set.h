@@ -0,0 +1,85 @@
+/* The MIT License
+
+   Copyright (c) 2016 Adrian Tan <atks@umich.edu>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+#ifndef FINGERPRINT_SET_H
+#define FINGERPRINT_SET_H
+
+#include "utils.h"
+
+/**
+ * An open addressing hash set of 64 bit fingerprints.
+ *
+ * The fingerprints are assumed to be well mixed hashes and are used
+ * directly as the hash with linear probing.  0 marks an empty slot
+ * and is stored as 1.
+ */
+class FingerprintSet
+{
+    public:
+
+    /**
+     * Constructor.
+     *
+     * @capacity - initial number of slots, rounded up to a power of 2
+     */
+    FingerprintSet(uint32_t capacity=16);
+
+    /**
+     * Destructor.
+     */
+    ~FingerprintSet();
+
+    /**
+     * Inserts a fingerprint, returns false if it is already present.
+     */
+    bool insert(uint64_t fingerprint);
+
+    /**
+     * Checks if a fingerprint is present.
+     */
+    bool contains(uint64_t fingerprint);
+
+    /**
+     * Removes all fingerprints, keeping the slots.
+     */
+    void clear();
+
+    /**
+     * Gets the number of fingerprints.
+     */
+    uint32_t size();
+
+    private:
+
+    uint64_t *slots;
+    uint32_t capacity;
+    uint32_t mask;
+    uint32_t n;
+
+    /**
+     * Resizes the table and reinserts the fingerprints.
+     */
+    void resize(uint32_t capacity);
+};
+
+#endif
@@ -77,6 +77,7 @@ FlankDetector::FlankDetector(std::string& ref_fasta_file, bool debug)
     //initialize tools
     //////////////////
     rs = new ReferenceSequence(ref_fasta_file);
+    rs->set_streaming(true);
 };
 
 /**
@@ -157,9 +157,11 @@ class Igor : Program
         if (write_partition)
         {
             a_odw = new BCFOrderedWriter(a_vcf_file);
+            a_odw->enable_index();
             a_odw->link_hdr(odr->hdr);
             a_odw->write_hdr();
             b_odw = new BCFOrderedWriter(b_vcf_file);
+            b_odw->enable_index();
             b_odw->link_hdr(obom->odr->hdr);
             b_odw->write_hdr();
         }
@@ -172,6 +172,7 @@ class Igor : Program
 
         //output vcf
         odw = new BCFOrderedWriter(output_vcf_file);
+        odw->enable_index();
         bcf_hdr_transfer_contigs(gbr->odr->hdr, odw->hdr);
         bcf_hdr_add_sample(odw->hdr, strdup(sample_id.c_str()));
         bcf_hdr_add_sample(odw->hdr, NULL);
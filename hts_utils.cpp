@@ -93,6 +93,89 @@ bool str_ends_with(std::string& file_name, const char* ext)
     return false;
 }
 
+static int32_t n_hts_threads = 1;
+
+/**
+ * Sets the number of threads used for BGZF compression and
+ * decompression of files opened by the vt readers and writers.
+ */
+void set_n_hts_threads(int32_t n)
+{
+    n_hts_threads = n<1 ? 1 : n;
+}
+
+/**
+ * Gets the number of threads used for BGZF compression and decompression.
+ */
+int32_t get_n_hts_threads()
+{
+    return n_hts_threads;
+}
+
+/**
+ * Attaches the configured threads to an opened file.
+ * Returns 0 if no threads were attached.
+ */
+int32_t attach_hts_threads(htsFile *file)
+{
+    return attach_hts_threads(file, n_hts_threads);
+}
+
+/**
+ * Attaches n_threads threads to an opened file.
+ * Returns 0 if no threads were attached.
+ *
+ * The bundled htslib only parallelizes BGZF deflation, so this
+ * is effective for writers and a no-op for BGZF readers.
+ */
+int32_t attach_hts_threads(htsFile *file, int32_t n_threads)
+{
+    if (n_threads<=1 || file==NULL) return 0;
+
+    if (file->format.compression==bgzf && !file->is_write)
+    {
+        return 0;
+    }
+
+    return hts_set_threads(file, n_threads)==0 ? n_threads : 0;
+}
+
+static bool write_index = false;
+
+/**
+ * Sets if BCF/VCF.GZ files written by the vt writers are indexed while writing.
+ */
+void set_write_index(bool write_index)
+{
+    ::write_index = write_index;
+}
+
+/**
+ * Checks if BCF/VCF.GZ files written by the vt writers are indexed while writing.
+ */
+bool get_write_index()
+{
+    return write_index;
+}
+
+static bool packed_reference = false;
+
+/**
+ * Sets if reference sequences are read from a packed in memory copy of the FASTA file.
+ */
+void set_packed_reference(bool packed_reference)
+{
+    ::packed_reference = packed_reference;
+}
+
+/**
+ * Checks if reference sequences are read from a packed in memory copy of the FASTA file.
+ */
+bool get_packed_reference()
+{
+    return packed_reference;
+}
+
 /**************
  *BAM HDR UTILS
  **************/
@@ -436,7 +519,7 @@ bool bcf_hdr_exists(bcf_hdr_t *hdr, int32_t type, const char *key)
 }
 
 /**
- * Extracts sequence length by rid.
+ * Extracts sequence length by rid, -1 if the length is not declared.
  */
 int32_t* bcf_hdr_seqlen(const bcf_hdr_t *hdr, int32_t *nseq)
 {
@@ -451,10 +534,13 @@ int32_t* bcf_hdr_seqlen(const bcf_hdr_t *hdr, int32_t *nseq)
         tid = kh_val(d,k).id;
         len[tid] = bcf_hrec_find_key(kh_val(d, k).hrec[0],"length");
         int j;
-        if ( sscanf(kh_val(d, k).hrec[0]->vals[len[tid]],"%d",&j) )
+        if ( len[tid]>=0 && sscanf(kh_val(d, k).hrec[0]->vals[len[tid]],"%d",&j)==1 )
             len[tid] = j;
+        else
+            len[tid] = -1;
     }
 
+    *nseq = m;
     return len;
 }
 
@@ -1047,6 +1133,64 @@ void bcf_alleles2string_sorted(bcf_hdr_t *h, bcf1_t *v, kstring_t *var)
     }
 }
 
+/**
+ * Mixes the bits of a 64 bit hash.
+ */
+static inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * Gets a 64 bit FNV-1a hash of a string.
+ */
+static inline uint64_t str_hash64(const char* s)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*s)
+    {
+        h ^= (uint8_t) *s++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * Gets a 64 bit fingerprint of the alleles of a variant.
+ * The fingerprint does not depend on the order of the alternative alleles
+ * and is thus equal for variants with the same sorted allele representation.
+ */
+uint64_t bcf_alleles_fingerprint(bcf1_t *v)
+{
+    bcf_unpack(v, BCF_UN_STR);
+    char** allele = bcf_get_allele(v);
+    int32_t n_allele = bcf_get_n_allele(v);
+
+    //alternative alleles are summed so that their order does not matter
+    uint64_t alts = 0;
+    for (int32_t i=1; i<n_allele; ++i)
+    {
+        alts += mix64(str_hash64(allele[i]));
+    }
+
+    return mix64(str_hash64(allele[0]) ^ mix64(alts + n_allele));
+}
+
+/**
+ * Gets a 64 bit fingerprint of a variant from its contig, position
+ * and alleles, with the alternative alleles in any order.
+ */
+uint64_t bcf_variant_fingerprint(bcf1_t *v)
+{
+    uint64_t locus = ((uint64_t)(uint32_t)bcf_get_rid(v) << 32) | (uint32_t)bcf_get_pos1(v);
+    return mix64(bcf_alleles_fingerprint(v) ^ mix64(locus));
+}
+
 /**
  * Get chromosome name
  */
@@ -68,6 +68,49 @@ char *faidx_fetch_uc_seq(const faidx_t *fai, const char *c_name, int p_beg_i, in
  */
 bool str_ends_with(std::string& file_name, const char* ext);
 
+/**
+ * Sets the number of threads used for BGZF compression and
+ * decompression of files opened by the vt readers and writers.
+ */
+void set_n_hts_threads(int32_t n);
+
+/**
+ * Gets the number of threads used for BGZF compression and decompression.
+ */
+int32_t get_n_hts_threads();
+
+/**
+ * Attaches the configured threads to an opened file.
+ * Returns 0 if no threads were attached.
+ */
+int32_t attach_hts_threads(htsFile *file);
+
+/**
+ * Attaches n_threads threads to an opened file.
+ * Returns 0 if no threads were attached.
+ */
+int32_t attach_hts_threads(htsFile *file, int32_t n_threads);
+
+/**
+ * Sets if BCF/VCF.GZ files written by the vt writers are indexed while writing.
+ */
+void set_write_index(bool write_index);
+
+/**
+ * Checks if BCF/VCF.GZ files written by the vt writers are indexed while writing.
+ */
+bool get_write_index();
+
+/**
+ * Sets if reference sequences are read from a packed in memory copy of the FASTA file.
+ */
+void set_packed_reference(bool packed_reference);
+
+/**
+ * Checks if reference sequences are read from a packed in memory copy of the FASTA file.
+ */
+bool get_packed_reference();
+
 /**************
  *BAM HDR UTILS
  **************/
@@ -235,7 +278,7 @@ void bcf_hdr_transfer_contigs(const bcf_hdr_t *sh, bcf_hdr_t *vh);
 bool bcf_hdr_exists(bcf_hdr_t *hdr, int32_t type, const char *key);
 
 /**
- * Extracts sequence length by rid.
+ * Extracts sequence length by rid, -1 if the length is not declared.
  */
 int32_t* bcf_hdr_seqlen(const bcf_hdr_t *hdr, int32_t *nseq);
 
@@ -366,6 +409,19 @@ void bcf_alleles2string(bcf_hdr_t *h, bcf1_t *v, kstring_t *var);
  */
 void bcf_alleles2string_sorted(bcf_hdr_t *h, bcf1_t *v, kstring_t *var);
 
+/**
+ * Gets a 64 bit fingerprint of the alleles of a variant.
+ * The fingerprint does not depend on the order of the alternative alleles
+ * and is thus equal for variants with the same sorted allele representation.
+ */
+uint64_t bcf_alleles_fingerprint(bcf1_t *v);
+
+/**
+ * Gets a 64 bit fingerprint of a variant from its contig, position
+ * and alleles, with the alternative alleles in any order.
+ */
+uint64_t bcf_variant_fingerprint(bcf1_t *v);
+
 /**
  * Prints a VCF record to STDERR.
  */
@@ -68,11 +68,13 @@
 #include "profile_na12878.h"
 #include "profile_snps.h"
 #include "profile_vntrs.h"
+#include "ref_cache.h"
 #include "remove_overlap.h"
 #include "rminfo.h"
 #include "seq.h"
 #include "set_ref.h"
 #include "sort.h"
+#include "standardize.h"
 #include "subset.h"
 #include "svm_predict.h"
 #include "svm_train.h"
@@ -114,9 +116,11 @@ void help()
     std::clog << "Useful tools:\n";
     std::clog << "view                      view vcf/vcf.gz/bcf files\n";
     std::clog << "index                     index vcf.gz/bcf files\n";
+    std::clog << "ref_cache                 write a memory mapped image of a reference FASTA file\n";
     std::clog << "normalize                 normalize variants\n";
     std::clog << "decompose                 decompose variants\n";
     std::clog << "uniq                      drop duplicate variants\n";
+    std::clog << "standardize               decompose, normalize and drop duplicate variants in one pass\n";
     std::clog << "cat                       concatenate VCF files\n";
     std::clog << "paste                     paste VCF files\n";
     std::clog << "sort                      sort VCF files\n";
@@ -135,6 +139,11 @@ void help()
     std::clog << "discover                  discover variants\n";
     std::clog << "genotype                  genotype variants\n";
     std::clog << "\n";
+    std::clog << "Global options:\n";
+    std::clog << "--threads N               use N threads for BGZF compression and decompression\n";
+    std::clog << "--write-index             index BCF/VCF.GZ output files while writing them\n";
+    std::clog << "--packed-ref              load reference sequences once into a shared 2 bit packed store\n";
+    std::clog << "\n";
 }
 
 int main(int argc, char ** argv)
@@ -143,6 +152,8 @@ int main(int argc, char ** argv)
     t0 = clock();
     bool print = true;
 
+    Program::parse_global_options(argc, argv);
+
     if (argc==1)
     {
         help();
@@ -231,6 +242,10 @@ int main(int argc, char ** argv)
     {
         print = validate(argc-1, ++argv);
     }
+    else if (argc>1 && cmd=="ref_cache")
+    {
+        print = ref_cache(argc-1, ++argv);
+    }
     else if (argc>1 && cmd=="rminfo")
     {
         print = rminfo(argc-1, ++argv);
@@ -247,6 +262,10 @@ int main(int argc, char ** argv)
     {
         uniq(argc-1, ++argv);
     }
+    else if (argc>1 && cmd=="standardize")
+    {
+        print = standardize(argc-1, ++argv);
+    }
     else if (argc>1 && cmd=="set_ref")
     {
         set_ref(argc-1, ++argv);
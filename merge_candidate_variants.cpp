@@ -45,33 +45,26 @@ class Igor : Program
     std::string interval_list;
     float snp_variant_score_cutoff;
     float indel_variant_score_cutoff;
-
-    ///////
-    //i/o//
-    ///////
-    BCFSyncedReader *sr;
-    BCFOrderedWriter *odw;
-    bcf1_t *v;
+    uint32_t batch_size;
+    std::string tmp_dir;
+    uint32_t no_threads;
 
     ///////////////
     //general use//
     ///////////////
-    std::vector<int32_t> file_types;
-    kstring_t variant;
+    std::vector<std::vector<std::string> > batch_files;
+    std::vector<std::string> batch_output_files;
+    std::vector<GenomeInterval> batch_intervals;
+    std::atomic<uint32_t> next_batch;
 
     /////////
     //stats//
     /////////
     uint32_t no_samples;
+    uint32_t no_levels;
     uint32_t no_candidate_snps;
     uint32_t no_candidate_indels;
 
-    /////////
-    //tools//
-    /////////
-    LogTool *lt;
-    VariantManip * vm;
-
     Igor(int argc, char ** argv)
     {
         //////////////////////////
@@ -92,6 +85,10 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
             TCLAP::ValueArg<std::string> arg_input_vcf_file_list("L", "L", "file containing list of input VCF files", false, "", "str", cmd);
             TCLAP::ValueArg<float> arg_snp_variant_score_cutoff("c", "c", "SNP variant score cutoff [30]", false, 30, "float", cmd);
             TCLAP::ValueArg<float> arg_indel_variant_score_cutoff("d", "d", "Indel variant score cutoff [30]", false, 30, "float", cmd);
+            TCLAP::ValueArg<uint32_t> arg_batch_size("b", "b", "maximum number of files merged at once, larger inputs are merged\n"
+                 "              hierarchically through temporary files, 0 to disable [256]", false, 256, "int", cmd);
+            TCLAP::ValueArg<std::string> arg_tmp_dir("T", "tmp-dir", "directory for temporary files, by default beside the output file\n"
+                 "              or in $TMPDIR if the output is the standard output []", false, "", "str", cmd);
             TCLAP::UnlabeledMultiArg<std::string> arg_input_vcf_files("<in1.vcf>...", "Multiple VCF files",false, "files", cmd);
 
             cmd.parse(argc, argv);
@@ -100,6 +97,8 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
             output_vcf_file = arg_output_vcf_file.getValue();
             snp_variant_score_cutoff = arg_snp_variant_score_cutoff.getValue();
             indel_variant_score_cutoff = arg_indel_variant_score_cutoff.getValue();
+            batch_size = arg_batch_size.getValue();
+            tmp_dir = arg_tmp_dir.getValue();
             parse_intervals(intervals, arg_interval_list.getValue(), arg_intervals.getValue());
         }
         catch (TCLAP::ArgException &e)
@@ -110,13 +109,146 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
     };
 
     void initialize()
+    {
+        ///////////////
+        //general use//
+        ///////////////
+        no_samples = input_vcf_files.size();
+        no_threads = get_n_hts_threads();
+
+        ////////////////////////
+        //stats initialization//
+        ////////////////////////
+        no_levels = 0;
+        no_candidate_snps = 0;
+        no_candidate_indels = 0;
+    }
+
+    /**
+     * Merges the input files, hierarchically if there are more than batch_size files.
+     *
+     * The files are split into consecutive batches that are merged into
+     * temporary aggregated files in parallel, this is repeated on the
+     * temporary files until at most batch_size files remain.  As the batches
+     * preserve the order of the input files, the final merge is identical
+     * to merging all the files at once.
+     */
+    void merge_candidate_variants()
+    {
+        std::vector<std::string> files = input_vcf_files;
+        std::vector<GenomeInterval> merge_intervals = intervals;
+
+        while (batch_size>1 && files.size()>batch_size)
+        {
+            ++no_levels;
+
+            uint32_t no_batches = (files.size()+batch_size-1)/batch_size;
+            batch_files.clear();
+            batch_files.resize(no_batches);
+            batch_output_files.clear();
+            for (uint32_t i=0; i<no_batches; ++i)
+            {
+                //spread the files evenly across batches
+                size_t start = (files.size()*i)/no_batches;
+                size_t end = (files.size()*(i+1))/no_batches;
+                batch_files[i].assign(files.begin()+start, files.begin()+end);
+
+                batch_output_files.push_back(get_batch_file_name(no_levels, i));
+            }
+            batch_intervals = merge_intervals;
+
+            next_batch = 0;
+            std::vector<std::thread> threads;
+            for (uint32_t i=1; i<std::min(no_threads, no_batches); ++i)
+            {
+                threads.push_back(std::thread(&Igor::merge_batches, this));
+            }
+            merge_batches();
+            for (size_t i=0; i<threads.size(); ++i)
+            {
+                threads[i].join();
+            }
+
+            //remove temporary files from the previous level
+            if (no_levels>1)
+            {
+                for (size_t i=0; i<files.size(); ++i)
+                {
+                    std::remove(files[i].c_str());
+                }
+            }
+
+            files = batch_output_files;
+            merge_intervals.clear();
+        }
+
+        merge(files, output_vcf_file, merge_intervals, no_candidate_snps, no_candidate_indels);
+
+        if (no_levels)
+        {
+            for (size_t i=0; i<files.size(); ++i)
+            {
+                std::remove(files[i].c_str());
+            }
+        }
+    };
+
+    /**
+     * Gets the name of the temporary file of a batch, the process id
+     * keeps the names of concurrent runs apart.
+     */
+    std::string get_batch_file_name(uint32_t level, uint32_t i)
+    {
+        std::stringstream ss;
+        ss << level << "." << i+1 << ".bcf";
+
+        return get_tmp_file_name(tmp_dir, output_vcf_file, "vt_merge_candidate_variants", ss.str());
+    }
+
+    /**
+     * Merges batches of the current level until none are left.
+     */
+    void merge_batches()
+    {
+        uint32_t no_snps = 0;
+        uint32_t no_indels = 0;
+
+        uint32_t i;
+        while ((i = next_batch++) < batch_files.size())
+        {
+            //temporary files are lightly compressed as they are read only once
+            merge(batch_files[i], batch_output_files[i], batch_intervals, no_snps, no_indels, 1, true);
+        }
+    };
+
+    /**
+     * Merges candidate variants from a set of files.
+     *
+     * @files           - candidate variant files with one sample each or aggregated files
+     * @output_vcf_file - output file
+     * @intervals       - intervals to merge, if empty, all records are merged
+     * @no_snps         - incremented by the number of candidate SNPs written
+     * @no_indels       - incremented by the number of candidate Indels written
+     * @compression     - compression level of the output file
+     * @batch           - true if the output file is a temporary batch file
+     */
+    void merge(std::vector<std::string>& files, std::string output_vcf_file, std::vector<GenomeInterval>& intervals, uint32_t& no_snps, uint32_t& no_indels, int32_t compression=6, bool batch=false)
     {
         //////////////////////
         //i/o initialization//
         //////////////////////
-        sr = new BCFSyncedReader(input_vcf_files, intervals, false);
+        BCFSyncedReader *sr = new BCFSyncedReader(files, intervals, false);
 
-        odw = new BCFOrderedWriter(output_vcf_file, 0);
+        BCFOrderedWriter *odw = new BCFOrderedWriter(output_vcf_file, 0, compression);
+        //batches are merged in parallel, each with a single compression thread
+        if (batch)
+        {
+            odw->set_threads(1);
+        }
+        else
+        {
+            odw->enable_index();
+        }
         bcf_hdr_append(odw->hdr, "##fileformat=VCFv4.2");
         bcf_hdr_transfer_contigs(sr->hdrs[0], odw->hdr);
         bcf_hdr_append(odw->hdr, "##QUAL=Maximum variant score of the alternative allele likelihood ratio: -10 * log10 [P(Non variant)/P(Variant)] amongst all individuals.");
@@ -130,7 +262,7 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
         odw->write_hdr();
 
         //inspect header of each file to figure out if it is a merged candidate variant list or not
-        file_types.resize(sr->hdrs.size());
+        std::vector<int32_t> file_types(sr->hdrs.size());
         for (uint32_t i=0; i<sr->hdrs.size(); ++i)
         {
             if (bcf_hdr_exists(sr->hdrs[i], BCF_HL_INFO, "NSAMPLES") && bcf_hdr_get_n_sample(sr->hdrs[i])==0)
@@ -143,32 +275,13 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
             }
             else
             {
-                fprintf(stderr, "[E:%s:%d %s] Unrecognized VCF file type from vt pipeline: %s\n", __FILE__, __LINE__, __FUNCTION__, input_vcf_files[i].c_str());
+                fprintf(stderr, "[E:%s:%d %s] Unrecognized VCF file type from vt pipeline: %s\n", __FILE__, __LINE__, __FUNCTION__, files[i].c_str());
                 exit(1);
             }
         }
-       
-        ///////////////
-        //general use//
-        ///////////////
-        variant = {0,0,0};
-        no_samples = sr->nfiles;
-
-        ////////////////////////
-        //stats initialization//
-        ////////////////////////
-        no_candidate_snps = 0;
-        no_candidate_indels = 0;
 
-        /////////
-        //tools//
-        /////////
-        lt = new LogTool();
-        vm = new VariantManip();
-    }
+        VariantManip vm;
 
-    void merge_candidate_variants()
-    {
         int32_t *NSAMPLES = NULL;
         int32_t no_NSAMPLES = 0;
         int32_t *E = NULL;
@@ -222,7 +335,7 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
                     bcf_set_chrom(odw->hdr, nv, bcf_get_chrom(h, v));
                     bcf_set_pos1(nv, bcf_get_pos1(v));
                     bcf_update_alleles(odw->hdr, nv, const_cast<const char**>(bcf_get_allele(v)), bcf_get_n_allele(v));
-                    vtype = vm->classify_variant(odw->hdr, nv, var);
+                    vtype = vm.classify_variant(odw->hdr, nv, var);
                 }
 
                 float variant_score = bcf_get_qual(v);
@@ -235,6 +348,13 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
                 if ((vtype == VT_SNP && variant_score >= snp_variant_score_cutoff) ||
                     (vtype == VT_INDEL && variant_score >= indel_variant_score_cutoff))
                 {
+                    //alleles are taken from the first record that passes the cutoff so
+                    //that merging through intermediate files gives the same result
+                    if (!max_variant_score_gt_cutoff && i)
+                    {
+                        bcf_update_alleles(odw->hdr, nv, const_cast<const char**>(bcf_get_allele(v)), bcf_get_n_allele(v));
+                    }
+
                     max_variant_score_gt_cutoff = true;
 
                     if (max_variant_score < variant_score)
@@ -329,11 +449,11 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
 
                 if (vtype == VT_SNP)
                 {
-                    ++no_candidate_snps;
+                    ++no_snps;
                 }
                 else if (vtype == VT_INDEL)
                 {
-                    ++no_candidate_indels;
+                    ++no_indels;
                 }
             }
             
@@ -341,7 +461,14 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
         }
 
         sr->close();
+        delete sr;
         odw->close();
+        delete odw;
+        bcf_destroy(nv);
+        if (NSAMPLES) free(NSAMPLES);
+        if (E) free(E);
+        if (N) free(N);
+        if (SAMPLES) free(SAMPLES);
     };
 
     void print_options()
@@ -351,6 +478,8 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
         std::clog << "         [o] output VCF file             " << output_vcf_file << "\n";
         std::clog << "         [c] SNP variant score cutoff    " << snp_variant_score_cutoff << "\n";
         std::clog << "         [d] Indel variant score cutoff  " << indel_variant_score_cutoff << "\n";
+        print_num_op("         [b] batch size                  ", batch_size);
+        print_str_op("         [T] temporary directory         ", tmp_dir);
         print_int_op("         [i] intervals                   ", intervals);
         std::clog << "\n";
     }
@@ -358,7 +487,8 @@ Each VCF file is required to have the FORMAT flags E and N and should have exact
     void print_stats()
     {
         std::clog << "\n";
-        std::clog << "stats: Total Number of Candidate SNPs                 " << no_candidate_snps << "\n";
+        if (no_levels) std::clog << "stats: Number of intermediate merge levels            " << no_levels << "\n";
+        std::clog << (no_levels ? "       " : "stats: ") << "Total Number of Candidate SNPs                 " << no_candidate_snps << "\n";
         std::clog << "       Total Number of Candidate Indels               " << no_candidate_indels << "\n";
         std::clog << "\n";
     };
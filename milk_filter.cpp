@@ -153,6 +153,7 @@ class Igor : Program
     }
 
         odw = new BCFOrderedWriter(output_vcf_file, 0);
+        odw->enable_index();
 
     // copy header from the original BCF removing all records and sample info (i.e. keep ref info)
     bcf_hdr_t* null_hdr = bcf_hdr_subset(odr->hdr, 0, NULL, NULL);
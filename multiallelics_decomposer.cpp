@@ -0,0 +1,895 @@
+/* The MIT License
+
+   Copyright (c) 2016 Adrian Tan <atks@umich.edu>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+#include "multiallelics_decomposer.h"
+
+namespace
+{
+
+/**
+ * Ensures that a buffer holds at least n values.
+ */
+template<class T>
+void reserve_buffer(T*& buffer, size_t& m, size_t n)
+{
+    if (n>m)
+    {
+        m = n;
+        buffer = (T*) realloc(buffer, m*sizeof(T));
+    }
+}
+
+/**
+ * Remaps the alleles of n genotype values for the biallelic record
+ * of the ith allele, other alternative alleles become missing.
+ */
+void remap_genotypes(const int32_t* gt, uint32_t n, int32_t i, int32_t* gts)
+{
+    for (uint32_t j=0; j<n; ++j)
+    {
+        int32_t a = gt[j];
+        if (a<0)
+        {
+            gts[j] = a;
+        }
+        else
+        {
+            int32_t na = bcf_gt_allele(a);
+
+            if (na)
+            {
+                na = na==i ? 1 : -1;
+            }
+
+            gts[j] =  ((na+1)<<1) | bcf_gt_is_phased(a);
+        }
+    }
+}
+
+/**
+ * Gathers the values of the genotypes in genotype_index_map from
+ * each of the samples.  The common diploid case is unrolled.
+ */
+template<class T>
+void gather_genotype_values(const T* g, int32_t n_genotype, const int32_t* genotype_index_map, int32_t n_genotype2, uint32_t no_samples, T* gs)
+{
+    if (n_genotype2==3)
+    {
+        int32_t k1 = genotype_index_map[1];
+        int32_t k2 = genotype_index_map[2];
+        for (uint32_t j=0; j<no_samples; ++j)
+        {
+            gs[0] = g[0];
+            gs[1] = g[k1];
+            gs[2] = g[k2];
+            g += n_genotype;
+            gs += 3;
+        }
+    }
+    else
+    {
+        for (uint32_t j=0; j<no_samples; ++j)
+        {
+            for (int32_t k=0; k<n_genotype2; ++k)
+            {
+                gs[k] = g[genotype_index_map[k]];
+            }
+            g += n_genotype;
+            gs += n_genotype2;
+        }
+    }
+}
+
+}
+
+/**
+ * Constructor.
+ *
+ * @h     - header of the records to be decomposed
+ * @oh    - header of the decomposed records, with OLD_MULTIALLELIC defined
+ * @smart - split INFO and FORMAT fields by their number of values
+ */
+MultiallelicsDecomposer::MultiallelicsDecomposer(bcf_hdr_t *h, bcf_hdr_t *oh, bool smart)
+{
+    this->h = h;
+    this->oh = oh;
+    this->smart = smart;
+
+    copy_format = false;
+
+    old_alleles = {0,0,0};
+    new_alleles = {0,0,0};
+
+    gt = NULL;
+    n_gt = 0;
+    dp = NULL;
+    n_dp = 0;
+    ivalues = NULL;
+    n_ivalues = 0;
+    fvalues = NULL;
+    n_fvalues = 0;
+    svalues = NULL;
+    n_svalues = 0;
+    split_svalues = {0,0,0};
+
+    split_ivalues = NULL;
+    m_split_ivalues = 0;
+    split_fvalues = NULL;
+    m_split_fvalues = 0;
+
+    no_biallelic = 0;
+    no_multiallelic = 0;
+    no_additional_biallelic = 0;
+}
+
+/**
+ * Destructor.
+ */
+MultiallelicsDecomposer::~MultiallelicsDecomposer()
+{
+    if (old_alleles.m) free(old_alleles.s);
+    if (new_alleles.m) free(new_alleles.s);
+    if (split_svalues.m) free(split_svalues.s);
+
+    free(gt);
+    free(dp);
+    free(ivalues);
+    free(fvalues);
+    free(svalues);
+    free(split_ivalues);
+    free(split_fvalues);
+}
+
+/**
+ * n choose r.
+ */
+uint32_t MultiallelicsDecomposer::choose(uint32_t n, uint32_t r)
+{
+    if (r>n)
+    {
+        return 0;
+    }
+    else if (r==n)
+    {
+        return 1;
+    }
+    else if (r==0)
+    {
+        return 1;
+    }
+    else
+    {
+        if (r>(n>>1))
+        {
+            r = n-r;
+        }
+
+        uint32_t num = n;
+        uint32_t denum = 1;
+
+        for (uint32_t i=1; i<r; ++i)
+        {
+            num *= n-i;
+            denum *= i+1;
+        }
+
+        return num/denum;
+    }
+}
+
+/**
+ * Gets the genotype index remapping table for a ploidy and number of alleles.
+ * Row i-1 of the table holds, for the biallelic record of the ith allele,
+ * the index of each of its genotypes in the multiallelic record.
+ */
+const int32_t* MultiallelicsDecomposer::get_genotype_index_map(int32_t ploidy, int32_t n_allele)
+{
+    std::pair<int32_t, int32_t> key(ploidy, n_allele);
+    std::map<std::pair<int32_t, int32_t>, std::vector<int32_t> >::iterator it = genotype_index_maps.find(key);
+
+    if (it==genotype_index_maps.end())
+    {
+        int32_t n_genotype2 = bcf_ap2g(2, ploidy);
+        std::vector<int32_t>& map = genotype_index_maps[key];
+        map.resize((n_allele-1)*n_genotype2);
+
+        for (int32_t i=1; i<n_allele; ++i)
+        {
+            int32_t *row = &map[(i-1)*n_genotype2];
+            row[0] = 0;
+            uint32_t index = 0;
+            for (uint32_t k = 1; k<n_genotype2; ++k)
+            {
+                index += choose(ploidy-(k-1)+i-1,i-1);
+                row[k] = index;
+            }
+        }
+
+        return &map[0];
+    }
+
+    return &it->second[0];
+}
+
+/**
+ * Copies the FORMAT fields of multiallelic records to the decomposed
+ * records as is, without unpacking them, except for the listed tags
+ * which are still split.
+ */
+void MultiallelicsDecomposer::set_copy_format(std::vector<std::string>& split_format_tags)
+{
+    copy_format = true;
+    split_format_ids.clear();
+
+    for (size_t i=0; i<split_format_tags.size(); ++i)
+    {
+        int32_t id = bcf_hdr_id2int(h, BCF_DT_ID, split_format_tags[i].c_str());
+
+        if (!bcf_hdr_idinfo_exists(h, BCF_HL_FMT, id))
+        {
+            fprintf(stderr, "[%s:%d %s] FORMAT tag %s not found in header\n", __FILE__, __LINE__, __FUNCTION__, split_format_tags[i].c_str());
+            exit(1);
+        }
+
+        split_format_ids.push_back(id);
+    }
+}
+
+/**
+ * Checks if a FORMAT field is to be split.
+ */
+bool MultiallelicsDecomposer::is_split_format(int32_t id)
+{
+    if (!copy_format)
+    {
+        return true;
+    }
+
+    for (size_t i=0; i<split_format_ids.size(); ++i)
+    {
+        if (split_format_ids[i]==id)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Splits a comma separated INFO string for the ith allele.
+ */
+void MultiallelicsDecomposer::split_info_string(bcf1_t *nv, const char* tag, int32_t i)
+{
+    split_svalues.l = 0;
+    kputs(svalues, &split_svalues);
+
+    char* b = split_svalues.s;
+    char* c = split_svalues.s;
+    int32_t e = 0;
+    while (*b)
+    {
+        if (*b==',')
+        {
+            *b = 0;
+            ++e;
+
+            if (e==i)
+            {
+                bcf_update_info_string(oh, nv, tag, c);
+                break;
+            }
+
+            c = b+1;
+        }
+        //last occurrence
+        else if (*(b+1)==0)
+        {
+            bcf_update_info_string(oh, nv, tag, c);
+            break;
+        }
+
+        ++b;
+    }
+
+    if (e>i)
+    {
+        bcf_update_info_string(oh, nv, tag, NULL);
+    }
+}
+
+/**
+ * Decomposes a multiallelic record into biallelic records that are
+ * appended to decomposed_v in allele order and owned by the caller.
+ * Returns false if the record is biallelic and is left as is.
+ */
+bool MultiallelicsDecomposer::decompose(bcf1_t *v, std::vector<bcf1_t*>& decomposed_v)
+{
+    int32_t n_allele = bcf_get_n_allele(v);
+
+    if (n_allele > 2)
+    {
+        if (!smart)
+        {
+            ++no_multiallelic;
+            no_additional_biallelic += n_allele-2;
+
+            old_alleles.l = 0;
+            bcf_variant2string(oh, v, &old_alleles);
+
+            char** allele = bcf_get_allele(v);
+
+            size_t no_samples = bcf_hdr_nsamples(h);
+            bool has_GT = false;
+            bool has_PL = false;
+            bool has_GL = false;
+            bool has_DP = false;
+            int32_t ploidy = 0;
+            int32_t n_genotype;
+            int32_t n_genotype2;
+            const int32_t *genotype_index_map = NULL;
+
+            //with copied FORMAT fields, the multiallelic record is only
+            //unpacked if some of GT, PL, GL and DP are to be split
+            bool split_GT = is_split_format(bcf_hdr_id2int(h, BCF_DT_ID, "GT"));
+            bool split_PL = is_split_format(bcf_hdr_id2int(h, BCF_DT_ID, "PL"));
+            bool split_GL = is_split_format(bcf_hdr_id2int(h, BCF_DT_ID, "GL"));
+            bool split_DP = is_split_format(bcf_hdr_id2int(h, BCF_DT_ID, "DP"));
+            if (!(split_GT || split_PL || split_GL || split_DP))
+            {
+                no_samples = 0;
+            }
+
+            if (no_samples)
+            {
+                bcf_unpack(v, BCF_UN_FMT);
+
+                int32_t ret = bcf_get_genotypes(h, v, &gt, &n_gt);
+                if (ret>0) has_GT = true;
+                ploidy = has_GT ? ret/no_samples : 0;
+                n_genotype = bcf_ap2g(n_allele, ploidy);
+                n_genotype2 = bcf_ap2g(2, ploidy);
+
+                has_GT = has_GT && split_GT;
+                if (has_GT) reserve_buffer(split_ivalues, m_split_ivalues, no_samples*ploidy);
+
+                ret = split_PL ? bcf_get_format_int32(h, v, "PL", &ivalues, &n_ivalues) : 0;
+                if (ret>0)
+                {
+                    has_PL = true;
+                    reserve_buffer(split_ivalues, m_split_ivalues, no_samples*n_genotype2);
+                }
+
+                ret = split_GL ? bcf_get_format_float(h, v, "GL", &fvalues, &n_fvalues) : 0;
+                if (ret>0)
+                {
+                    has_GL = true;
+                    reserve_buffer(split_fvalues, m_split_fvalues, no_samples*n_genotype2);
+                }
+
+                ret = split_DP ? bcf_get_format_int32(h, v, "DP", &dp, &n_dp) : 0;
+                if (ret>0)
+                {
+                    has_DP = true;
+                }
+
+                if (has_PL || has_GL)
+                {
+                    genotype_index_map = get_genotype_index_map(ploidy, n_allele);
+                }
+            }
+
+            for (size_t i=1; i<n_allele; ++i)
+            {
+                bcf1_t* nv = bcf_dup(v);
+                new_alleles.l=0;
+                kputs(allele[0], &new_alleles);
+                kputc(',', &new_alleles);
+                kputs(allele[i], &new_alleles);
+
+                bcf_update_info_string(oh, nv, "OLD_MULTIALLELIC", old_alleles.s);
+                bcf_update_alleles_str(oh, nv, new_alleles.s);
+
+                if (no_samples)
+                {
+                    //remove other format values except for GT, PL, GL and DP
+                    if (i==1 && !copy_format)
+                    {
+                        bcf_fmt_t *fmt = v->d.fmt;
+                        for (size_t j = 0; j < v->n_fmt; ++j)
+                        {
+                            const char* tag = oh->id[BCF_DT_ID][fmt[j].id].key;
+
+                            if (strcmp(tag,"GT")&&strcmp(tag,"PL")&&strcmp(tag,"GL")&&strcmp(tag,"DP"))
+                            {
+                                bcf_update_format_int32(oh, nv, tag, 0, 0);
+                            }
+                        }
+                    }
+
+                    if (has_GT)
+                    {
+                        remap_genotypes(gt, no_samples*ploidy, i, split_ivalues);
+                        bcf_update_genotypes(oh, nv, split_ivalues, no_samples*ploidy);
+                    }
+
+                    if (has_PL)
+                    {
+                        gather_genotype_values(ivalues, n_genotype, &genotype_index_map[(i-1)*n_genotype2], n_genotype2, no_samples, split_ivalues);
+                        bcf_update_format_int32(oh, nv, "PL", split_ivalues, no_samples*n_genotype2);
+                    }
+
+                    if (has_GL)
+                    {
+                        gather_genotype_values(fvalues, n_genotype, &genotype_index_map[(i-1)*n_genotype2], n_genotype2, no_samples, split_fvalues);
+                        bcf_update_format_float(oh, nv, "GL", split_fvalues, no_samples*n_genotype2);
+                    }
+
+                    if (has_DP) bcf_update_format_int32(oh, nv, "DP", dp, no_samples);
+                }
+
+                //remove other format values except for GT, PL, GL and DP
+                bcf_fmt_t *fmt = v->d.fmt;
+                for (size_t j = 0; j < (copy_format ? 0 : v->n_fmt); ++j)
+                {
+                    const char* tag = oh->id[BCF_DT_ID][fmt[j].id].key;
+
+                    if (strcmp(tag,"GT")&&strcmp(tag,"PL")&&strcmp(tag,"GL")&&strcmp(tag,"DP"))
+                    {
+                        bcf_update_format_int32(oh, nv, tag, 0, 0);
+                    }
+                }
+
+                decomposed_v.push_back(nv);
+            }
+        }
+        else //smart decomposition
+        {
+            ++no_multiallelic;
+            no_additional_biallelic += n_allele-2;
+
+            old_alleles.l = 0;
+            bcf_variant2string(oh, v, &old_alleles);
+
+            int32_t rid = bcf_get_rid(v);
+            int32_t pos1 = bcf_get_pos1(v);
+            char** allele = bcf_get_allele(v);
+            uint32_t no_samples = bcf_hdr_nsamples(h);
+
+            //the decomposed records are filled field by field so that
+            //each field of the multiallelic record is extracted only once
+            size_t offset = decomposed_v.size();
+            for (size_t i=1; i<n_allele; ++i)
+            {
+                bcf1_t *nv = bcf_dup(v);
+                bcf_set_rid(nv, rid);
+                bcf_set_pos1(nv, pos1);
+                decomposed_v.push_back(nv);
+            }
+            bcf1_t **nvs = &decomposed_v[offset];
+
+            //////////////////////
+            //split up INFO fields
+            //////////////////////
+            if (v->n_info)
+            {
+                bcf_unpack(v, BCF_UN_INFO);
+
+                bcf_hdr_t* hdr = h;
+                bcf_info_t *info = v->d.info;
+
+                for (uint32_t j = 0; j < v->n_info; ++j)
+                {
+                    int32_t key = info[j].key;
+
+                    if (key<0)
+                    {
+                        fprintf(stderr, "[E::%s] invalid BCF, the INFO key key=%d not present in the header.\n", __func__, key);
+                        abort();
+                    }
+
+                    const char* tag = hdr->id[BCF_DT_ID][key].key;
+                    int32_t var_len = bcf_hdr_id2length(hdr,BCF_HL_INFO,key);
+                    int32_t type = info[j].type;
+
+                    if (var_len==BCF_VL_G)
+                    {
+                        if (type==BCF_BT_INT8||type==BCF_BT_INT16||type==BCF_BT_INT32)
+                        {
+                            int32_t ret = bcf_get_info_int32(h, v, tag, &ivalues, &n_ivalues);
+
+                            if (ret>0)
+                            {
+                                int32_t n_genotype = ret;
+                                int32_t ploidy = bcf_ag2p(n_allele, n_genotype);
+                                int32_t n_genotype2 = bcf_ap2g(2, ploidy);
+                                const int32_t *genotype_index_map = get_genotype_index_map(ploidy, n_allele);
+                                reserve_buffer(split_ivalues, m_split_ivalues, n_genotype2);
+
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    gather_genotype_values(ivalues, n_genotype, &genotype_index_map[(i-1)*n_genotype2], n_genotype2, 1, split_ivalues);
+                                    bcf_update_info_int32(oh, nvs[i-1], tag, split_ivalues, n_genotype2);
+                                }
+                            }
+                        }
+                        else if (type==BCF_BT_FLOAT)
+                        {
+                            int32_t ret = bcf_get_info_float(h, v, tag, &fvalues, &n_fvalues);
+
+                            if (ret>0)
+                            {
+                                int32_t n_genotype = ret;
+                                int32_t ploidy = bcf_ag2p(n_allele, n_genotype);
+                                int32_t n_genotype2 = bcf_ap2g(2, ploidy);
+                                const int32_t *genotype_index_map = get_genotype_index_map(ploidy, n_allele);
+                                reserve_buffer(split_fvalues, m_split_fvalues, n_genotype2);
+
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    gather_genotype_values(fvalues, n_genotype, &genotype_index_map[(i-1)*n_genotype2], n_genotype2, 1, split_fvalues);
+                                    bcf_update_info_float(oh, nvs[i-1], tag, split_fvalues, n_genotype2);
+                                }
+                            }
+                        }
+                        else if (type==BCF_BT_CHAR)
+                        {
+                            //not necessary
+                        }
+                    }
+                    else if (var_len == BCF_VL_A)
+                    {
+                        if (type==BCF_BT_INT8||type==BCF_BT_INT16||type==BCF_BT_INT32)
+                        {
+                            int32_t ret = bcf_get_info_int32(h, v, tag, &ivalues, &n_ivalues);
+                            if (ret>0)
+                            {
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    bcf_update_info_int32(oh, nvs[i-1], tag, &ivalues[i-1], 1);
+                                }
+                            }
+                        }
+                        else if (type==BCF_BT_FLOAT)
+                        {
+                            int32_t ret = bcf_get_info_float(h, v, tag, &fvalues, &n_fvalues);
+                            if (ret>0)
+                            {
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    bcf_update_info_float(oh, nvs[i-1], tag, &fvalues[i-1], 1);
+                                }
+                            }
+                        }
+                        else if (type==BCF_BT_CHAR)
+                        {
+                            int32_t ret = bcf_get_info_string(h, v, tag, &svalues, &n_svalues);
+                            if (ret>0)
+                            {
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    split_info_string(nvs[i-1], tag, i);
+                                }
+                            }
+                        }
+                    }
+                    else if (var_len == BCF_VL_R)
+                    {
+                        if (type==BCF_BT_INT8||type==BCF_BT_INT16||type==BCF_BT_INT32)
+                        {
+                            int32_t ret = bcf_get_info_int32(h, v, tag, &ivalues, &n_ivalues);
+                            if (ret>0)
+                            {
+                                int32_t as[2];
+                                as[0] = ivalues[0];
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    as[1] = ivalues[i];
+                                    bcf_update_info_int32(oh, nvs[i-1], tag, as, 2);
+                                }
+                            }
+                        }
+                        else if (type==BCF_BT_FLOAT)
+                        {
+                            int32_t ret = bcf_get_info_float(h, v, tag, &fvalues, &n_fvalues);
+                            if (ret>0)
+                            {
+                                float as[2];
+                                as[0] = fvalues[0];
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    as[1] = fvalues[i];
+                                    bcf_update_info_float(oh, nvs[i-1], tag, as, 2);
+                                }
+                            }
+                        }
+                        else if (type==BCF_BT_CHAR)
+                        {
+                            int32_t ret = bcf_get_info_string(h, v, tag, &svalues, &n_svalues);
+                            if (ret>0)
+                            {
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    split_info_string(nvs[i-1], tag, i);
+                                }
+                            }
+                        }
+                    }
+                    else if (var_len == BCF_VL_FIXED)
+                    {
+                        //leave it there
+                    }
+                    else if (var_len == BCF_VL_VAR)
+                    {
+                        //leave it there
+                    }
+                }
+            }
+
+            ////////////////////////
+            //split up FORMAT fields
+            ////////////////////////
+            if (no_samples && !(copy_format && split_format_ids.empty()))
+            {
+                bcf_unpack(v, BCF_UN_FMT);
+
+                if (v->n_fmt)
+                {
+                    bcf_hdr_t* hdr = h;
+                    bcf_fmt_t *fmt = v->d.fmt;
+
+                    for (uint32_t j = 0; j < (int32_t)v->n_fmt; ++j)
+                    {
+                        int32_t id = fmt[j].id;
+
+                        if (id<0)
+                        {
+                            fprintf(stderr, "[E::%s] invalid BCF, the FORMAT tag id=%d not present in the header.\n", __func__, id);
+                            abort();
+                        }
+
+                        if (!is_split_format(id))
+                        {
+                            continue;
+                        }
+
+                        const char* tag = hdr->id[BCF_DT_ID][id].key;
+                        int32_t var_len = bcf_hdr_id2length(hdr,BCF_HL_FMT,id);
+                        int32_t type = fmt[j].type;
+
+                        if (var_len==BCF_VL_G)
+                        {
+                            if (type==BCF_BT_INT8||type==BCF_BT_INT16||type==BCF_BT_INT32)
+                            {
+                                int32_t ret = bcf_get_format_int32(h, v, tag, &ivalues, &n_ivalues);
+                                int32_t n_genotype = ret/no_samples;
+                                int32_t ploidy = bcf_ag2p(n_allele, n_genotype);
+                                int32_t n_genotype2 = bcf_ap2g(2, ploidy);
+                                const int32_t *genotype_index_map = get_genotype_index_map(ploidy, n_allele);
+                                reserve_buffer(split_ivalues, m_split_ivalues, no_samples*n_genotype2);
+
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    gather_genotype_values(ivalues, n_genotype, &genotype_index_map[(i-1)*n_genotype2], n_genotype2, no_samples, split_ivalues);
+                                    bcf_update_format_int32(oh, nvs[i-1], tag, split_ivalues, no_samples*n_genotype2);
+                                }
+                            }
+                            else if (type==BCF_BT_FLOAT)
+                            {
+                                int32_t ret = bcf_get_format_float(h, v, tag, &fvalues, &n_fvalues);
+                                int32_t n_genotype = ret/no_samples;
+                                int32_t ploidy = bcf_ag2p(n_allele, n_genotype);
+                                int32_t n_genotype2 = bcf_ap2g(2, ploidy);
+                                const int32_t *genotype_index_map = get_genotype_index_map(ploidy, n_allele);
+                                reserve_buffer(split_fvalues, m_split_fvalues, no_samples*n_genotype2);
+
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    gather_genotype_values(fvalues, n_genotype, &genotype_index_map[(i-1)*n_genotype2], n_genotype2, no_samples, split_fvalues);
+                                    bcf_update_format_float(oh, nvs[i-1], tag, split_fvalues, no_samples*n_genotype2);
+                                }
+                            }
+                            else if (type==BCF_BT_CHAR)
+                            {
+                                //to be implemented
+                            }
+                        }
+                        else if (var_len == BCF_VL_A)
+                        {
+                            if (type==BCF_BT_INT8||type==BCF_BT_INT16||type==BCF_BT_INT32)
+                            {
+                                int32_t ret = bcf_get_format_int32(h, v, tag, &ivalues, &n_ivalues);
+                                reserve_buffer(split_ivalues, m_split_ivalues, no_samples);
+
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    int32_t* as = split_ivalues;
+                                    if (ret!=(n_allele-1)*no_samples)
+                                    {
+                                        for (uint32_t j=0; j<no_samples; ++j)
+                                        {
+                                            as[j] = bcf_int32_missing;
+                                        }
+                                    }
+                                    else
+                                    {
+                                        const int32_t* a = &ivalues[i-1];
+                                        for (uint32_t j=0; j<no_samples; ++j)
+                                        {
+                                            int32_t value = a[j*(n_allele-1)];
+                                            as[j] = value==bcf_int32_vector_end ? bcf_int32_missing : value;
+                                        }
+                                    }
+                                    bcf_update_format_int32(oh, nvs[i-1], tag, as, no_samples);
+                                }
+                            }
+                            else if (type==BCF_BT_FLOAT)
+                            {
+                                int32_t ret = bcf_get_format_float(h, v, tag, &fvalues, &n_fvalues);
+                                reserve_buffer(split_fvalues, m_split_fvalues, no_samples);
+
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    float* as = split_fvalues;
+                                    if (ret!=(n_allele-1)*no_samples)
+                                    {
+                                        for (uint32_t j=0; j<no_samples; ++j)
+                                        {
+                                            bcf_float_set_missing(as[j]);
+                                        }
+                                    }
+                                    else
+                                    {
+                                        const float* a = &fvalues[i-1];
+                                        for (uint32_t j=0; j<no_samples; ++j)
+                                        {
+                                            if (bcf_float_is_missing(a[j*(n_allele-1)]) ||
+                                                bcf_float_is_vector_end(a[j*(n_allele-1)]))
+                                            {
+                                                bcf_float_set_missing(as[j]);
+                                            }
+                                            else
+                                            {
+                                                as[j] = a[j*(n_allele-1)];
+                                            }
+                                        }
+                                    }
+
+                                    bcf_update_format_float(oh, nvs[i-1], tag, as, no_samples);
+                                }
+                            }
+                            else if (type==BCF_BT_CHAR)
+                            {
+                                //to be implemented
+                            }
+                        }
+                        else if (var_len == BCF_VL_R)
+                        {
+                            if (type==BCF_BT_INT8||type==BCF_BT_INT16||type==BCF_BT_INT32)
+                            {
+                                int32_t ret = bcf_get_format_int32(h, v, tag, &ivalues, &n_ivalues);
+                                reserve_buffer(split_ivalues, m_split_ivalues, no_samples*2);
+
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    int32_t* as = split_ivalues;
+                                    if (ret!=n_allele*no_samples)
+                                    {
+                                        for (uint32_t j=0; j<no_samples; ++j)
+                                        {
+                                            as[j*2] = bcf_int32_missing;
+                                            as[j*2+1] = bcf_int32_vector_end;
+                                        }
+                                    }
+                                    else
+                                    {
+                                        for (uint32_t j=0; j<no_samples; ++j)
+                                        {
+                                            as[j*2] = ivalues[j*n_allele];
+                                            as[j*2+1] = ivalues[j*n_allele+i];
+                                        }
+                                    }
+
+                                    bcf_update_format_int32(oh, nvs[i-1], tag, as, no_samples*2);
+                                }
+                            }
+                            else if (type==BCF_BT_FLOAT)
+                            {
+                                int32_t ret = bcf_get_format_float(h, v, tag, &fvalues, &n_fvalues);
+                                reserve_buffer(split_fvalues, m_split_fvalues, no_samples*2);
+
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    float* as = split_fvalues;
+                                    if (ret!=n_allele*no_samples)
+                                    {
+                                        for (uint32_t j=0; j<no_samples; ++j)
+                                        {
+                                            bcf_float_set_missing(as[j*2]);
+                                            bcf_float_set_vector_end(as[j*2+1]);
+                                        }
+                                    }
+                                    else
+                                    {
+                                        for (uint32_t j=0; j<no_samples; ++j)
+                                        {
+                                            as[j*2] = fvalues[j*n_allele];
+                                            as[j*2+1] = fvalues[j*n_allele+i];
+                                        }
+                                    }
+
+                                    bcf_update_format_float(oh, nvs[i-1], tag, as, no_samples*2);
+                                }
+                            }
+                            else if (type==BCF_BT_CHAR)
+                            {
+                                //to be implemented
+                            }
+                        }
+                        else if (var_len == BCF_VL_FIXED)
+                        {
+                            if (strcmp(tag,"GT")==0)
+                            {
+                                int32_t ret = bcf_get_genotypes(h, v, &gt, &n_gt);
+                                int32_t ploidy = ret/no_samples;
+                                reserve_buffer(split_ivalues, m_split_ivalues, no_samples*ploidy);
+
+                                for (size_t i=1; i<n_allele; ++i)
+                                {
+                                    remap_genotypes(gt, no_samples*ploidy, i, split_ivalues);
+                                    bcf_update_genotypes(oh, nvs[i-1], split_ivalues, no_samples*ploidy);
+                                }
+                            }
+                            else
+                            {
+                                //leave it there...
+                            }
+                        }
+                        else if (var_len == BCF_VL_VAR)
+                        {
+                            //leave it there
+                        }
+                    }
+                }
+            }
+
+            for (size_t i=1; i<n_allele; ++i)
+            {
+                new_alleles.l=0;
+                kputs(allele[0], &new_alleles);
+                kputc(',', &new_alleles);
+                kputs(allele[i], &new_alleles);
+
+                bcf_update_info_string(oh, nvs[i-1], "OLD_MULTIALLELIC", old_alleles.s);
+                bcf_update_alleles_str(oh, nvs[i-1], new_alleles.s);
+            }
+        }
+    }
+    else
+    {
+        ++no_biallelic;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,132 @@
+/* The MIT License
+
+   Copyright (c) 2016 Adrian Tan <atks@umich.edu>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+#ifndef MULTIALLELICS_DECOMPOSER_H
+#define MULTIALLELICS_DECOMPOSER_H
+
+#include "hts_utils.h"
+#include "utils.h"
+
+/**
+ * For decomposing multiallelic variants into biallelic variants.
+ */
+class MultiallelicsDecomposer
+{
+    public:
+
+    bcf_hdr_t *h;
+    bcf_hdr_t *oh;
+    bool smart;
+
+    //copy the FORMAT fields unsplit except for the listed tags
+    bool copy_format;
+    std::vector<int32_t> split_format_ids;
+
+    //helper variables
+    kstring_t new_alleles;
+    kstring_t old_alleles;
+
+    /////////
+    //stats//
+    /////////
+    uint32_t no_biallelic;
+    uint32_t no_multiallelic;
+    uint32_t no_additional_biallelic;
+
+    /**
+     * Constructor.
+     *
+     * @h     - header of the records to be decomposed
+     * @oh    - header of the decomposed records, with OLD_MULTIALLELIC defined
+     * @smart - split INFO and FORMAT fields by their number of values
+     */
+    MultiallelicsDecomposer(bcf_hdr_t *h, bcf_hdr_t *oh, bool smart);
+
+    /**
+     * Destructor.
+     */
+    ~MultiallelicsDecomposer();
+
+    /**
+     * Decomposes a multiallelic record into biallelic records that are
+     * appended to decomposed_v in allele order and owned by the caller.
+     * Returns false if the record is biallelic and is left as is.
+     */
+    bool decompose(bcf1_t *v, std::vector<bcf1_t*>& decomposed_v);
+
+    /**
+     * Copies the FORMAT fields of multiallelic records to the decomposed
+     * records as is, without unpacking them, except for the listed tags
+     * which are still split.  This is for analyses that only use the
+     * site information.
+     */
+    void set_copy_format(std::vector<std::string>& split_format_tags);
+
+    private:
+
+    //genotype index remapping tables by ploidy and number of alleles
+    std::map<std::pair<int32_t, int32_t>, std::vector<int32_t> > genotype_index_maps;
+
+    //buffers for values that are reused across records
+    int32_t *gt;
+    int32_t n_gt;
+    int32_t *dp;
+    int32_t n_dp;
+    int32_t *ivalues;
+    int32_t n_ivalues;
+    float *fvalues;
+    int32_t n_fvalues;
+    char *svalues;
+    int32_t n_svalues;
+    kstring_t split_svalues;
+
+    //buffers for the values of a decomposed record
+    int32_t *split_ivalues;
+    size_t m_split_ivalues;
+    float *split_fvalues;
+    size_t m_split_fvalues;
+
+    /**
+     * n choose r.
+     */
+    uint32_t choose(uint32_t n, uint32_t r);
+
+    /**
+     * Gets the genotype index remapping table for a ploidy and number of alleles.
+     * Row i-1 of the table holds, for the biallelic record of the ith allele,
+     * the index of each of its genotypes in the multiallelic record.
+     */
+    const int32_t* get_genotype_index_map(int32_t ploidy, int32_t n_allele);
+
+    /**
+     * Checks if a FORMAT field is to be split.
+     */
+    bool is_split_format(int32_t id);
+
+    /**
+     * Splits a comma separated INFO string for the ith allele.
+     */
+    void split_info_string(bcf1_t *nv, const char* tag, int32_t i);
+};
+
+#endif
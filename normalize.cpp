@@ -26,6 +26,17 @@
 namespace
 {
 
+/**
+ * A batch of records normalized by a worker thread.
+ */
+class NormalizeBatch
+{
+    public:
+    std::vector<bcf1_t*> v;
+    std::vector<bool> pass; //passes the filter
+    bool done;
+};
+
 class Igor : Program
 {
     public:
@@ -59,29 +70,22 @@ class Igor : Program
     Filter filter;
     bool filter_exists;
 
-    /////////
-    //stats//
-    /////////
-    uint32_t no_variants;
-    uint32_t no_refs;
-
-    uint32_t no_lt;    //# left trimmed
-    uint32_t no_rt;    //# right trimmed
-    uint32_t no_lt_rt; //# left trimmed and right trimmed
-    uint32_t no_rt_la; //# right trimmed and left aligned
-    uint32_t no_la;    //# left aligned
-
-    uint32_t no_multi_lt;    //# left trimmed
-    uint32_t no_multi_rt;    //# right trimmed
-    uint32_t no_multi_lt_rt; //# left trimmed and right trimmed
-    uint32_t no_multi_rt_la; //# right trimmed and left aligned
-    uint32_t no_multi_la;    //# left aligned
-
     /////////
     //tools//
     /////////
     VariantManip *vm;
 
+    ///////////
+    //threads//
+    ///////////
+    std::vector<VariantManip*> worker_vms;
+    std::vector<Filter*> worker_filters;
+    std::queue<NormalizeBatch*> ready_batches;
+    bool stop_workers;
+    std::mutex batch_mutex;
+    std::condition_variable batch_ready_cv;
+    std::condition_variable batch_done_cv;
+
     Igor(int argc, char **argv)
     {
         version = "0.5";
@@ -137,6 +141,7 @@ class Igor : Program
         //////////////////////
         odr = new BCFOrderedReader(input_vcf_file, intervals);
         odw = new BCFOrderedWriter(output_vcf_file, window_size);
+        odw->enable_index();
         odw->link_hdr(odr->hdr);
         bcf_hdr_append(odw->hdr, "##INFO=<ID=OLD_VARIANT,Number=.,Type=String,Description=\"Original chr:pos:ref:alt encoding\">\n");
         odw->write_hdr();
@@ -147,35 +152,20 @@ class Igor : Program
         filter.parse(fexp.c_str(), false);
         filter_exists = fexp=="" ? false : true;
             
-        ////////////////////////
-        //stats initialization//
-        ////////////////////////
-        no_variants = 0;
-        no_refs = 0;
-
-        no_lt = 0;
-        no_rt = 0;
-        no_lt_rt = 0;
-        no_rt_la = 0;
-        no_la = 0;
-
-        no_multi_lt = 0;
-        no_multi_rt = 0;
-        no_multi_lt_rt = 0;
-        no_multi_rt_la = 0;
-        no_multi_la = 0;
-
         ////////////////////////
         //tools initialization//
         ////////////////////////
         vm = new VariantManip(ref_fasta_file);
+        vm->set_streaming(true);
     }
 
     void normalize()
     {
-        int32_t left_extended = 0;
-        int32_t left_trimmed = 0;
-        int32_t right_trimmed = 0;
+        if (get_n_hts_threads()>1)
+        {
+            normalize_in_parallel(get_n_hts_threads());
+            return;
+        }
 
         kstring_t old_alleles = {0,0,0};
         kstring_t new_alleles = {0,0,0};
@@ -183,150 +173,193 @@ class Igor : Program
         v = odw->get_bcf1_from_pool();
         Variant variant;
 
-        bcf_hdr_t *h = odr->hdr;
-
         while (odr->read(v))
         {
-            bcf_unpack(v, BCF_UN_INFO);
+            if (!normalize(v, vm, &filter, variant, &old_alleles, &new_alleles))
+            {
+                continue;
+            }
+
+            odw->write(v);
+            v = odw->get_bcf1_from_pool();
+        }
+
+        odw->close();
+        odr->close();
+    };
+
+    /**
+     * Normalizes a record and updates the stats of vm.
+     * Returns false if the record is filtered out.
+     */
+    bool normalize(bcf1_t *v, VariantManip *vm, Filter *filter, Variant& variant, kstring_t *old_alleles, kstring_t *new_alleles)
+    {
+        bcf_unpack(v, BCF_UN_INFO);
 
-            if (debug) bcf_print_liten(odr->hdr, v);
+        if (debug) bcf_print_liten(odr->hdr, v);
 
-            int32_t type = vm->classify_variant(odw->hdr, v, variant);
+        int32_t type = vm->classify_variant(odw->hdr, v, variant);
 
-            if (filter_exists)
+        if (filter_exists)
+        {
+            if (!filter->apply(odr->hdr, v, &variant, false))
             {
-                if (!filter.apply(h, v, &variant, false))
-                {
-                    continue;
-                }
+                return false;
             }
-            
-            int32_t is_not_ref_consistent = 0;
-            if (type!=VT_SNP && (is_not_ref_consistent = vm->is_not_ref_consistent(h,v)))
+        }
+
+        vm->normalize_record(odw->hdr, v, type, strict_level, old_alleles, new_alleles);
+
+        return true;
+    };
+
+    /**
+     * Normalizes batches of records in worker threads and writes
+     * them in the input order.
+     */
+    void normalize_in_parallel(int32_t no_threads)
+    {
+        for (int32_t i=0; i<no_threads; ++i)
+        {
+            worker_vms.push_back(new VariantManip(ref_fasta_file));
+            worker_vms.back()->set_streaming(true);
+            worker_filters.push_back(new Filter());
+            worker_filters.back()->parse(fexp.c_str(), false);
+        }
+
+        stop_workers = false;
+        std::vector<std::thread> workers;
+        for (int32_t i=0; i<no_threads; ++i)
+        {
+            workers.push_back(std::thread(&Igor::normalize_worker, this, i));
+        }
+
+        //batches in input order, bounded to keep memory in check
+        std::deque<NormalizeBatch*> batches;
+        bool eof = false;
+        while (!eof)
+        {
+            NormalizeBatch *batch = NULL;
+            if ((int32_t) batches.size()==2*no_threads)
             {
-                if (is_not_ref_consistent > (2-strict_level))
-                {
-                    fprintf(stderr, "[%s:%d %s] Normalization not performed due to inconsistent reference sequences. (use -n or -m option to relax this)\n", __FILE__, __LINE__, __FUNCTION__);
-                    exit(1);
-                }
-                else 
+                batch = batches.front();
+                batches.pop_front();
+                write_batch(batch);
+            }
+            else
+            {
+                batch = new NormalizeBatch();
+            }
+
+            batch->v.clear();
+            batch->done = false;
+            while (batch->v.size()<NORMALIZE_BATCH_SIZE)
+            {
+                bcf1_t *v = odw->get_bcf1_from_pool();
+                if (!odr->read(v))
                 {
-                    fprintf(stderr, "[%s:%d %s] Normalization skipped due to inconsistent reference sequences\n", __FILE__, __LINE__, __FUNCTION__);
+                    odw->store_bcf1_into_pool(v);
+                    eof = true;
+                    break;
                 }
+                batch->v.push_back(v);
             }
 
-            if (!is_not_ref_consistent && !(type&VT_SV) && !(type&VT_VNTR) && !vm->is_normalized(v))
+            if (batch->v.empty())
             {
-                const char* chrom = odr->get_seqname(v);
-                int32_t pos1 = bcf_get_pos1(v);
+                delete batch;
+                break;
+            }
 
-                std::vector<std::string> alleles;
-                for (size_t i=0; i<bcf_get_n_allele(v); ++i)
-                {
-                    char *s = bcf_get_alt(v, i);
-                    while (*s)
-                    {
-                        *s = toupper(*s);
-                        ++s;
-                    }
-                    alleles.push_back(std::string(bcf_get_alt(v, i)));
-                }
-                left_extended = left_trimmed = right_trimmed = 0;
+            batches.push_back(batch);
+            std::unique_lock<std::mutex> lock(batch_mutex);
+            ready_batches.push(batch);
+            batch_ready_cv.notify_one();
+        }
 
-                vm->right_trim_or_left_extend(alleles, pos1, chrom, left_extended, right_trimmed);
-                vm->left_trim(alleles, pos1, left_trimmed);
+        while (!batches.empty())
+        {
+            write_batch(batches.front());
+            delete batches.front();
+            batches.pop_front();
+        }
 
-                if (left_trimmed || left_extended || right_trimmed)
-                {
-                    old_alleles.l = 0;
-                    bcf_variant2string(odw->hdr, v, &old_alleles);
-                    bcf_update_info_string(odw->hdr, v, "OLD_VARIANT", old_alleles.s);
-
-                    bcf_set_pos1(v, pos1);
-                    new_alleles.l = 0;
-                    for (size_t i=0; i<alleles.size(); ++i)
-                    {
-                        if (i) kputc(',', &new_alleles);
-                        kputs(alleles[i].c_str(), &new_alleles);
-                    }
-                    bcf_update_alleles_str(odw->hdr, v, new_alleles.s);
-
-                    if (bcf_get_n_allele(v)==2)
-                    {
-                        if (left_extended)
-                        {
-                            if (right_trimmed>left_extended)
-                            {
-                                ++no_rt_la;
-                            }
-                            else
-                            {
-                                ++no_la;
-                            }
-                        }
-                        else
-                        {
-                            if (left_trimmed && right_trimmed>left_extended)
-                            {
-                                ++no_lt_rt;
-                            }
-                            else if (left_trimmed)
-                            {
-                                ++no_lt;
-                            }
-                            else if (right_trimmed>left_extended)
-                            {
-                                ++no_rt;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        if (left_extended)
-                        {
-                            if (right_trimmed>left_extended)
-                            {
-                                ++no_multi_rt_la;
-                            }
-                            else
-                            {
-                                ++no_multi_la;
-                            }
-                        }
-                        else
-                        {
-                            if (left_trimmed && right_trimmed>left_extended)
-                            {
-                                ++no_multi_lt_rt;
-                            }
-                            else if (left_trimmed)
-                            {
-                                ++no_multi_lt;
-                            }
-                            else if (right_trimmed>left_extended)
-                            {
-                                ++no_multi_rt;
-                            }
-                        }
-                    }
-                }
-            }
+        {
+            std::unique_lock<std::mutex> lock(batch_mutex);
+            stop_workers = true;
+        }
+        batch_ready_cv.notify_all();
+        for (int32_t i=0; i<no_threads; ++i)
+        {
+            workers[i].join();
+            vm->norm_stats.add(worker_vms[i]->norm_stats);
+            delete worker_vms[i];
+            delete worker_filters[i];
+        }
+
+        odw->close();
+        odr->close();
+    };
 
-            if (type==VT_REF)
+    /**
+     * Waits for a batch to be normalized and writes the records that pass the filter.
+     */
+    void write_batch(NormalizeBatch *batch)
+    {
+        {
+            std::unique_lock<std::mutex> lock(batch_mutex);
+            batch_done_cv.wait(lock, [batch]{return batch->done;});
+        }
+
+        for (size_t i=0; i<batch->v.size(); ++i)
+        {
+            if (batch->pass[i])
             {
-                ++no_refs;
+                odw->write(batch->v[i]);
             }
             else
             {
-                ++no_variants;
+                odw->store_bcf1_into_pool(batch->v[i]);
             }
+        }
+        batch->v.clear();
+    };
 
-            odw->write(v);
-            v = odw->get_bcf1_from_pool();
+    /**
+     * Worker normalizing batches with its own reference and filter.
+     */
+    void normalize_worker(int32_t worker)
+    {
+        kstring_t old_alleles = {0,0,0};
+        kstring_t new_alleles = {0,0,0};
+        Variant variant;
+
+        while (true)
+        {
+            NormalizeBatch *batch = NULL;
+            {
+                std::unique_lock<std::mutex> lock(batch_mutex);
+                batch_ready_cv.wait(lock, [this]{return stop_workers || !ready_batches.empty();});
+                if (ready_batches.empty()) break;
+                batch = ready_batches.front();
+                ready_batches.pop();
+            }
+
+            batch->pass.resize(batch->v.size());
+            for (size_t i=0; i<batch->v.size(); ++i)
+            {
+                batch->pass[i] = normalize(batch->v[i], worker_vms[worker], worker_filters[worker], variant, &old_alleles, &new_alleles);
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(batch_mutex);
+                batch->done = true;
+            }
+            batch_done_cv.notify_all();
         }
 
-        odw->close();
-        odr->close();
+        if (old_alleles.m) free(old_alleles.s);
+        if (new_alleles.m) free(new_alleles.s);
     };
 
     void print_options()
@@ -352,32 +385,33 @@ class Igor : Program
     {
         if (!print) return;
 
-        int32_t no_biallelic_normalized = no_lt+no_rt+no_lt_rt+no_rt_la+no_la;
-        int32_t no_multiallelic_normalized = no_multi_lt+no_multi_rt+no_multi_lt_rt+no_multi_rt_la+no_multi_la;
+        NormalizationStats& stats = vm->norm_stats;
+        int32_t no_biallelic_normalized = stats.no_lt+stats.no_rt+stats.no_lt_rt+stats.no_rt_la+stats.no_la;
+        int32_t no_multiallelic_normalized = stats.no_multi_lt+stats.no_multi_rt+stats.no_multi_lt_rt+stats.no_multi_rt_la+stats.no_multi_la;
         int32_t no_normalized = no_biallelic_normalized + no_multiallelic_normalized;
 
         std::clog << "\n";
         std::clog << "stats: biallelic\n";
-        std::clog << "          no. left trimmed                      : " << no_lt << "\n";
-        std::clog << "          no. right trimmed                     : " << no_rt << "\n";
-        std::clog << "          no. left and right trimmed            : " << no_lt_rt << "\n";
-        std::clog << "          no. right trimmed and left aligned    : " << no_rt_la << "\n";
-        std::clog << "          no. left aligned                      : " << no_la << "\n";
+        std::clog << "          no. left trimmed                      : " << stats.no_lt << "\n";
+        std::clog << "          no. right trimmed                     : " << stats.no_rt << "\n";
+        std::clog << "          no. left and right trimmed            : " << stats.no_lt_rt << "\n";
+        std::clog << "          no. right trimmed and left aligned    : " << stats.no_rt_la << "\n";
+        std::clog << "          no. left aligned                      : " << stats.no_la << "\n";
         std::clog << "\n";
         std::clog << "       total no. biallelic normalized           : " << no_biallelic_normalized << "\n";
         std::clog << "\n";
         std::clog << "       multiallelic\n";
-        std::clog << "          no. left trimmed                      : " << no_multi_lt << "\n";
-        std::clog << "          no. right trimmed                     : " << no_multi_rt << "\n";
-        std::clog << "          no. left and right trimmed            : " << no_multi_lt_rt << "\n";
-        std::clog << "          no. right trimmed and left aligned    : " << no_multi_rt_la << "\n";
-        std::clog << "          no. left aligned                      : " << no_multi_la << "\n";
+        std::clog << "          no. left trimmed                      : " << stats.no_multi_lt << "\n";
+        std::clog << "          no. right trimmed                     : " << stats.no_multi_rt << "\n";
+        std::clog << "          no. left and right trimmed            : " << stats.no_multi_lt_rt << "\n";
+        std::clog << "          no. right trimmed and left aligned    : " << stats.no_multi_rt_la << "\n";
+        std::clog << "          no. left aligned                      : " << stats.no_multi_la << "\n";
         std::clog << "\n";
         std::clog << "       total no. multiallelic normalized        : " << no_multiallelic_normalized << "\n";
         std::clog << "\n";
         std::clog << "       total no. variants normalized            : " << no_normalized << "\n";
-        std::clog << "       total no. variants observed              : " << no_variants << "\n";
-        std::clog << "       total no. reference observed             : " << no_refs << "\n";
+        std::clog << "       total no. variants observed              : " << stats.no_variants << "\n";
+        std::clog << "       total no. reference observed             : " << stats.no_refs << "\n";
         std::clog << "\n";
     };
 
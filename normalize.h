@@ -24,8 +24,12 @@
 #ifndef NORMALIZE_H
 #define NORMALIZE_H
 
+#include <deque>
 #include "program.h"
 
+//number of records normalized together by a worker thread
+#define NORMALIZE_BATCH_SIZE 1024
+
 bool normalize(int argc, char ** argv);
 
 #endif
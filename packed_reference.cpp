@@ -0,0 +1,492 @@
+/* The MIT License
+
+   Copyright (c) 2016 Adrian Tan <atks@umich.edu>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+
+#include "packed_reference.h"
+
+namespace
+{
+//loaded references shared by the process
+std::map<std::string, PackedReference*> packed_references;
+std::mutex packed_references_mutex;
+
+//2 bit codes of bases, 4 denotes a base that is not A, C, G or T
+const uint8_t base2code[256] =
+{
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,0,4,1,4,4,4,2,4,4,4,4,4,4,4,4, 4,4,4,4,3,4,4,4,4,4,4,4,4,4,4,4,
+    4,0,4,1,4,4,4,2,4,4,4,4,4,4,4,4, 4,4,4,4,3,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4, 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4
+};
+
+const char code2base[4] = {'A', 'C', 'G', 'T'};
+
+//image layout: header, sequence offsets, sequence lengths, sequence names
+//padded to 8 bytes, runs and bases
+const char image_magic[8] = {'V', 'T', 'R', 'E', 'F', '\2', '\0', '\0'};
+
+class PackedReferenceImageHeader
+{
+    public:
+    char magic[8];
+    uint64_t no_seqs;
+    uint64_t no_bases;
+    uint64_t no_runs;
+    uint64_t names_size;
+
+    //size and modification time of the FASTA file that was packed
+    uint64_t fasta_size;
+    int64_t fasta_mtime;
+};
+
+/**
+ * Pads a size to 8 bytes.
+ */
+uint64_t pad8(uint64_t size)
+{
+    return (size+7)&~((uint64_t)7);
+}
+
+/**
+ * Orders runs by the offset past their last base, for locating the first run ending after an offset.
+ */
+bool run_ends_before(const PackedReferenceRun& run, uint64_t offset)
+{
+    return run.offset+run.len<=offset;
+}
+}
+
+/**
+ * Returns the packed reference of a FASTA file, loading it on first use.
+ * The reference is mapped from its image if present and use_image is set,
+ * and kept until the end of the process.
+ */
+PackedReference* PackedReference::load(std::string& ref_fasta_file, bool use_image)
+{
+    std::unique_lock<std::mutex> lock(packed_references_mutex);
+
+    std::map<std::string, PackedReference*>::iterator i = packed_references.find(ref_fasta_file);
+    if (i!=packed_references.end())
+    {
+        return i->second;
+    }
+
+    PackedReference *ref = new PackedReference();
+    std::string image_file = use_image ? get_image_file(ref_fasta_file) : "";
+    if (image_file!="")
+    {
+        ref->map(image_file);
+        ref->ref_fasta_file = ref_fasta_file;
+    }
+    else
+    {
+        ref->pack(ref_fasta_file);
+    }
+    packed_references[ref_fasta_file] = ref;
+
+    return ref;
+}
+
+/**
+ * Checks if a file is a reference image.
+ */
+bool PackedReference::is_image(std::string& file)
+{
+    FILE *fp = fopen(file.c_str(), "r");
+    if (fp==NULL) return false;
+
+    char magic[8];
+    bool image = fread(magic, 1, 8, fp)==8 && !memcmp(magic, image_magic, 8);
+    fclose(fp);
+
+    return image;
+}
+
+/**
+ * Gets the image file next to a FASTA file, empty if absent or stale.
+ */
+std::string PackedReference::get_image_file(std::string& ref_fasta_file)
+{
+    if (is_image(ref_fasta_file)) return ref_fasta_file;
+
+    std::string image_file = ref_fasta_file + PACKED_REFERENCE_IMAGE_EXT;
+    return is_current_image(image_file, ref_fasta_file) ? image_file : "";
+}
+
+/**
+ * Checks if an image was packed from a FASTA file in its current state, that is,
+ * the size and modification time of the FASTA file and the names and lengths of
+ * the sequences in its index match those recorded in the image.
+ */
+bool PackedReference::is_current_image(std::string& image_file, std::string& ref_fasta_file)
+{
+    struct stat fasta_stat, image_stat;
+    if (stat(ref_fasta_file.c_str(), &fasta_stat) || stat(image_file.c_str(), &image_stat))
+    {
+        return false;
+    }
+
+    FILE *fp = fopen(image_file.c_str(), "r");
+    if (fp==NULL) return false;
+
+    PackedReferenceImageHeader header;
+    bool current = fread(&header, sizeof(header), 1, fp)==1 &&
+                   !memcmp(header.magic, image_magic, 8) &&
+                   header.fasta_size==(uint64_t) fasta_stat.st_size &&
+                   header.fasta_mtime==(int64_t) fasta_stat.st_mtime &&
+                   header.no_seqs<=(uint64_t) image_stat.st_size/16 &&
+                   header.names_size<=(uint64_t) image_stat.st_size;
+
+    std::vector<uint64_t> lens;
+    std::string names;
+    if (current)
+    {
+        lens.resize(2*header.no_seqs);
+        names.resize(header.names_size);
+        current = fread(lens.data(), sizeof(uint64_t), lens.size(), fp)==lens.size() &&
+                  fread(&names[0], 1, names.size(), fp)==names.size();
+    }
+    fclose(fp);
+    if (!current) return false;
+
+    faidx_t *fai = fai_load(ref_fasta_file.c_str());
+    if (fai==NULL) return false;
+
+    current = (uint64_t) faidx_nseq(fai)==header.no_seqs;
+    size_t name_beg = 0;
+    for (uint64_t i=0; current && i<header.no_seqs; ++i)
+    {
+        const char* name = faidx_iseq(fai, i);
+        size_t name_len = strlen(name);
+        current = name_beg+name_len<names.size() &&
+                  names.compare(name_beg, name_len+1, name, name_len+1)==0 &&
+                  lens[header.no_seqs+i]==(uint64_t) faidx_seq_len(fai, name);
+        name_beg += name_len+1;
+    }
+    fai_destroy(fai);
+
+    return current;
+}
+
+/**
+ * Checks if a reference is an image or has an up to date image next to it.
+ */
+bool PackedReference::has_image(std::string& ref_fasta_file)
+{
+    return get_image_file(ref_fasta_file)!="";
+}
+
+/**
+ * Memory maps an image file.
+ */
+void PackedReference::map(std::string& image_file)
+{
+    int fd = open(image_file.c_str(), O_RDONLY);
+    struct stat image_stat;
+    if (fd==-1 || fstat(fd, &image_stat))
+    {
+        fprintf(stderr, "[%s:%d %s] cannot open reference image: %s\n", __FILE__, __LINE__, __FUNCTION__, image_file.c_str());
+        exit(1);
+    }
+
+    image_size = image_stat.st_size;
+    image = mmap(NULL, image_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image==MAP_FAILED)
+    {
+        fprintf(stderr, "[%s:%d %s] cannot map reference image: %s\n", __FILE__, __LINE__, __FUNCTION__, image_file.c_str());
+        exit(1);
+    }
+
+    //the counts are bounded by the image size before computing the
+    //expected size so that it cannot overflow
+    PackedReferenceImageHeader *header = (PackedReferenceImageHeader*) image;
+    bool ok = image_size>=sizeof(PackedReferenceImageHeader) &&
+              header->no_seqs<=image_size/16 &&
+              header->names_size<=image_size &&
+              header->no_runs<=image_size/sizeof(PackedReferenceRun) &&
+              header->no_bases<=4*(uint64_t)image_size;
+    ok = ok && image_size==sizeof(PackedReferenceImageHeader) + 16*header->no_seqs + pad8(header->names_size) +
+                           sizeof(PackedReferenceRun)*header->no_runs + ((header->no_bases+3)>>2);
+
+    uint8_t *p = (uint8_t*) image + sizeof(PackedReferenceImageHeader);
+    if (ok)
+    {
+        uint64_t *offsets = (uint64_t*) p;
+        uint64_t *lens = offsets + header->no_seqs;
+        const char *name = (const char*) (lens + header->no_seqs);
+        const char *names_end = name + header->names_size;
+        for (uint64_t i=0; ok && i<header->no_seqs; ++i)
+        {
+            const char *name_end = (const char*) memchr(name, '\0', names_end-name);
+            ok = name_end!=NULL &&
+                 lens[i]<=INT32_MAX &&
+                 offsets[i]<=header->no_bases &&
+                 lens[i]<=header->no_bases-offsets[i];
+            if (ok)
+            {
+                seq_names.push_back(std::string(name, name_end));
+                seq_lens.push_back(lens[i]);
+                seq_offsets.push_back(offsets[i]);
+                seq_ids[seq_names.back()] = i;
+                name = name_end+1;
+            }
+        }
+        p = (uint8_t*) (lens + header->no_seqs) + pad8(header->names_size);
+    }
+
+    if (ok)
+    {
+        no_runs = header->no_runs;
+        runs = no_runs ? (PackedReferenceRun*) p : NULL;
+        p += sizeof(PackedReferenceRun)*no_runs;
+
+        //runs are searched by offset so must be sorted and disjoint
+        uint64_t end = 0;
+        for (uint64_t i=0; ok && i<no_runs; ++i)
+        {
+            ok = runs[i].offset>=end &&
+                 runs[i].offset<=header->no_bases &&
+                 runs[i].len<=header->no_bases-runs[i].offset;
+            end = runs[i].offset+runs[i].len;
+        }
+
+        no_bases = header->no_bases;
+        bases = no_bases ? p : NULL;
+        fasta_size = header->fasta_size;
+        fasta_mtime = header->fasta_mtime;
+    }
+
+    if (!ok)
+    {
+        fprintf(stderr, "[%s:%d %s] truncated or corrupt reference image: %s\n", __FILE__, __LINE__, __FUNCTION__, image_file.c_str());
+        exit(1);
+    }
+}
+
+/**
+ * Writes the reference as an image file.
+ */
+void PackedReference::write_image(std::string& image_file)
+{
+    FILE *fp = fopen(image_file.c_str(), "w");
+    if (fp==NULL)
+    {
+        fprintf(stderr, "[%s:%d %s] cannot open reference image for writing: %s\n", __FILE__, __LINE__, __FUNCTION__, image_file.c_str());
+        exit(1);
+    }
+
+    std::string names;
+    for (size_t i=0; i<seq_names.size(); ++i)
+    {
+        names.append(seq_names[i]);
+        names.append(1, '\0');
+    }
+
+    PackedReferenceImageHeader header;
+    memcpy(header.magic, image_magic, 8);
+    header.no_seqs = seq_names.size();
+    header.no_bases = no_bases;
+    header.no_runs = no_runs;
+    header.names_size = names.size();
+    header.fasta_size = fasta_size;
+    header.fasta_mtime = fasta_mtime;
+    names.resize(pad8(names.size()), '\0');
+
+    std::vector<uint64_t> lens(seq_lens.begin(), seq_lens.end());
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp)==1;
+    if (header.no_seqs)
+    {
+        ok = ok && fwrite(&seq_offsets[0], sizeof(uint64_t), header.no_seqs, fp)==header.no_seqs;
+        ok = ok && fwrite(&lens[0], sizeof(uint64_t), header.no_seqs, fp)==header.no_seqs;
+    }
+    ok = ok && fwrite(names.c_str(), 1, names.size(), fp)==names.size();
+    ok = ok && fwrite(runs, sizeof(PackedReferenceRun), no_runs, fp)==no_runs;
+    ok = ok && fwrite(bases, 1, (no_bases+3)>>2, fp)==((no_bases+3)>>2);
+
+    if (fclose(fp) || !ok)
+    {
+        fprintf(stderr, "[%s:%d %s] failure to write reference image: %s\n", __FILE__, __LINE__, __FUNCTION__, image_file.c_str());
+        exit(1);
+    }
+}
+
+/**
+ * Packs the sequences of an indexed FASTA file.
+ */
+void PackedReference::pack(std::string& ref_fasta_file)
+{
+    this->ref_fasta_file = ref_fasta_file;
+
+    //recorded in images to detect a FASTA file changed after packing
+    struct stat fasta_stat;
+    faidx_t *fai = fai_load(ref_fasta_file.c_str());
+    if (fai==NULL || stat(ref_fasta_file.c_str(), &fasta_stat))
+    {
+        fprintf(stderr, "[%s:%d %s] cannot load genome index: %s\n", __FILE__, __LINE__, __FUNCTION__, ref_fasta_file.c_str());
+        exit(1);
+    }
+    fasta_size = fasta_stat.st_size;
+    fasta_mtime = fasta_stat.st_mtime;
+
+    no_bases = 0;
+    int32_t nseqs = faidx_nseq(fai);
+    for (int32_t i=0; i<nseqs; ++i)
+    {
+        const char* name = faidx_iseq(fai, i);
+        seq_names.push_back(std::string(name));
+        seq_lens.push_back(faidx_seq_len(fai, name));
+        seq_offsets.push_back(no_bases);
+        seq_ids[seq_names.back()] = i;
+        no_bases += seq_lens.back();
+    }
+
+    packed_bases.resize((no_bases+3)>>2, 0);
+    for (int32_t i=0; i<nseqs; ++i)
+    {
+        int32_t len = 0;
+        char* seq = faidx_fetch_seq(fai, seq_names[i].c_str(), 0, seq_lens[i]-1, &len);
+        if (!seq || len!=seq_lens[i])
+        {
+            fprintf(stderr, "[%s:%d %s] failure to extract sequence from fasta file: %s\n", __FILE__, __LINE__, __FUNCTION__, seq_names[i].c_str());
+            exit(1);
+        }
+
+        uint64_t offset = seq_offsets[i];
+        for (int32_t j=0; j<len; ++j, ++offset)
+        {
+            uint8_t code = base2code[(uint8_t) seq[j]];
+            if (code<4)
+            {
+                packed_bases[offset>>2] |= code<<((offset&3)<<1);
+            }
+            else
+            {
+                char base = toupper(seq[j]);
+                if (!packed_runs.empty() &&
+                    packed_runs.back().base==base &&
+                    packed_runs.back().offset+packed_runs.back().len==offset)
+                {
+                    ++packed_runs.back().len;
+                }
+                else
+                {
+                    PackedReferenceRun run;
+                    memset(&run, 0, sizeof(run));
+                    run.offset = offset;
+                    run.len = 1;
+                    run.base = base;
+                    packed_runs.push_back(run);
+                }
+            }
+        }
+
+        free(seq);
+    }
+
+    fai_destroy(fai);
+
+    bases = packed_bases.empty() ? NULL : &packed_bases[0];
+    runs = packed_runs.empty() ? NULL : &packed_runs[0];
+    no_runs = packed_runs.size();
+}
+
+/**
+ * Gets the id of a sequence, -1 if not present.
+ */
+int32_t PackedReference::get_seq_id(const char* chrom)
+{
+    std::map<std::string, int32_t>::iterator i = seq_ids.find(chrom);
+    return i==seq_ids.end() ? -1 : i->second;
+}
+
+/**
+ * Clamps a range to a sequence as in faidx.
+ */
+void PackedReference::clamp(int32_t seq_id, int32_t& beg0, int32_t& end0)
+{
+    int32_t len = seq_lens[seq_id];
+    if (end0<beg0) beg0 = end0;
+    if (beg0<0) beg0 = 0;
+    else if (len<=beg0) beg0 = len-1;
+    if (end0<0) end0 = 0;
+    else if (len<=end0) end0 = len-1;
+}
+
+/**
+ * Gets a base, 0 based position.  The position is clamped to the sequence.
+ */
+char PackedReference::fetch_base(int32_t seq_id, int32_t pos0)
+{
+    int32_t end0 = pos0;
+    clamp(seq_id, pos0, end0);
+    if (pos0<0) return 'N';
+
+    uint64_t offset = seq_offsets[seq_id] + pos0;
+    PackedReferenceRun *run = std::lower_bound(runs, runs+no_runs, offset, run_ends_before);
+    if (run!=runs+no_runs && run->offset<=offset)
+    {
+        return run->base;
+    }
+
+    return code2base[(bases[offset>>2]>>((offset&3)<<1))&3];
+}
+
+/**
+ * Fetches the bases of beg0 to end0 into seq and returns the number of bases.
+ * The positions are clamped to the sequence as in faidx and seq must hold
+ * end0-beg0+2 characters, the sequence is null terminated.
+ */
+int32_t PackedReference::fetch_seq(int32_t seq_id, int32_t beg0, int32_t end0, char* seq)
+{
+    clamp(seq_id, beg0, end0);
+    if (beg0<0)
+    {
+        seq[0] = '\0';
+        return 0;
+    }
+
+    uint64_t beg = seq_offsets[seq_id] + beg0;
+    uint64_t end = seq_offsets[seq_id] + end0 + 1;
+    int32_t len = end-beg;
+    for (uint64_t offset=beg; offset<end; ++offset)
+    {
+        seq[offset-beg] = code2base[(bases[offset>>2]>>((offset&3)<<1))&3];
+    }
+
+    for (PackedReferenceRun *run = std::lower_bound(runs, runs+no_runs, beg, run_ends_before);
+         run!=runs+no_runs && run->offset<end; ++run)
+    {
+        uint64_t run_beg = std::max(run->offset, beg);
+        uint64_t run_end = std::min(run->offset+run->len, end);
+        memset(seq+(run_beg-beg), run->base, run_end-run_beg);
+    }
+
+    seq[len] = '\0';
+    return len;
+}
@@ -0,0 +1,167 @@
+/* The MIT License
+
+   Copyright (c) 2016 Adrian Tan <atks@umich.edu>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+
+#ifndef PACKED_REFERENCE_H
+#define PACKED_REFERENCE_H
+
+#include <mutex>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "utils.h"
+#include "hts_utils.h"
+
+//extension of a reference image file written next to its FASTA file
+#define PACKED_REFERENCE_IMAGE_EXT ".vtref"
+
+/**
+ * A run of bases that cannot be encoded in 2 bits, N or IUPAC codes.
+ * The offset is the genome wide offset of the first base.
+ */
+class PackedReferenceRun
+{
+    public:
+    uint64_t offset;
+    uint32_t len;
+    char base;
+};
+
+/**
+ * A read only whole genome reference with the bases packed in 2 bits
+ * and the bases other than A, C, G and T stored as runs.
+ *
+ * A reference is loaded once per process and shared by all users,
+ * see load().  It is safe to query from multiple threads.
+ *
+ * The reference can be saved as an image file, see write_image(),
+ * that is memory mapped on loading.  Processes on a host then share
+ * the reference through the page cache.  The image is in the native
+ * byte order of the host that wrote it.
+ */
+class PackedReference
+{
+    public:
+
+    std::string ref_fasta_file;
+
+    //contigs
+    std::vector<std::string> seq_names;
+    std::vector<int32_t> seq_lens;
+    std::vector<uint64_t> seq_offsets; //genome wide offset of the first base
+    std::map<std::string, int32_t> seq_ids;
+
+    //4 bases per byte, the first base in the lowest 2 bits
+    uint8_t *bases;
+    uint64_t no_bases;
+
+    //runs of bases that are not A, C, G or T, sorted by offset
+    PackedReferenceRun *runs;
+    uint64_t no_runs;
+
+    /**
+     * Returns the packed reference of a FASTA file, loading it on first use.
+     * The reference is mapped from its image if present and use_image is set,
+     * and kept until the end of the process.
+     */
+    static PackedReference* load(std::string& ref_fasta_file, bool use_image=true);
+
+    /**
+     * Checks if a file is a reference image.
+     */
+    static bool is_image(std::string& file);
+
+    /**
+     * Checks if a reference is an image or has an up to date image next to it.
+     */
+    static bool has_image(std::string& ref_fasta_file);
+
+    /**
+     * Writes the reference as an image file.
+     */
+    void write_image(std::string& image_file);
+
+    /**
+     * Gets the id of a sequence, -1 if not present.
+     */
+    int32_t get_seq_id(const char* chrom);
+
+    /**
+     * Gets a base, 0 based position.  The position is clamped to the sequence.
+     */
+    char fetch_base(int32_t seq_id, int32_t pos0);
+
+    /**
+     * Fetches the bases of beg0 to end0 into seq and returns the number of bases.
+     * The positions are clamped to the sequence as in faidx and seq must hold
+     * end0-beg0+2 characters, the sequence is null terminated.
+     */
+    int32_t fetch_seq(int32_t seq_id, int32_t beg0, int32_t end0, char* seq);
+
+    private:
+
+    std::vector<uint8_t> packed_bases;
+    std::vector<PackedReferenceRun> packed_runs;
+
+    //memory mapped image
+    void *image;
+    size_t image_size;
+
+    //size and modification time of the packed FASTA file
+    uint64_t fasta_size;
+    int64_t fasta_mtime;
+
+    /**
+     * Constructor.
+     */
+    PackedReference() : image(NULL), image_size(0), fasta_size(0), fasta_mtime(0) {};
+
+    /**
+     * Gets the image file next to a FASTA file, empty if absent or stale.
+     */
+    static std::string get_image_file(std::string& ref_fasta_file);
+
+    /**
+     * Checks if an image was packed from a FASTA file in its current state.
+     */
+    static bool is_current_image(std::string& image_file, std::string& ref_fasta_file);
+
+    /**
+     * Memory maps an image file.
+     */
+    void map(std::string& image_file);
+
+    /**
+     * Packs the sequences of an indexed FASTA file.
+     */
+    void pack(std::string& ref_fasta_file);
+
+    /**
+     * Clamps a range to a sequence as in faidx.
+     */
+    void clamp(int32_t seq_id, int32_t& beg0, int32_t& end0);
+};
+
+#endif
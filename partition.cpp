@@ -184,15 +184,19 @@ class Igor : Program
         if (write_partition)
         {
             a = new BCFOrderedWriter("a-b.bcf");
+            a->enable_index();
             a->link_hdr(sr->hdrs[0]);
             a->write_hdr();
             ab[0] = new BCFOrderedWriter("a&b1.bcf");
+            ab[0]->enable_index();
             ab[0]->link_hdr(sr->hdrs[0]);
             ab[0]->write_hdr();
             ab[1] = new BCFOrderedWriter("a&b2.bcf");
+            ab[1]->enable_index();
             ab[1]->link_hdr(sr->hdrs[1]);
             ab[1]->write_hdr();
             b = new BCFOrderedWriter("b-a.bcf");
+            b->enable_index();
             b->link_hdr(sr->hdrs[1]);
             b->write_hdr();
         }
@@ -143,6 +143,7 @@ class Igor : Program
         //    odrs.push_back(new BCFOrderedReader(input_vcf_files[i], intervals));
         //}
         odw = new BCFOrderedWriter(output_vcf_file, 0);
+        odw->enable_index();
 	
         odw->set_hdr(odr->hdr);
 
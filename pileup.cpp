@@ -190,6 +190,7 @@ Pileup::Pileup(uint32_t k, uint32_t window_size)
     beg0 = end0 = 0;
     gbeg1 = 0;
 
+    rs = NULL;
     debug = 0;
 };
 
@@ -232,12 +233,7 @@ void Pileup::set_reference(std::string& ref_fasta_file)
 {
     if (ref_fasta_file!="")
     {
-        fai = fai_load(ref_fasta_file.c_str());
-        if (fai==NULL)
-        {
-            fprintf(stderr, "[%s:%d %s] cannot load genome index: %s\n", __FILE__, __LINE__, __FUNCTION__, ref_fasta_file.c_str());
-            exit(1);
-        }
+        rs = new ReferenceSequence(ref_fasta_file);
     }
 };
 
@@ -940,7 +936,7 @@ uint32_t Pileup::base2index(char base)
 char Pileup::get_base(std::string& chrom, uint32_t& pos1)
 {
     int ref_len = 0;
-    char *refseq = faidx_fetch_uc_seq(fai, chrom.c_str(), pos1-1, pos1-1, &ref_len);
+    char *refseq = rs->fetch_seq(chrom.c_str(), pos1, pos1, &ref_len);
     if (!refseq)
     {
         fprintf(stderr, "[%s:%d %s] failure to extrac base from fasta file: %s:%d: >\n", __FILE__, __LINE__, __FUNCTION__, chrom.c_str(), pos1-1);
@@ -958,7 +954,7 @@ char Pileup::get_base(std::string& chrom, uint32_t& pos1)
 char* Pileup::get_sequence(std::string& chrom, uint32_t pos1, uint32_t len)
 {
     int ref_len = 0;
-    char* seq = faidx_fetch_uc_seq(fai, chrom.c_str(), pos1-1, pos1+len-2, &ref_len);
+    char* seq = rs->fetch_seq(chrom.c_str(), pos1, pos1+len-1, &ref_len);
     if (!seq || ref_len!=len)
     {
         fprintf(stderr, "[%s:%d %s] failure to extract sequence from fasta file: %s:%d: >\n", __FILE__, __LINE__, __FUNCTION__, chrom.c_str(), pos1-1);
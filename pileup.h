@@ -26,6 +26,7 @@
 
 #include "utils.h"
 #include "hts_utils.h"
+#include "reference_sequence.h"
 #include "variant.h"
 
 /**
@@ -166,7 +167,7 @@ class Pileup
 
     int32_t debug;
 
-    faidx_t *fai;
+    ReferenceSequence *rs;
 
     public:
 
@@ -31,6 +31,10 @@ PERLregex::PERLregex()
    regex = "";
    re = NULL;
    match_data = NULL;
+   match_context = NULL;
+   jit_stack = NULL;
+   jit = false;
+   literal = false;
 };
 
 /**
@@ -40,6 +44,8 @@ PERLregex::~PERLregex()
 {
     if (re) pcre2_code_free(re);
     if (match_data) pcre2_match_data_free(match_data);
+    if (match_context) pcre2_match_context_free(match_context);
+    if (jit_stack) pcre2_jit_stack_free(jit_stack);
 };
 
 /**
@@ -57,10 +63,24 @@ void PERLregex::set(char* regex)
 {
     if (re) pcre2_code_free(re);
     if (match_data) pcre2_match_data_free(match_data);
+    if (match_context) pcre2_match_context_free(match_context);
+    if (jit_stack) pcre2_jit_stack_free(jit_stack);
+    re = NULL;
+    match_data = NULL;
+    match_context = NULL;
+    jit_stack = NULL;
+    jit = false;
 
     this->regex = regex;
     pattern = (PCRE2_SPTR) regex;
 
+    //patterns without metacharacters are plain substring searches
+    literal = strpbrk(regex, "\\^$.[]|()?*+{}")==NULL;
+    if (literal)
+    {
+        return;
+    }
+
     re = pcre2_compile(
                 pattern,               /* the pattern */
                 PCRE2_ZERO_TERMINATED, /* indicates pattern is zero-terminated */
@@ -78,6 +98,15 @@ void PERLregex::set(char* regex)
     }
 
     match_data = pcre2_match_data_create_from_pattern(re, NULL);
+
+    //falls back to the interpreter if JIT is not available on this platform
+    jit = pcre2_jit_compile(re, PCRE2_JIT_COMPLETE)==0;
+    if (jit)
+    {
+        jit_stack = pcre2_jit_stack_create(32*1024, 512*1024, NULL);
+        match_context = pcre2_match_context_create(NULL);
+        pcre2_jit_stack_assign(match_context, NULL, jit_stack);
+    }
 };
 
 /**
@@ -93,10 +122,28 @@ bool PERLregex::match(std::string& text)
  */
 bool PERLregex::match(char* text)
 {
+    if (literal)
+    {
+        return strstr(text, regex.c_str())!=NULL;
+    }
+
     subject = (PCRE2_SPTR) text;
     subject_length = strlen((char *)subject);
 
-    rc = pcre2_match(
+    if (jit)
+    {
+        rc = pcre2_jit_match(
+                re,                   /* the compiled pattern */
+                subject,              /* the subject string */
+                subject_length,       /* the length of the subject */
+                0,                    /* start at offset 0 in the subject */
+                0,                    /* default options */
+                match_data,           /* block for storing the result */
+                match_context);       /* holds the JIT stack */
+    }
+    else
+    {
+        rc = pcre2_match(
                 re,                   /* the compiled pattern */
                 subject,              /* the subject string */
                 subject_length,       /* the length of the subject */
@@ -104,6 +151,7 @@ bool PERLregex::match(char* text)
                 0,                    /* default options */
                 match_data,           /* block for storing the result */
                 NULL);                /* use default match context */
+    }
 
     return rc>0;
 };
\ No newline at end of file
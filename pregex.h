@@ -60,6 +60,11 @@ class PERLregex
     size_t subject_length;
     pcre2_match_data *match_data;
 
+    pcre2_match_context *match_context;
+    pcre2_jit_stack *jit_stack;
+    bool jit;     // pattern is compiled to machine code
+    bool literal; // pattern has no metacharacters and is matched as a substring
+
     /**
      * Constructor.
      */
@@ -324,6 +324,7 @@ class Igor : Program
         if (output_discordant_sites_and_genotypes)
         {
             odw = new BCFOrderedWriter(output_vcf_file);
+            odw->enable_index();
             odw->link_hdr(sr->hdrs[0]);
 
             for (uint32_t i=1; i<dataset_labels.size(); ++i)
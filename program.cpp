@@ -103,6 +103,66 @@ void VTOutput::usage(TCLAP::CmdLineInterface& c)
     std::clog  <<  "\n";
 }
 
+/**
+ * Parse global options that apply to all programs and removes them
+ * from the argument list before the program specific options are parsed.
+ *
+ * --threads N    - number of threads for BGZF compression and decompression
+ * --write-index  - index BCF/VCF.GZ output files while writing them
+ * --packed-ref   - read reference sequences from a packed in memory copy
+ *
+ * @argc - number of arguments, updated on return
+ * @argv - arguments, updated on return
+ */
+void Program::parse_global_options(int& argc, char** argv)
+{
+    int32_t j = 1;
+    for (int32_t i=1; i<argc; ++i)
+    {
+        const char* value = NULL;
+        if (!strcmp(argv[i], "--write-index"))
+        {
+            set_write_index(true);
+            continue;
+        }
+        else if (!strcmp(argv[i], "--packed-ref"))
+        {
+            set_packed_reference(true);
+            continue;
+        }
+        else if (!strcmp(argv[i], "--threads"))
+        {
+            if (i+1==argc)
+            {
+                fprintf(stderr, "[%s:%d %s] --threads requires a value\n", __FILE__, __LINE__, __FUNCTION__);
+                exit(1);
+            }
+            value = argv[++i];
+        }
+        else if (!strncmp(argv[i], "--threads=", 10))
+        {
+            value = argv[i]+10;
+        }
+        else
+        {
+            argv[j++] = argv[i];
+            continue;
+        }
+
+        char* end = NULL;
+        long n = strtol(value, &end, 10);
+        if (*value=='\0' || *end!='\0' || n<1)
+        {
+            fprintf(stderr, "[%s:%d %s] invalid number of threads : %s\n", __FILE__, __LINE__, __FUNCTION__, value);
+            exit(1);
+        }
+        set_n_hts_threads(n);
+    }
+
+    argc = j;
+    argv[argc] = NULL;
+}
+
 /**
  * Parse multiple files from command line unlabeled arguments or -L denoted file list.  If both are defined, the files are merged.
  *
@@ -394,4 +454,208 @@ char** Program::read_sample_list(int32_t& nsamples, std::string sample_list)
     }
 
     return NULL;
-}
\ No newline at end of file
+}
+/**
+ * Splits the genome into chunks for parallel processing.  The contigs
+ * are obtained from the CSI/TBI index of the input file and the chunk
+ * boundaries from the contig lengths in the header.  A contig without a
+ * declared length is processed as a single chunk, unless an interval
+ * with an end position is given for it.
+ *
+ * Returns false if the input file is not indexed.
+ *
+ * @chunks         - chunks stored in this vector, in coordinate order
+ * @input_vcf_file - indexed VCF/BCF file
+ * @intervals      - intervals to split, if empty, all indexed contigs are split
+ * @chunk_size     - size of a chunk in base pairs
+ */
+bool Program::split_into_chunks(std::vector<GenomeChunk>& chunks, std::string input_vcf_file, std::vector<GenomeInterval>& intervals, int32_t chunk_size)
+{
+    chunks.clear();
+
+    std::vector<GenomeInterval> no_intervals;
+    BCFOrderedReader odr(input_vcf_file, no_intervals);
+    if (!odr.is_index_loaded())
+    {
+        odr.close();
+        return false;
+    }
+
+    std::vector<GenomeInterval> regions = intervals;
+    if (regions.empty())
+    {
+        int32_t nseqs = 0;
+        const char** seqnames = odr.idx ? bcf_index_seqnames(odr.idx, odr.hdr, &nseqs) : tbx_seqnames(odr.tbx, &nseqs);
+        for (int32_t i=0; i<nseqs; ++i)
+        {
+            GenomeInterval interval(seqnames[i]);
+            regions.push_back(interval);
+        }
+        if (seqnames) free(seqnames);
+    }
+
+    std::map<std::string, int32_t> seqlens;
+    int32_t nseqs = 0;
+    const char** seqnames = bcf_hdr_seqnames(odr.hdr, &nseqs);
+    int32_t* lens = bcf_hdr_seqlen(odr.hdr, &nseqs);
+    for (int32_t i=0; i<nseqs; ++i)
+    {
+        seqlens[seqnames[i]] = lens[i];
+    }
+    if (seqnames) free(seqnames);
+    if (lens) free(lens);
+
+    chunk_size = std::max(chunk_size, 1);
+    for (size_t i=0; i<regions.size(); ++i)
+    {
+        GenomeChunk chunk;
+        chunk.interval = regions[i];
+        chunk.min_start1 = 0;
+
+        int32_t end1 = regions[i].end1;
+        if (seqlens.find(regions[i].seq)!=seqlens.end() && seqlens[regions[i].seq]>0)
+        {
+            end1 = std::min(end1, seqlens[regions[i].seq]);
+        }
+        else if (end1==(1<<29)-1)
+        {
+            //the end of the contig is unknown
+            end1 = chunk.interval.start1;
+        }
+
+        //records overlapping the start of the region belong to its first chunk
+        while (chunk.interval.start1+chunk_size<=end1)
+        {
+            chunk.interval.end1 = chunk.interval.start1+chunk_size-1;
+            chunks.push_back(chunk);
+            chunk.interval.start1 += chunk_size;
+            chunk.min_start1 = chunk.interval.start1;
+        }
+        chunk.interval.end1 = regions[i].end1;
+        chunks.push_back(chunk);
+    }
+
+    odr.close();
+    return true;
+}
+
+/**
+ * Processes an indexed file chunk by chunk on no_threads worker threads.
+ * Each worker has its own reader and calls process_chunk() which writes
+ * to a temporary file per chunk, placed as by get_tmp_file_name().  The
+ * temporary files are appended to odw in coordinate order as they are
+ * completed.  The header of odw must be written before calling this and
+ * is shared with the workers.
+ *
+ * Returns false without processing anything if the input file is not indexed,
+ * the caller is then expected to process the file sequentially.
+ */
+bool Program::process_chunks(std::string input_vcf_file, std::vector<GenomeInterval>& intervals, BCFOrderedWriter* odw, int32_t no_threads, std::string tmp_dir, int32_t chunk_size)
+{
+    std::vector<GenomeChunk> chunks;
+    if (!split_into_chunks(chunks, input_vcf_file, intervals, chunk_size))
+    {
+        return false;
+    }
+
+    std::string* chunk_files = new std::string[chunks.size()];
+    for (size_t i=0; i<chunks.size(); ++i)
+    {
+        std::stringstream ss;
+        ss << "chunk." << i+1 << ".bcf";
+        chunk_files[i] = get_tmp_file_name(tmp_dir, odw->file_name, "vt", ss.str());
+    }
+
+    next_chunk = 0;
+    chunk_done.assign(chunks.size(), false);
+
+    no_threads = std::max(1, std::min(no_threads, (int32_t) chunks.size()));
+    std::vector<std::thread> workers;
+    for (int32_t i=0; i<no_threads; ++i)
+    {
+        workers.push_back(std::thread(&Program::process_chunks_worker, this, i, input_vcf_file, &chunks, chunk_files, odw));
+    }
+
+    //append the chunks in coordinate order
+    std::vector<GenomeInterval> no_intervals;
+    for (size_t i=0; i<chunks.size(); ++i)
+    {
+        {
+            std::unique_lock<std::mutex> lock(chunk_mutex);
+            while (!chunk_done[i])
+            {
+                chunk_cv.wait(lock);
+            }
+        }
+
+        BCFOrderedReader *codr = new BCFOrderedReader(chunk_files[i], no_intervals);
+        bcf1_t *v = odw->get_bcf1_from_pool();
+        while (codr->read(v))
+        {
+            odw->write(v);
+            //a buffering writer takes ownership of the record
+            if (odw->window) v = odw->get_bcf1_from_pool();
+        }
+        odw->store_bcf1_into_pool(v);
+        codr->close();
+        delete codr;
+        remove(chunk_files[i].c_str());
+    }
+
+    for (int32_t i=0; i<no_threads; ++i)
+    {
+        workers[i].join();
+    }
+
+    delete [] chunk_files;
+    return true;
+}
+
+/**
+ * Worker thread for process_chunks().
+ */
+void Program::process_chunks_worker(int32_t worker, std::string input_vcf_file, std::vector<GenomeChunk>* chunks, std::string* chunk_files, BCFOrderedWriter* odw)
+{
+    std::vector<GenomeInterval> no_intervals;
+    BCFOrderedReader *odr = new BCFOrderedReader(input_vcf_file, no_intervals);
+
+    uint32_t i;
+    while ((i = next_chunk++) < chunks->size())
+    {
+        BCFOrderedWriter *codw = new BCFOrderedWriter(chunk_files[i], 0, -1);
+        codw->link_hdr(odw->hdr);
+        codw->write_hdr();
+
+        if (odr->jump_to_interval((*chunks)[i].interval))
+        {
+            process_chunk(worker, (*chunks)[i], odr, codw);
+        }
+
+        codw->close();
+        delete codw;
+
+        std::unique_lock<std::mutex> lock(chunk_mutex);
+        chunk_done[i] = true;
+        chunk_cv.notify_all();
+    }
+
+    odr->close();
+    delete odr;
+}
+
+/**
+ * Reads the next record of a chunk, records that belong to the
+ * previous chunk are skipped.  Returns false at the end of the chunk.
+ */
+bool Program::read_chunk(GenomeChunk& chunk, BCFOrderedReader* odr, bcf1_t* v)
+{
+    while (odr->read(v))
+    {
+        if (bcf_get_pos1(v)>=chunk.min_start1)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
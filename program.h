@@ -25,6 +25,10 @@
 #define PROGRAM_H
 
 #include <typeinfo>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include "tclap/CmdLine.h"
 #include "tclap/Arg.h"
 #include "bcf_ordered_reader.h"
@@ -48,6 +52,16 @@ class VTOutput : public TCLAP::StdOutput
     void usage(TCLAP::CmdLineInterface& c);
 };
 
+/**
+ * A chunk of the genome processed by a worker thread, see Program::process_chunks().
+ */
+class GenomeChunk
+{
+    public:
+    GenomeInterval interval; //region queried from the index
+    int32_t min_start1;      //records starting before this belong to the previous chunk
+};
+
 /**
  * Provides an interface for programs in vt.
  *
@@ -64,6 +78,19 @@ class Program
      */
     Program(){};
 
+    /**
+     * Parse global options that apply to all programs and removes them
+     * from the argument list before the program specific options are parsed.
+     *
+     * --threads N    - number of threads for BGZF compression and decompression
+     * --write-index  - index BCF/VCF.GZ output files while writing them
+     * --packed-ref   - read reference sequences from a packed in memory copy
+     *
+     * @argc - number of arguments, updated on return
+     * @argv - arguments, updated on return
+     */
+    static void parse_global_options(int& argc, char** argv);
+
     /**
      * Parse multiple files from command line unlabeled arguments or -L denoted file list.  If both are defined, the files are merged.
      *
@@ -160,7 +187,66 @@ class Program
      */
     void print_ifiles(const char* option_line, std::vector<std::string>& files);
 
+    /**
+     * Splits the genome into chunks for parallel processing.  The contigs
+     * are obtained from the CSI/TBI index of the input file and the chunk
+     * boundaries from the contig lengths in the header.  A contig without a
+     * declared length is processed as a single chunk, unless an interval
+     * with an end position is given for it.
+     *
+     * Returns false if the input file is not indexed.
+     *
+     * @chunks         - chunks stored in this vector, in coordinate order
+     * @input_vcf_file - indexed VCF/BCF file
+     * @intervals      - intervals to split, if empty, all indexed contigs are split
+     * @chunk_size     - size of a chunk in base pairs
+     */
+    bool split_into_chunks(std::vector<GenomeChunk>& chunks, std::string input_vcf_file, std::vector<GenomeInterval>& intervals, int32_t chunk_size=10000000);
+
+    /**
+     * Processes an indexed file chunk by chunk on no_threads worker threads.
+     * Each worker has its own reader and calls process_chunk() which writes
+     * to a temporary file per chunk, placed as by get_tmp_file_name().  The
+     * temporary files are appended to odw in coordinate order as they are
+     * completed.  The header of odw must be written before calling this and
+     * is shared with the workers.
+     *
+     * Returns false without processing anything if the input file is not indexed,
+     * the caller is then expected to process the file sequentially.
+     */
+    bool process_chunks(std::string input_vcf_file, std::vector<GenomeInterval>& intervals, BCFOrderedWriter* odw, int32_t no_threads, std::string tmp_dir="", int32_t chunk_size=10000000);
+
+    /**
+     * Processes a chunk, invoked on a worker thread by process_chunks().
+     * Records should be obtained with read_chunk() and updated and written
+     * with odw->hdr as the header of odr does not contain any header
+     * records added by the program.
+     *
+     * @worker - index of the worker thread, 0 to no_threads-1
+     * @chunk  - chunk to be processed
+     * @odr    - reader for the input file
+     * @odw    - writer for the chunk
+     */
+    virtual void process_chunk(int32_t worker, GenomeChunk& chunk, BCFOrderedReader* odr, BCFOrderedWriter* odw) {};
+
+    /**
+     * Reads the next record of a chunk, records that belong to the
+     * previous chunk are skipped.  Returns false at the end of the chunk.
+     */
+    bool read_chunk(GenomeChunk& chunk, BCFOrderedReader* odr, bcf1_t* v);
+
     private:
+
+    /**
+     * Worker thread for process_chunks().
+     */
+    void process_chunks_worker(int32_t worker, std::string input_vcf_file, std::vector<GenomeChunk>* chunks, std::string* chunk_files, BCFOrderedWriter* odw);
+
+    //for coordinating the worker threads in process_chunks()
+    std::atomic<uint32_t> next_chunk;
+    std::vector<bool> chunk_done;
+    std::mutex chunk_mutex;
+    std::condition_variable chunk_cv;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,155 @@
+/* The MIT License
+
+   Copyright (c) 2016 Adrian Tan <atks@umich.edu>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+
+#include "ref_cache.h"
+
+namespace
+{
+
+class Igor : Program
+{
+    public:
+
+    ///////////
+    //options//
+    ///////////
+    std::string ref_fasta_file;
+    std::string output_image_file;
+    bool print;
+
+    /////////
+    //stats//
+    /////////
+    uint32_t no_seqs;
+    uint64_t no_bases;
+    uint64_t no_runs;
+
+    Igor(int argc, char **argv)
+    {
+        version = "0.5";
+
+        //////////////////////////
+        //options initialization//
+        //////////////////////////
+        try
+        {
+            std::string desc = "Writes a packed image of a reference FASTA file that vt memory maps in place of the FASTA file.\n"
+                 "              The image is used by commands given the FASTA file with -r if the FASTA file and its index are unchanged since packing.";
+
+            TCLAP::CmdLine cmd(desc, ' ', version);
+            VTOutput my; cmd.setOutput(&my);
+            TCLAP::ValueArg<std::string> arg_output_image_file("o", "o", "output image file [<ref.fa>" PACKED_REFERENCE_IMAGE_EXT "]", false, "", "str", cmd);
+            TCLAP::SwitchArg arg_quiet("q", "q", "do not print options and summary [false]", cmd, false);
+            TCLAP::UnlabeledValueArg<std::string> arg_ref_fasta_file("<ref.fa>", "indexed reference FASTA or bgzipped FASTA file", true, "", "file", cmd);
+
+            cmd.parse(argc, argv);
+
+            ref_fasta_file = arg_ref_fasta_file.getValue();
+            output_image_file = arg_output_image_file.getValue();
+            print = !arg_quiet.getValue();
+
+            if (output_image_file=="")
+            {
+                output_image_file = ref_fasta_file + PACKED_REFERENCE_IMAGE_EXT;
+            }
+        }
+        catch (TCLAP::ArgException &e)
+        {
+            std::cerr << "error: " << e.error() << " for arg " << e.argId() << "\n";
+            abort();
+        }
+    };
+
+    void initialize()
+    {
+        if (PackedReference::is_image(ref_fasta_file))
+        {
+            fprintf(stderr, "[%s:%d %s] already a reference image: %s\n", __FILE__, __LINE__, __FUNCTION__, ref_fasta_file.c_str());
+            exit(1);
+        }
+
+        ////////////////////////
+        //stats initialization//
+        ////////////////////////
+        no_seqs = 0;
+        no_bases = 0;
+        no_runs = 0;
+    }
+
+    void ref_cache()
+    {
+        //packs the FASTA file even if it already has an image
+        PackedReference *ref = PackedReference::load(ref_fasta_file, false);
+
+        //write to a temporary file so that running commands never map a partial image
+        std::string tmp_image_file = output_image_file + ".tmp";
+        ref->write_image(tmp_image_file);
+        if (rename(tmp_image_file.c_str(), output_image_file.c_str()))
+        {
+            fprintf(stderr, "[%s:%d %s] cannot rename %s to %s\n", __FILE__, __LINE__, __FUNCTION__, tmp_image_file.c_str(), output_image_file.c_str());
+            exit(1);
+        }
+
+        no_seqs = ref->seq_names.size();
+        no_bases = ref->no_bases;
+        no_runs = ref->no_runs;
+    };
+
+    void print_options()
+    {
+        if (!print) return;
+
+        std::clog << "ref_cache v" << version << "\n\n";
+        std::clog << "options:     input FASTA file     " << ref_fasta_file << "\n";
+        std::clog << "         [o] output image file    " << output_image_file << "\n";
+        std::clog << "\n";
+    }
+
+    void print_stats()
+    {
+        if (!print) return;
+
+        std::clog << "\n";
+        std::clog << "stats: no. sequences              : " << no_seqs << "\n";
+        std::clog << "       no. bases                  : " << no_bases << "\n";
+        std::clog << "       no. runs of N/IUPAC bases  : " << no_runs << "\n";
+        std::clog << "\n";
+    };
+
+    ~Igor() {};
+
+    private:
+};
+
+}
+
+bool ref_cache(int argc, char ** argv)
+{
+    Igor igor(argc, argv);
+    igor.print_options();
+    igor.initialize();
+    igor.ref_cache();
+    igor.print_stats();
+    return igor.print;
+};
@@ -30,16 +30,7 @@
  */
 ReferenceSequence::ReferenceSequence(std::string& ref_fasta_file, uint32_t k, uint32_t window_size)
 {
-    this->ref_fasta_file = ref_fasta_file;
-    if (ref_fasta_file!="")
-    {
-        fai = fai_load(ref_fasta_file.c_str());
-        if (fai==NULL)
-        {
-            fprintf(stderr, "[%s:%d %s] cannot load genome index: %s\n", __FILE__, __LINE__, __FUNCTION__, ref_fasta_file.c_str());
-            exit(1);
-        }
-    }
+    set_reference(ref_fasta_file);
 
     //Buffer size is a power of 2^k.
     buffer_size = 1 << k;
@@ -53,6 +44,167 @@ ReferenceSequence::ReferenceSequence(std::string& ref_fasta_file, uint32_t k, ui
     gbeg1 = 0;
 
     debug = 0;
+
+    streaming = false;
+    prefetch_fai = NULL;
+    window_beg1 = 0;
+    window_seq_len = 0;
+    jump_beg1 = 0;
+    jump_end1 = 0;
+    prefetch_beg1 = 0;
+};
+
+/**
+ * Destructor.
+ */
+ReferenceSequence::~ReferenceSequence()
+{
+    cancel_prefetch();
+    if (prefetch_fai) fai_destroy(prefetch_fai);
+    if (fai) fai_destroy(fai);
+};
+
+/**
+ * Enables streaming of sequences for position sorted requests.
+ */
+void ReferenceSequence::set_streaming(bool streaming)
+{
+    cancel_prefetch();
+    window.clear();
+    window_chrom.clear();
+    jump_end1 = 0;
+
+    this->streaming = streaming;
+    if (streaming && !packed && fai && !prefetch_fai)
+    {
+        prefetch_fai = fai_load(ref_fasta_file.c_str());
+        if (prefetch_fai==NULL)
+        {
+            fprintf(stderr, "[%s:%d %s] cannot load genome index: %s\n", __FILE__, __LINE__, __FUNCTION__, ref_fasta_file.c_str());
+            exit(1);
+        }
+    }
+};
+
+/**
+ * Reads sequence chrom:beg1-end1 for the streaming window.
+ * Uses a separate index so that it can run in the background.
+ */
+std::string ReferenceSequence::read_window(std::string chrom, int32_t beg1, int32_t end1)
+{
+    std::string s;
+    if (packed)
+    {
+        int32_t seq_id = packed->get_seq_id(chrom.c_str());
+        if (seq_id!=-1)
+        {
+            s.resize(end1-beg1+2);
+            s.resize(packed->fetch_seq(seq_id, beg1-1, end1-1, &s[0]));
+        }
+    }
+    else
+    {
+        int32_t len = 0;
+        char* seq = faidx_fetch_uc_seq(prefetch_fai, chrom.c_str(), beg1-1, end1-1, &len);
+        if (seq)
+        {
+            s.assign(seq, len>0 ? len : 0);
+            free(seq);
+        }
+    }
+
+    return s;
+};
+
+/**
+ * Starts reading ahead the sequence after the streaming window.
+ */
+void ReferenceSequence::start_prefetch()
+{
+    prefetch_beg1 = window_beg1 + window.size();
+    if (prefetch_beg1>window_seq_len) return;
+
+    int32_t prefetch_end1 = std::min(prefetch_beg1+REFERENCE_PREFETCH_SIZE-1, window_seq_len);
+    prefetch = std::async(std::launch::async, &ReferenceSequence::read_window, this, window_chrom, prefetch_beg1, prefetch_end1);
+};
+
+/**
+ * Waits for and discards the read ahead sequence.
+ */
+void ReferenceSequence::cancel_prefetch()
+{
+    if (prefetch.valid()) prefetch.get();
+};
+
+/**
+ * Moves the streaming window to cover chrom:beg1-end1.
+ * Returns false if the request is not served from the window.
+ */
+bool ReferenceSequence::buffer_window(const char* chrom, int32_t beg1, int32_t end1)
+{
+    if (!streaming) return false;
+
+    if (window_chrom!=chrom)
+    {
+        window.clear();
+        window_chrom.assign(chrom);
+        std::string c(chrom);
+        window_seq_len = fetch_seq_len(c);
+        jump_end1 = 0;
+    }
+
+    //out of extent requests are clamped by a direct read
+    if (beg1<1 || end1<beg1 || end1>window_seq_len) return false;
+
+    int32_t window_end1 = window_beg1 + window.size() - 1;
+    if (!window.empty() && beg1>=window_beg1 && end1<=window_end1) return true;
+
+    if (window.empty() || beg1<window_beg1 || beg1>window_end1+REFERENCE_PREFETCH_SIZE)
+    {
+        //a jump is read directly, the window is only restarted when
+        //the next request advances from it as in a sorted stream
+        bool advancing = jump_end1 && beg1>=jump_beg1 && beg1<=jump_end1+REFERENCE_PREFETCH_SIZE;
+        jump_beg1 = beg1;
+        jump_end1 = end1;
+        if (!advancing) return false;
+        jump_end1 = 0;
+
+        cancel_prefetch();
+        window_beg1 = std::max(1, beg1-REFERENCE_LOOKBACK_SIZE);
+        window = read_window(window_chrom, window_beg1, end1);
+        if ((int32_t) window.size()!=end1-window_beg1+1)
+        {
+            window.clear();
+            return false;
+        }
+        start_prefetch();
+
+        return true;
+    }
+
+    //advance the window with the read ahead sequence
+    while (window_beg1+(int32_t)window.size()-1<end1)
+    {
+        if (!prefetch.valid()) start_prefetch();
+        std::string next = prefetch.valid() ? prefetch.get() : "";
+        if (next.empty())
+        {
+            window.clear();
+            return false;
+        }
+        window.append(next);
+        start_prefetch();
+    }
+
+    //the sequence before the lookback is dropped once it is half the window
+    int32_t lookback_beg1 = beg1-REFERENCE_LOOKBACK_SIZE;
+    if (lookback_beg1>window_beg1 && 2*(lookback_beg1-window_beg1)>(int32_t) window.size())
+    {
+        window.erase(0, lookback_beg1-window_beg1);
+        window_beg1 = lookback_beg1;
+    }
+
+    return true;
 };
 
 /**
@@ -60,6 +212,7 @@ ReferenceSequence::ReferenceSequence(std::string& ref_fasta_file, uint32_t k, ui
  */
 int32_t ReferenceSequence::fetch_nseq()
 {
+    if (packed) return packed->seq_names.size();
     return faidx_nseq(fai);
 }
 
@@ -68,6 +221,8 @@ int32_t ReferenceSequence::fetch_nseq()
  */
 std::string ReferenceSequence::fetch_iseq_name(int32_t i)
 {
+    if (packed) return packed->seq_names[i];
+
     std::string s;
     s.assign(faidx_iseq(fai, i));
     
@@ -79,6 +234,11 @@ std::string ReferenceSequence::fetch_iseq_name(int32_t i)
  */
 int32_t ReferenceSequence::fetch_seq_len(std::string& seq)
 {
+    if (packed)
+    {
+        int32_t seq_id = packed->get_seq_id(seq.c_str());
+        return seq_id==-1 ? -1 : packed->seq_lens[seq_id];
+    }
     return faidx_seq_len(fai, seq.c_str());
 }
 
@@ -89,9 +249,20 @@ char ReferenceSequence::fetch_base(std::string& chrom, int32_t& pos1)
 {
 
     //check buffer and retrieve base if it is in it.
-    if (this->chrom == chrom && pos1>=gbeg1 && pos1<=gbeg1+(end0-beg0))
+    if (buffer_window(chrom.c_str(), pos1, pos1))
     {
+        return window[pos1-window_beg1];
+    }
+    else if (packed)
+    {
+        int32_t seq_id = packed->get_seq_id(chrom.c_str());
+        if (seq_id==-1)
+        {
+            fprintf(stderr, "[%s:%d %s] failure to extrac base from fasta file: %s:%d: >\n", __FILE__, __LINE__, __FUNCTION__, chrom.c_str(), pos1-1);
+            exit(1);
+        }
 
+        return packed->fetch_base(seq_id, pos1-1);
     }
     else
     {
@@ -160,15 +331,46 @@ char* ReferenceSequence::fetch_seq(char* chrom, int32_t beg1, int32_t end1)
  */
 char* ReferenceSequence::fetch_seq(const char* chrom, int32_t beg1, int32_t end1)
 {
-    char* seq = NULL;
     int32_t len = 0;
-    seq = faidx_fetch_uc_seq(fai, const_cast<char*>(chrom), beg1-1, end1-1, &len);
+    return fetch_seq(chrom, beg1, end1, &len);
+};
+
+/**
+ * Fetches sequence chrom:beg1-end1 and its length in len.
+ * Positions are clamped to the sequence, the sequence is uppercased
+ * and has to be freed by the caller.
+ */
+char* ReferenceSequence::fetch_seq(const char* chrom, int32_t beg1, int32_t end1, int32_t* len)
+{
+    char* seq = NULL;
+    *len = 0;
+    if (buffer_window(chrom, beg1, end1))
+    {
+        *len = end1-beg1+1;
+        seq = (char*) malloc(*len+1);
+        memcpy(seq, &window[beg1-window_beg1], *len);
+        seq[*len] = '\0';
+        return seq;
+    }
 
-    if (len==-1)
+    if (packed)
+    {
+        int32_t seq_id = packed->get_seq_id(chrom);
+        if (seq_id==-1) return NULL;
+
+        int32_t beg0 = beg1-1, end0 = end1-1;
+        seq = (char*) malloc((end0<beg0 ? 1 : end0-beg0+1)+1);
+        *len = packed->fetch_seq(seq_id, beg0, end0, seq);
+        return seq;
+    }
+
+    seq = faidx_fetch_uc_seq(fai, const_cast<char*>(chrom), beg1-1, end1-1, len);
+
+    if (*len==-1)
     {
         fprintf(stderr, "[W:%s:%d %s] %s not found in reference sequence file %s\n", __FILE__, __LINE__, __FUNCTION__, chrom, ref_fasta_file.c_str());
     }
-    else if (len==-2)
+    else if (*len==-2)
     {
         fprintf(stderr, "[E:%s:%d %s] fatal error in extracting %s:%d-%d  reference sequence file: %s\n", __FILE__, __LINE__, __FUNCTION__, chrom, beg1, end1, ref_fasta_file.c_str());
         exit(1);
@@ -215,8 +417,16 @@ bool ReferenceSequence::is_empty()
 void ReferenceSequence::set_reference(std::string& ref_fasta_file)
 {
     this->ref_fasta_file = ref_fasta_file;
+    fai = NULL;
+    packed = NULL;
     if (ref_fasta_file!="")
     {
+        if (get_packed_reference() || PackedReference::has_image(ref_fasta_file))
+        {
+            packed = PackedReference::load(ref_fasta_file);
+            return;
+        }
+
         fai = fai_load(ref_fasta_file.c_str());
         if (fai==NULL)
         {
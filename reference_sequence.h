@@ -24,12 +24,29 @@
 #ifndef REFERENCE_SEQUENCE_H
 #define REFERENCE_SEQUENCE_H
 
+#include <future>
 #include "utils.h"
 #include "hts_utils.h"
+#include "packed_reference.h"
+
+//size of reference sequence read ahead in streaming mode
+#define REFERENCE_PREFETCH_SIZE 262144
+//size of reference sequence kept before the last request in streaming mode
+#define REFERENCE_LOOKBACK_SIZE 4096
 
 /**
  * A Reference Sequence object wrapping htslib's faidx.
  * This allows for buffered reading of seqeunces.
+ *
+ * When packed references are enabled, see set_packed_reference(),
+ * or the reference has an image written by vt ref_cache, sequences
+ * are read from a PackedReference shared by the process.
+ *
+ * In streaming mode, see set_streaming(), requests are served from
+ * a window of the reference that advances with the requests and the
+ * sequence after the window is read ahead in the background.  This
+ * suits position sorted records, other requests are read directly
+ * and the window is restarted once the requests advance again.
  */
 class ReferenceSequence
 {
@@ -38,6 +55,7 @@ class ReferenceSequence
     //reference file and index
     std::string ref_fasta_file;
     faidx_t *fai;
+    PackedReference *packed;
 
     uint32_t buffer_size;
     uint32_t buffer_size_mask;
@@ -75,6 +93,22 @@ class ReferenceSequence
 
     int32_t debug;
 
+    //streaming window, window_beg1 is the position of window[0]
+    bool streaming;
+    faidx_t *prefetch_fai;
+    std::string window;
+    std::string window_chrom;
+    int32_t window_beg1;
+    int32_t window_seq_len;
+
+    //last request outside the window, jump_end1 is 0 if there is none
+    int32_t jump_beg1;
+    int32_t jump_end1;
+
+    //read ahead sequence starting at prefetch_beg1
+    std::future<std::string> prefetch;
+    int32_t prefetch_beg1;
+
     public:
 
     /**
@@ -84,6 +118,16 @@ class ReferenceSequence
      */
     ReferenceSequence(std::string& ref_fasta_file, uint32_t k=10, uint32_t window_size=256);
 
+    /**
+     * Destructor.
+     */
+    ~ReferenceSequence();
+
+    /**
+     * Enables streaming of sequences for position sorted requests.
+     */
+    void set_streaming(bool streaming);
+
     /**
      * Fetches the number of sequences.
      */
@@ -131,8 +175,37 @@ class ReferenceSequence
      */
     char* fetch_seq(const char* chrom, int32_t beg1, int32_t end1);
 
+    /**
+     * Fetches sequence chrom:beg1-end1 and its length in len.
+     * Positions are clamped to the sequence, the sequence is uppercased
+     * and has to be freed by the caller.
+     */
+    char* fetch_seq(const char* chrom, int32_t beg1, int32_t end1, int32_t* len);
+
     private:
 
+    /**
+     * Reads sequence chrom:beg1-end1 for the streaming window.
+     * Uses a separate index so that it can run in the background.
+     */
+    std::string read_window(std::string chrom, int32_t beg1, int32_t end1);
+
+    /**
+     * Starts reading ahead the sequence after the streaming window.
+     */
+    void start_prefetch();
+
+    /**
+     * Waits for and discards the read ahead sequence.
+     */
+    void cancel_prefetch();
+
+    /**
+     * Moves the streaming window to cover chrom:beg1-end1.
+     * Returns false if the request is not served from the window.
+     */
+    bool buffer_window(const char* chrom, int32_t beg1, int32_t end1);
+
     /**
      * Overloads subscript operator for accessing buffered sequence positions.
      */
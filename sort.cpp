@@ -26,18 +26,83 @@
 namespace
 {
 
-//sort and write out
-int bcf_compare (const void * a, const void * b)
+/**
+ * Orders records by contig and position, used with stable sort
+ * so that records at the same position keep the input order.
+ */
+bool bcf_less(bcf1_t *u, bcf1_t *v)
 {
-    bcf1_t *u = *(bcf1_t**) a;
-    bcf1_t *v = *(bcf1_t**) b;
-
     if (bcf_get_rid(u)==bcf_get_rid(v))
     {
-        return (bcf_get_pos1(u)-bcf_get_pos1(v));
+        return bcf_get_pos1(u)<bcf_get_pos1(v);
     }
 
-    return (bcf_get_rid(u)-bcf_get_rid(v));
+    return bcf_get_rid(u)<bcf_get_rid(v);
+}
+
+/**
+ * Head record of a sorted run in the k-way merge.
+ */
+class sorted_run_head
+{
+    public:
+    int32_t rid;
+    int32_t pos1;
+    int32_t run;
+    bcf1_t *v;
+
+    sorted_run_head(int32_t run, bcf1_t *v)
+    {
+        this->rid = bcf_get_rid(v);
+        this->pos1 = bcf_get_pos1(v);
+        this->run = run;
+        this->v = v;
+    };
+};
+
+/**
+ * Comparator for sorted_run_head in priority_queue, smallest on top.
+ * Ties are broken by the run index as earlier runs hold earlier records.
+ */
+class CompareSortedRunHead
+{
+    public:
+    bool operator()(const sorted_run_head& a, const sorted_run_head& b)
+    {
+        if (a.rid!=b.rid) return a.rid>b.rid;
+        if (a.pos1!=b.pos1) return a.pos1>b.pos1;
+        return a.run>b.run;
+    }
+};
+
+/**
+ * Parses a memory size with an optional K, M or G suffix.
+ */
+bool str2mem(std::string& s, uint64_t& mem)
+{
+    char *end = NULL;
+    double m = strtod(s.c_str(), &end);
+    if (end==s.c_str() || m<=0) return false;
+
+    if (*end=='K' || *end=='k') { m *= 1<<10; ++end; }
+    else if (*end=='M' || *end=='m') { m *= 1<<20; ++end; }
+    else if (*end=='G' || *end=='g') { m *= 1<<30; ++end; }
+
+    if (*end!='\0') return false;
+    mem = (uint64_t) m;
+    return true;
+}
+
+//empty BGZF block marking the end of a BGZF file
+#define BGZF_EOF_MARKER "\037\213\010\4\0\0\0\0\0\377\6\0\102\103\2\0\033\0\3\0\0\0\0\0\0\0\0\0"
+#define BGZF_EOF_MARKER_LEN 28
+
+/**
+ * Returns the approximate memory used by a record.
+ */
+size_t bcf_mem_size(bcf1_t *v)
+{
+    return sizeof(bcf1_t) + v->shared.m + v->indiv.m;
 }
 
 class Igor : Program
@@ -52,6 +117,8 @@ class Igor : Program
     std::vector<GenomeInterval> intervals;
     uint32_t sort_window_size;
     std::string sort_mode;
+    uint64_t max_mem;
+    std::string tmp_dir;
     bool print;
 
     ///////
@@ -63,11 +130,22 @@ class Igor : Program
     /////////
     //stats//
     /////////
-    uint32_t no_variants;
+    std::atomic<uint32_t> no_variants;
+    uint32_t no_runs;
 
     /////////
     //tools//
     /////////
+    std::vector<bcf1_t*> pool;
+    std::mutex pool_mutex;
+
+    //for coordinating the contig workers under chrom mode
+    std::vector<std::string> contigs;
+    std::vector<std::string> part_file_names;
+    std::atomic<uint32_t> next_contig;
+    std::vector<bool> contig_done;
+    std::mutex contig_mutex;
+    std::condition_variable contig_cv;
 
     Igor(int argc, char **argv)
     {
@@ -87,6 +165,9 @@ class Igor : Program
             TCLAP::ValueArg<uint32_t> arg_sort_window_size("w", "w", "local sorting window size, set by default to 1000 under local mode. [0]", false, 0, "int", cmd);
             TCLAP::ValueArg<std::string> arg_output_vcf_file("o", "o", "output VCF/VCF.GZ/BCF file [-]"
                    , false, "-", "str", cmd);
+            TCLAP::ValueArg<std::string> arg_max_mem("M", "max-mem", "maximum memory for records under full mode, K/M/G suffixes allowed [768M]", false, "768M", "str", cmd);
+            TCLAP::ValueArg<std::string> arg_tmp_dir("T", "tmp-dir", "directory for temporary files, by default beside the output file\n"
+                 "              or in $TMPDIR if the output is the standard output []", false, "", "str", cmd);
             TCLAP::ValueArg<std::string> arg_sort_mode("m", "m", ""
                                "sorting modes. [full]\n"
                  "              local : locally sort within a 1000bp window.  Window size may be set by -w.\n"
@@ -102,6 +183,13 @@ class Igor : Program
             sort_mode = arg_sort_mode.getValue();
             print = arg_print.getValue();
             sort_window_size = arg_sort_window_size.getValue();
+            tmp_dir = arg_tmp_dir.getValue();
+            std::string mem = arg_max_mem.getValue();
+            if (!str2mem(mem, max_mem))
+            {
+                fprintf(stderr, "[%s:%d %s] Invalid memory size : %s\n", __FILE__,__LINE__,__FUNCTION__, mem.c_str());
+                exit(1);
+            }
 
             if (sort_mode=="local")
             {
@@ -137,6 +225,7 @@ class Igor : Program
         //stats initialization//
         ////////////////////////
         no_variants = 0;
+        no_runs = 0;
 
         ///////////////////////
         //tool initialization//
@@ -150,6 +239,7 @@ class Igor : Program
             odr = new BCFOrderedReader(input_vcf_file, intervals);
 
             odw = new BCFOrderedWriter(output_vcf_file, sort_window_size);
+            odw->enable_index();
             odw->link_hdr(odr->hdr);
             odw->write_hdr();
 
@@ -177,6 +267,18 @@ class Igor : Program
             }
 
             odw = new BCFOrderedWriter(output_vcf_file, sort_window_size);
+
+            //contigs are extracted in parallel and concatenated as is
+            int32_t no_threads = get_n_hts_threads();
+            const char* ext = get_part_file_ext(odw->file->format);
+            if (no_threads>1 && ext)
+            {
+                chrom_sort(no_threads, ext);
+                odr->close();
+                return;
+            }
+
+            odw->enable_index();
             odw->link_hdr(odr->hdr);
             odw->write_hdr();
 
@@ -204,142 +306,430 @@ class Igor : Program
         }
         else if (sort_mode=="full")
         {
-            //read into buffer 10000 records
-            odr = new BCFOrderedReader(input_vcf_file, intervals);
+            full_sort();
+        }
+    };
+
+    /**
+     * Gets the extension of part files of the parallel chrom sort for
+     * an output format.  Returns NULL if the output cannot be assembled
+     * by concatenating part files in that format.
+     */
+    const char* get_part_file_ext(htsFormat& format)
+    {
+        if (format.format==text_format)
+        {
+            if (format.compression==no_compression) return ".vcf";
+            if (format.compression==bgzf) return ".vcf.gz";
+        }
+        else if (format.format==binary_format)
+        {
+            if (format.compression==no_compression) return ".ubcf";
+            if (format.compression==bgzf) return ".bcf";
+        }
 
-            //need to change this to measure the amount of data read.  This can be
-            size_t buffer_size = 1000000;
+        return NULL;
+    }
 
-            bcf1_t *buffer[buffer_size];
-            for (size_t i=0; i<buffer_size; ++i)
-            {
-                buffer[i] = bcf_init1();
-            }
+    /**
+     * Extracts the contigs in header order on no_threads worker threads.
+     * Each contig is written to its own part file in the format of the
+     * output, given by ext, and after the header is written to odw, the
+     * part files are appended to its underlying file without recompression.
+     * BGZF EOF markers are dropped from the part files.
+     */
+    void chrom_sort(int32_t no_threads, const char* ext)
+    {
+        bool bgzf = odw->file->format.compression==::bgzf;
 
-            size_t bptr = 0;
-            std::vector<std::string> sorted_file_names;
+        int32_t nseqs = 0;
+        const char** seqs = bcf_hdr_seqnames(odr->hdr, &nseqs);
+        contigs.clear();
+        part_file_names.clear();
+        for (int32_t i=0; i<nseqs; ++i)
+        {
+            contigs.push_back(std::string(seqs[i]));
+            part_file_names.push_back(get_part_file_name(i, ext));
+        }
+        if (seqs) free(seqs);
 
-            bcf1_t *v = buffer[bptr];
-            while (odr->read(v))
+        //header, the records are appended directly to the underlying file
+        odw->link_hdr(odr->hdr);
+        odw->write_hdr();
+        hFILE *out;
+        if (odw->file->is_bin || bgzf)
+        {
+            bgzf_flush(odw->file->fp.bgzf);
+            out = odw->file->fp.bgzf->fp;
+        }
+        else
+        {
+            out = odw->file->fp.hfile;
+        }
+
+        next_contig = 0;
+        contig_done.assign(nseqs, false);
+        std::vector<std::thread> workers;
+        for (int32_t i=0; i<std::min(no_threads, nseqs); ++i)
+        {
+            workers.push_back(std::thread(&Igor::chrom_sort_worker, this));
+        }
+
+        for (int32_t i=0; i<nseqs; ++i)
+        {
             {
-                if (bptr<buffer_size-1)
+                std::unique_lock<std::mutex> lock(contig_mutex);
+                while (!contig_done[i])
                 {
-                    ++bptr;
+                    contig_cv.wait(lock);
                 }
-                else
-                {
-                    ++bptr;
+            }
 
-                    //sort and write out
-                    qsort (buffer, bptr, sizeof(bcf1_t*), bcf_compare);
+            append_part(out, part_file_names[i], bgzf);
+        }
 
-                    kstring_t s = {0,0,0};
-                    if (output_vcf_file!="-")
-                    {
-                        kputs(output_vcf_file.c_str(), &s);
-                        kputs(".", &s);
-                    }
-                    kputw(sorted_file_names.size()+1, &s);
-                    kputs(".bcf", &s);
-                    std::string file_name(s.s);
-                    if (s.m) free(s.s);
-                    sorted_file_names.push_back(file_name);
+        for (size_t i=0; i<workers.size(); ++i)
+        {
+            workers[i].join();
+        }
 
-                    if (sorted_file_names.size()!=1)
-                    {
-                        odw->close();
-                        delete odw;
-                    }
-                    odw = new BCFOrderedWriter(file_name);
-                    odw->link_hdr(odr->hdr);
-                    odw->write_hdr();
+        //a BGZF output is terminated by the EOF marker on closing
+        odw->close();
+        delete odw;
+        odw = NULL;
 
-                    for (size_t i=0; i<bptr; ++i)
-                    {
-                        odw->write(buffer[i]);
-                    }
+        if (bgzf && get_write_index() && output_vcf_file!="-") index_output();
+    }
 
-                    bptr = 0;
-                }
+    /**
+     * Indexes the output of chrom_sort(), the part files are written
+     * without an index as their offsets change on concatenation.
+     */
+    void index_output()
+    {
+        int32_t ret;
+        if (str_ends_with(output_vcf_file, ".bcf"))
+        {
+            ret = bcf_index_build(output_vcf_file.c_str(), 14);
+        }
+        else
+        {
+            tbx_conf_t conf = tbx_conf_vcf;
+            ret = tbx_index_build(output_vcf_file.c_str(), 0, &conf);
+        }
 
-                v = buffer[bptr];
-                ++no_variants;
-            }
+        if (ret)
+        {
+            fprintf(stderr, "[%s:%d %s] Cannot index %s\n", __FILE__,__LINE__,__FUNCTION__, output_vcf_file.c_str());
+        }
+    }
 
-            if (bptr)
-            {
-                qsort (buffer, bptr, sizeof(bcf1_t*), bcf_compare);
+    /**
+     * Worker thread for chrom_sort(), writes contigs to part files without a header.
+     */
+    void chrom_sort_worker()
+    {
+        std::vector<GenomeInterval> no_intervals;
+        BCFOrderedReader *odr = new BCFOrderedReader(input_vcf_file, no_intervals);
+        bcf1_t *v = bcf_init1();
 
-                kstring_t s = {0,0,0};
-                if (output_vcf_file!="-")
-                {
-                    kputs(output_vcf_file.c_str(), &s);
-                    kputs(".", &s);
-                }
-                kputw(sorted_file_names.size()+1, &s);
-                kputs(".bcf", &s);
-                std::string file_name(s.s);
-                if (s.m) free(s.s);
-                sorted_file_names.push_back(file_name);
+        uint32_t i;
+        while ((i = next_contig++) < contigs.size())
+        {
+            BCFOrderedWriter *odw = new BCFOrderedWriter(part_file_names[i], sort_window_size);
+            odw->link_hdr(odr->hdr);
 
-                if (sorted_file_names.size()!=1)
+            GenomeInterval interval(contigs[i]);
+            if (odr->jump_to_interval(interval))
+            {
+                while (odr->read(v))
                 {
-                    odw->close();
-                    delete odw;
+                    odw->write(v);
+                    if (sort_window_size) v = bcf_init1();
+                    ++no_variants;
                 }
-                odw = new BCFOrderedWriter(file_name);
-                odw->link_hdr(odr->hdr);
-                odw->write_hdr();
+            }
 
-                for (size_t i=0; i<bptr; ++i)
-                {
-                    odw->write(buffer[i]);
-                }
+            odw->close();
+            delete odw;
+
+            std::unique_lock<std::mutex> lock(contig_mutex);
+            contig_done[i] = true;
+            contig_cv.notify_all();
+        }
+
+        bcf_destroy(v);
+        odr->close();
+        delete odr;
+    }
 
-                odw->close();
-                delete odw;
+    /**
+     * Appends a part file to the output and removes it.
+     * The EOF marker of a BGZF part file is dropped.
+     */
+    void append_part(hFILE *out, std::string& part_file_name, bool bgzf)
+    {
+        FILE *in = fopen(part_file_name.c_str(), "rb");
+        if (!in)
+        {
+            fprintf(stderr, "[%s:%d %s] Cannot open %s\n", __FILE__,__LINE__,__FUNCTION__, part_file_name.c_str());
+            exit(1);
+        }
 
-                bptr = 0;
+        fseek(in, 0, SEEK_END);
+        long len = ftell(in);
+        if (bgzf && len>=BGZF_EOF_MARKER_LEN)
+        {
+            char eof[BGZF_EOF_MARKER_LEN];
+            fseek(in, len-BGZF_EOF_MARKER_LEN, SEEK_SET);
+            if (fread(eof, 1, BGZF_EOF_MARKER_LEN, in)==BGZF_EOF_MARKER_LEN &&
+                !memcmp(eof, BGZF_EOF_MARKER, BGZF_EOF_MARKER_LEN))
+            {
+                len -= BGZF_EOF_MARKER_LEN;
             }
+        }
+        fseek(in, 0, SEEK_SET);
 
-            //merge records from temporary files
-            intervals.clear();
-            BCFSyncedReader sr(sorted_file_names, intervals);
+        char buf[1<<16];
+        while (len>0)
+        {
+            size_t n = fread(buf, 1, std::min((long) sizeof(buf), len), in);
+            if (n==0 || hwrite(out, buf, n)!=n)
+            {
+                fprintf(stderr, "[%s:%d %s] Cannot append %s\n", __FILE__,__LINE__,__FUNCTION__, part_file_name.c_str());
+                exit(1);
+            }
+            len -= n;
+        }
 
-            std::vector<bcfptr*> current_recs;
-            odw = new BCFOrderedWriter(output_vcf_file);
-            odw->link_hdr(odr->hdr);
-            odw->write_hdr();
+        fclose(in);
+        std::remove(part_file_name.c_str());
+    }
+
+    /**
+     * Sorts the input in runs that fit into the memory budget.  Each run
+     * is sorted and spilled to a temporary file on a background thread
+     * while the next run is read, the runs are then merged.  If the
+     * input fits into a single run, it is written out directly.
+     */
+    void full_sort()
+    {
+        odr = new BCFOrderedReader(input_vcf_file, intervals);
+
+        //with n threads, the reader fills one run while up to n-1 runs are sorted and spilled
+        int32_t no_threads = get_n_hts_threads();
+        uint64_t run_mem = std::max(max_mem/no_threads, (uint64_t) 1);
+        std::list<std::thread> sorters;
+
+        std::vector<std::string> run_file_names;
+        std::vector<bcf1_t*>* run = new std::vector<bcf1_t*>();
+        uint64_t mem = 0;
 
-            int32_t no = 0;
-            while(sr.read_next_position(current_recs))
+        bcf1_t *v = get_bcf1_from_pool();
+        while (odr->read(v))
+        {
+            run->push_back(v);
+            mem += bcf_mem_size(v);
+            ++no_variants;
+
+            if (mem>=run_mem)
             {
-                for (size_t i=0; i<current_recs.size(); ++i)
+                std::string run_file_name = get_run_file_name(run_file_names.size());
+                run_file_names.push_back(run_file_name);
+
+                //the header is written here as the reader may still add contigs to it
+                BCFOrderedWriter *rodw = new BCFOrderedWriter(run_file_name, 0, 1);
+                rodw->link_hdr(odr->hdr);
+                rodw->write_hdr();
+
+                if (no_threads==1)
                 {
-                    odw->write(current_recs[i]->v);
+                    sort_and_write_run(run, rodw);
+                }
+                else
+                {
+                    if (sorters.size()==no_threads-1)
+                    {
+                        sorters.front().join();
+                        sorters.pop_front();
+                    }
+                    sorters.push_back(std::thread(&Igor::sort_and_write_run, this, run, rodw));
                 }
 
-                ++no;
+                run = new std::vector<bcf1_t*>();
+                mem = 0;
             }
 
-            sr.close();
+            v = get_bcf1_from_pool();
+        }
+        store_bcf1_into_pool(v);
+
+        while (!sorters.empty())
+        {
+            sorters.front().join();
+            sorters.pop_front();
+        }
+
+        odw = new BCFOrderedWriter(output_vcf_file);
+        odw->enable_index();
+        odw->link_hdr(odr->hdr);
+        odw->write_hdr();
+
+        if (run_file_names.empty())
+        {
+            sort_and_write_run(run, odw);
+            no_runs = 1;
+        }
+        else
+        {
+            if (!run->empty())
+            {
+                std::string run_file_name = get_run_file_name(run_file_names.size());
+                run_file_names.push_back(run_file_name);
 
-            for (size_t i=0; i< sorted_file_names.size(); ++i)
+                BCFOrderedWriter *rodw = new BCFOrderedWriter(run_file_name, 0, 1);
+                rodw->link_hdr(odr->hdr);
+                rodw->write_hdr();
+                sort_and_write_run(run, rodw);
+            }
+            else
             {
-                std::remove(sorted_file_names[i].c_str());
+                delete run;
             }
 
-            odr->close();
+            merge_runs(run_file_names);
+            no_runs = run_file_names.size();
+        }
+
+        odw->close();
+        delete odw;
+        odr->close();
+
+        for (size_t i=0; i<pool.size(); ++i)
+        {
+            bcf_destroy(pool[i]);
+        }
+        pool.clear();
+    };
+
+    /**
+     * Gets the name of the temporary file of a run, numbered from 1.
+     */
+    std::string get_run_file_name(size_t i)
+    {
+        std::stringstream ss;
+        ss << "run." << i+1 << ".bcf";
 
+        return get_tmp_file_name(tmp_dir, output_vcf_file, "vt_sort", ss.str());
+    }
+
+    /**
+     * Gets the name of the temporary file of the part of a contig, numbered from 1.
+     */
+    std::string get_part_file_name(size_t i, const char* ext)
+    {
+        std::stringstream ss;
+        ss << "chrom." << i+1 << ext;
+
+        return get_tmp_file_name(tmp_dir, output_vcf_file, "vt_sort", ss.str());
+    }
+
+    /**
+     * Sorts a run, writes it out and returns its records to the pool.
+     * The header of odw must already be written.
+     */
+    void sort_and_write_run(std::vector<bcf1_t*>* run, BCFOrderedWriter* odw)
+    {
+        std::stable_sort(run->begin(), run->end(), bcf_less);
+
+        for (size_t i=0; i<run->size(); ++i)
+        {
+            odw->write((*run)[i]);
+        }
+
+        if (odw!=this->odw)
+        {
             odw->close();
             delete odw;
+        }
 
-            for (size_t i=0; i<buffer_size; ++i)
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        pool.insert(pool.end(), run->begin(), run->end());
+        delete run;
+    }
+
+    /**
+     * Merges sorted runs into the output file and removes them.
+     */
+    void merge_runs(std::vector<std::string>& run_file_names)
+    {
+        std::vector<GenomeInterval> no_intervals;
+        std::vector<BCFOrderedReader*> rodrs;
+        std::priority_queue<sorted_run_head, std::vector<sorted_run_head>, CompareSortedRunHead> heads;
+
+        for (size_t i=0; i<run_file_names.size(); ++i)
+        {
+            rodrs.push_back(new BCFOrderedReader(run_file_names[i], no_intervals));
+
+            bcf1_t *v = get_bcf1_from_pool();
+            if (rodrs[i]->read(v))
             {
-                bcf_destroy(buffer[i]);
+                heads.push(sorted_run_head(i, v));
+            }
+            else
+            {
+                store_bcf1_into_pool(v);
             }
         }
-    };
+
+        while (!heads.empty())
+        {
+            sorted_run_head head = heads.top();
+            heads.pop();
+            odw->write(head.v);
+
+            if (rodrs[head.run]->read(head.v))
+            {
+                heads.push(sorted_run_head(head.run, head.v));
+            }
+            else
+            {
+                store_bcf1_into_pool(head.v);
+            }
+        }
+
+        for (size_t i=0; i<run_file_names.size(); ++i)
+        {
+            rodrs[i]->close();
+            delete rodrs[i];
+            std::remove(run_file_names[i].c_str());
+        }
+    }
+
+    /**
+     * Gets a record from the pool.
+     */
+    bcf1_t* get_bcf1_from_pool()
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        if (pool.empty())
+        {
+            return bcf_init1();
+        }
+
+        bcf1_t *v = pool.back();
+        pool.pop_back();
+        return v;
+    }
+
+    /**
+     * Returns a record to the pool.
+     */
+    void store_bcf1_into_pool(bcf1_t* v)
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        pool.push_back(v);
+    }
 
     void print_options()
     {
@@ -351,6 +741,11 @@ class Igor : Program
         std::clog << "         [o] output VCF file             " << output_vcf_file << "\n";
         std::clog << "         [w] sort window size            " << sort_window_size << "\n";
         std::clog << "         [m] sorting mode                " << sort_mode << "\n";
+        if (sort_mode=="full")
+        {
+            std::clog << "         [M] maximum memory              " << max_mem << "\n";
+            print_str_op("         [T] temporary directory         ", tmp_dir);
+        }
         std::clog << "         [p] print options and stats     " << (print ? "yes" : "no") << "\n";
         std::clog << "\n";
     }
@@ -361,6 +756,10 @@ class Igor : Program
 
         std::clog << "\n";
         std::clog << "stats: no. variants  : " << no_variants << "\n";
+        if (sort_mode=="full")
+        {
+            std::clog << "       no. runs      : " << no_runs << "\n";
+        }
         std::clog << "\n";
     };
 
@@ -0,0 +1,405 @@
+/* The MIT License
+
+   Copyright (c) 2016 Adrian Tan <atks@umich.edu>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+*/
+
+
+#include "standardize.h"
+
+namespace
+{
+
+class Igor : Program
+{
+    public:
+
+    ///////////
+    //options//
+    ///////////
+    std::string input_vcf_file;
+    std::string output_vcf_file;
+    std::vector<GenomeInterval> intervals;
+    std::string ref_fasta_file;
+    int32_t window_size;
+    // 0 - do not fail at all
+    // 1 - fail on unmasked consistencies
+    // 2 - fail on all consistencies
+    int32_t strict_level;
+    bool print;
+    bool debug;
+
+    ///////
+    //i/o//
+    ///////
+    BCFOrderedReader *odr;
+    BCFOrderedWriter *odw;
+
+    //window for locally sorting normalized records
+    BCFSortWindow *sort_window;
+
+    //sorted records at the current position that are checked for duplicates
+    std::vector<bcf1_t*> position_v;
+    int32_t position_rid;
+    int32_t position_pos1;
+
+    //helper variables
+    kstring_t old_alleles;
+    kstring_t new_alleles;
+    std::vector<bcf1_t*> decomposed_v;
+    std::vector<std::pair<uint64_t, size_t> > fingerprints;
+
+    /////////
+    //stats//
+    /////////
+    uint32_t no_records;
+
+    uint32_t no_unique_variants;
+
+    /////////
+    //tools//
+    /////////
+    VariantManip *vm;
+    MultiallelicsDecomposer *decomposer;
+
+    Igor(int argc, char **argv)
+    {
+        version = "0.5";
+
+        //////////////////////////
+        //options initialization//
+        //////////////////////////
+        try
+        {
+            std::string desc = "decomposes, normalizes and drops duplicate variants in a single pass.\n"
+                               "              Equivalent to vt decompose -s | vt normalize -r | vt uniq.\n";
+
+            TCLAP::CmdLine cmd(desc, ' ', version);
+            VTOutput my; cmd.setOutput(&my);
+            TCLAP::ValueArg<std::string> arg_ref_fasta_file("r", "r", "reference sequence fasta file []", true, "", "str", cmd);
+            TCLAP::ValueArg<std::string> arg_intervals("i", "i", "intervals []", false, "", "str", cmd);
+            TCLAP::ValueArg<std::string> arg_interval_list("I", "I", "file containing list of intervals []", false, "", "file", cmd);
+            TCLAP::ValueArg<int32_t> arg_window_size("w", "w", "window size for local sorting of variants [10000]", false, 10000, "integer", cmd);
+            TCLAP::SwitchArg arg_warn_only("n", "n", "warns but does not exit when REF is inconsistent\n"
+                                       "              with reference sequence for non SNPs [false]", cmd, false);
+            TCLAP::SwitchArg arg_warn_for_masked_only("m", "m", "warns but does not exit when REF is inconsistent\n"
+                                       "              with masked reference sequence for non SNPs.\n"
+                                       "              This overides the -n option [false]", cmd, false);
+            TCLAP::SwitchArg arg_quiet("q", "q", "do not print options and summary [false]", cmd, false);
+            TCLAP::SwitchArg arg_debug("d", "d", "debug [false]", cmd, false);
+            TCLAP::ValueArg<std::string> arg_output_vcf_file("o", "o", "output VCF file [-]", false, "-", "str", cmd);
+            TCLAP::UnlabeledValueArg<std::string> arg_input_vcf_file("<in.vcf>", "input VCF file", true, "","file", cmd);
+
+            cmd.parse(argc, argv);
+
+            input_vcf_file = arg_input_vcf_file.getValue();
+            output_vcf_file = arg_output_vcf_file.getValue();
+            parse_intervals(intervals, arg_interval_list.getValue(), arg_intervals.getValue());
+            print = !arg_quiet.getValue();
+            strict_level = arg_warn_only.getValue() ? 0 : 2;
+            strict_level = arg_warn_for_masked_only.getValue() ? 1 : strict_level;
+            debug = arg_debug.getValue();
+            window_size = arg_window_size.getValue();
+            ref_fasta_file = arg_ref_fasta_file.getValue();
+        }
+        catch (TCLAP::ArgException &e)
+        {
+            std::cerr << "error: " << e.error() << " for arg " << e.argId() << "\n";
+            abort();
+        }
+    };
+
+    void initialize()
+    {
+        //////////////////////
+        //i/o initialization//
+        //////////////////////
+        odr = new BCFOrderedReader(input_vcf_file, intervals);
+        odw = new BCFOrderedWriter(output_vcf_file, 0);
+        odw->enable_index();
+        odw->link_hdr(odr->hdr);
+        bcf_hdr_append(odw->hdr, "##INFO=<ID=OLD_MULTIALLELIC,Number=1,Type=String,Description=\"Original chr:pos:ref:alt encoding\">\n");
+        bcf_hdr_append(odw->hdr, "##INFO=<ID=OLD_VARIANT,Number=.,Type=String,Description=\"Original chr:pos:ref:alt encoding\">\n");
+        odw->write_hdr();
+
+        sort_window = new BCFSortWindow(window_size);
+
+        position_rid = -1;
+        position_pos1 = 0;
+
+        //helper variables
+        old_alleles = {0,0,0};
+        new_alleles = {0,0,0};
+
+        ////////////////////////
+        //stats initialization//
+        ////////////////////////
+        no_records = 0;
+
+        no_unique_variants = 0;
+
+        ////////////////////////
+        //tools initialization//
+        ////////////////////////
+        vm = new VariantManip(ref_fasta_file);
+        vm->set_streaming(true);
+        decomposer = new MultiallelicsDecomposer(odr->hdr, odw->hdr, true);
+    }
+
+    void standardize()
+    {
+        bcf1_t *v = odw->get_bcf1_from_pool();
+
+        while (odr->read(v))
+        {
+            bcf_unpack(v, BCF_UN_INFO);
+            if (debug) bcf_print_liten(odr->hdr, v);
+
+            ++no_records;
+
+            if (decomposer->decompose(v, decomposed_v))
+            {
+                for (size_t i=0; i<decomposed_v.size(); ++i)
+                {
+                    normalize(decomposed_v[i]);
+                    sort(decomposed_v[i]);
+                }
+                decomposed_v.clear();
+            }
+            else
+            {
+                normalize(v);
+                sort(v);
+                v = odw->get_bcf1_from_pool();
+            }
+        }
+
+        odw->store_bcf1_into_pool(v);
+
+        sort(NULL);
+        flush_position();
+
+        odr->close();
+        odw->close();
+    };
+
+    /**
+     * Normalizes a record and updates the stats, as in vt normalize.
+     */
+    void normalize(bcf1_t *v)
+    {
+        bcf_unpack(v, BCF_UN_INFO);
+
+        Variant variant;
+        int32_t type = vm->classify_variant(odw->hdr, v, variant);
+        vm->normalize_record(odw->hdr, v, type, strict_level, &old_alleles, &new_alleles);
+    };
+
+    /**
+     * Places a normalized record into the sorting window and passes on
+     * the records that are sorted, all of them if v is NULL.  The window
+     * takes ownership of the record.
+     */
+    void sort(bcf1_t *v)
+    {
+        bool force = v==NULL;
+        if (!force)
+        {
+            sort_window->insert(odw->hdr, v);
+        }
+
+        while ((v = sort_window->release(force)))
+        {
+            uniq(v);
+        }
+    };
+
+    /**
+     * Collects sorted records by position and writes out the unique
+     * variants of a position once a record at a later position is seen.
+     */
+    void uniq(bcf1_t *v)
+    {
+        int32_t rid = bcf_get_rid(v);
+        int32_t pos1 = bcf_get_pos1(v);
+
+        if (rid!=position_rid || pos1!=position_pos1)
+        {
+            if (rid<position_rid || (rid==position_rid && pos1<position_pos1))
+            {
+                fprintf(stderr, "[E:%s:%d %s] VCF file not in order: %s\n", __FILE__, __LINE__, __FUNCTION__, input_vcf_file.c_str());
+                exit(1);
+            }
+
+            flush_position();
+            position_rid = rid;
+            position_pos1 = pos1;
+        }
+
+        position_v.push_back(v);
+    };
+
+    /**
+     * Writes out the first record of each distinct variant at the current
+     * position, ordered by allele fingerprint as in vt uniq.  The OLD_VARIANT
+     * values of the duplicates are merged into the record written.
+     */
+    void flush_position()
+    {
+        if (position_v.empty())
+        {
+            return;
+        }
+
+        bcf_hdr_t *h = odw->hdr;
+
+        fingerprints.clear();
+        for (size_t i=0; i<position_v.size(); ++i)
+        {
+            fingerprints.push_back(std::make_pair(bcf_alleles_fingerprint(position_v[i]), i));
+        }
+        std::sort(fingerprints.begin(), fingerprints.end());
+
+        char* dst = 0;
+        int32_t ndst = 0;
+        for (size_t i=0; i<fingerprints.size();)
+        {
+            size_t j = i+1;
+            while (j<fingerprints.size() && fingerprints[j].first==fingerprints[i].first)
+            {
+                ++j;
+            }
+
+            bcf1_t *v = position_v[fingerprints[i].second];
+
+            if (j-i>1)
+            {
+                std::map<std::string, uint32_t> ov_map;
+                std::string old_vars;
+                for (size_t k=i; k<j; ++k)
+                {
+                    if (bcf_get_info_string(h, position_v[fingerprints[k].second], "OLD_VARIANT", &dst, &ndst)>0)
+                    {
+                        std::string old_var(dst);
+                        if (ov_map.find(old_var)==ov_map.end())
+                        {
+                            ov_map[old_var] = 1;
+                            if (old_vars!="") old_vars.append(1, ',');
+                            old_vars.append(old_var);
+                        }
+                    }
+                }
+
+                if (old_vars != "")
+                {
+                    //the record is repacked as htslib cannot grow an INFO
+                    //field that was updated before
+                    bcf1_t *nv = bcf_dup(v);
+                    bcf_destroy(v);
+                    position_v[fingerprints[i].second] = v = nv;
+                    bcf_update_info_string(h, v, "OLD_VARIANT", old_vars.c_str());
+                }
+            }
+
+            odw->write(v);
+            ++no_unique_variants;
+
+            i = j;
+        }
+        if (dst!=0) free(dst);
+
+        for (size_t i=0; i<position_v.size(); ++i)
+        {
+            odw->store_bcf1_into_pool(position_v[i]);
+        }
+        position_v.clear();
+    };
+
+    void print_options()
+    {
+        if (!print) return;
+
+        std::clog << "standardize v" << version << "\n";
+        std::clog << "\n";
+        std::clog << "options:     input VCF file                                  " << input_vcf_file << "\n";
+        std::clog << "         [o] output VCF file                                 " << output_vcf_file << "\n";
+        std::clog << "         [w] sorting window size                             " << window_size << "\n";
+        std::clog << "         [m] no fail on masked reference inconsistency       " << (strict_level==1 ? "true" : "false") << "\n";
+        std::clog << "         [n] no fail on reference inconsistency              " << (strict_level==0 ? "true" : "false") << "\n";
+        std::clog << "         [q] quiet                                           " << (!print ? "true" : "false") << "\n";
+        std::clog << "         [d] debug                                           " << (debug ? "true" : "false")  << "\n";
+        std::clog << "         [r] reference FASTA file                            " << ref_fasta_file << "\n";
+        print_int_op("         [i] intervals                                       ", intervals);
+        std::clog << "\n";
+    }
+
+    void print_stats()
+    {
+        if (!print) return;
+
+        NormalizationStats& stats = vm->norm_stats;
+        int32_t no_biallelic_normalized = stats.no_lt+stats.no_rt+stats.no_lt_rt+stats.no_rt_la+stats.no_la;
+        int32_t no_multiallelic_normalized = stats.no_multi_lt+stats.no_multi_rt+stats.no_multi_lt_rt+stats.no_multi_rt_la+stats.no_multi_la;
+        int32_t no_normalized = no_biallelic_normalized + no_multiallelic_normalized;
+
+        std::clog << "\n";
+        std::clog << "stats: decomposition\n";
+        std::clog << "          no. variants                          : " << no_records << "\n";
+        std::clog << "          no. biallelic variants                : " << decomposer->no_biallelic << "\n";
+        std::clog << "          no. multiallelic variants             : " << decomposer->no_multiallelic << "\n";
+        std::clog << "          no. additional biallelics             : " << decomposer->no_additional_biallelic << "\n";
+        std::clog << "\n";
+        std::clog << "       normalization\n";
+        std::clog << "          no. left trimmed                      : " << stats.no_lt << "\n";
+        std::clog << "          no. right trimmed                     : " << stats.no_rt << "\n";
+        std::clog << "          no. left and right trimmed            : " << stats.no_lt_rt << "\n";
+        std::clog << "          no. right trimmed and left aligned    : " << stats.no_rt_la << "\n";
+        std::clog << "          no. left aligned                      : " << stats.no_la << "\n";
+        std::clog << "          no. multiallelic normalized           : " << no_multiallelic_normalized << "\n";
+        std::clog << "\n";
+        std::clog << "       total no. variants normalized            : " << no_normalized << "\n";
+        std::clog << "       total no. variants observed              : " << stats.no_variants << "\n";
+        std::clog << "       total no. reference observed             : " << stats.no_refs << "\n";
+        std::clog << "       total no. unique variants                : " << no_unique_variants << "\n";
+        std::clog << "\n";
+    };
+
+    ~Igor()
+    {
+        delete sort_window;
+        if (old_alleles.m) free(old_alleles.s);
+        if (new_alleles.m) free(new_alleles.s);
+    };
+
+    private:
+};
+
+}
+
+bool standardize(int argc, char ** argv)
+{
+    Igor igor(argc, argv);
+    igor.print_options();
+    igor.initialize();
+    igor.standardize();
+    igor.print_stats();
+
+    return igor.print;
+};
@@ -113,6 +113,7 @@ class Igor : Program
         //////////////////////
         odr = new BCFOrderedReader(input_vcf_file, intervals);
         odw = new BCFOrderedWriter(output_vcf_file);
+        odw->enable_index();
 
         imap = (int32_t*) malloc(sizeof(int32_t)*nsamples);
         odw->link_hdr(bcf_hdr_subset(odr->hdr, nsamples, samples, imap));
@@ -40,6 +40,7 @@ TBXOrderedReader::TBXOrderedReader(std::string& hts_file)
     s = {0, 0, 0};
 
     hts = hts_open(hts_file.c_str(), "r");
+    attach_hts_threads(hts);
 
     index_loaded = false;
     if ((tbx = tbx_index_load(hts_file.c_str())))
@@ -69,6 +70,7 @@ TBXOrderedReader::TBXOrderedReader(std::string& hts_file, std::vector<GenomeInte
     s = {0, 0, 0};
 
     hts = hts_open(hts_file.c_str(), "r");
+    attach_hts_threads(hts);
 
     intervals_present =  intervals.size()!=0;
 
@@ -210,4 +210,389 @@ else
     echo " NOT OK!!!"
 fi
 
-trap "rm -rf ${TMPDIRS}" EXIT KILL TERM INT HUP
\ No newline at end of file
+#-----------------------
+echo "testing decompose of a triallelic variant with copied FORMAT fields"
+#-----------------------
+
+if [ "$1" == "debug" ]; then
+    set -x
+fi
+
+${VT} \
+    decompose \
+    -l \
+    ${CMDDIR}/01_IN_multi.vcf \
+    -o ${TMPDIR}/02_OUT_multi_copy_format.vcf \
+    2>&1 | strip_stderr > ${TMPDIR}/02_OUT_multi_copy_format.stderr
+
+OUT=`diff ${CMDDIR}/02_OUT_multi_copy_format.vcf ${TMPDIR}/02_OUT_multi_copy_format.vcf`
+ERR=`diff ${CMDDIR}/02_OUT_multi_copy_format.stderr ${TMPDIR}/02_OUT_multi_copy_format.stderr`
+
+set +x
+
+echo -n "             output VCF file :"
+if [ "$OUT" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+echo -n "             output logs     :"
+if [ "$ERR" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+#-----------------------
+echo "testing decompose of a triallelic variant with split FORMAT tags"
+#-----------------------
+
+if [ "$1" == "debug" ]; then
+    set -x
+fi
+
+${VT} \
+    decompose \
+    -l -g GT,PL \
+    ${CMDDIR}/01_IN_multi.vcf \
+    -o ${TMPDIR}/03_OUT_multi_split_format_tags.vcf \
+    2>&1 | strip_stderr > ${TMPDIR}/03_OUT_multi_split_format_tags.stderr
+
+OUT=`diff ${CMDDIR}/03_OUT_multi_split_format_tags.vcf ${TMPDIR}/03_OUT_multi_split_format_tags.vcf`
+ERR=`diff ${CMDDIR}/03_OUT_multi_split_format_tags.stderr ${TMPDIR}/03_OUT_multi_split_format_tags.stderr`
+
+set +x
+
+echo -n "             output VCF file :"
+if [ "$OUT" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+echo -n "             output logs     :"
+if [ "$ERR" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+#-----------------------
+echo "testing smart decompose of a triallelic variant with Number=R and Number=G tags"
+#-----------------------
+
+if [ "$1" == "debug" ]; then
+    set -x
+fi
+
+${VT} \
+    decompose \
+    -s \
+    ${CMDDIR}/04_IN_multi_number_rg.vcf \
+    -o ${TMPDIR}/04_OUT_multi_smart.vcf \
+    2>&1 | strip_stderr > ${TMPDIR}/04_OUT_multi_smart.stderr
+
+OUT=`diff ${CMDDIR}/04_OUT_multi_smart.vcf ${TMPDIR}/04_OUT_multi_smart.vcf`
+ERR=`diff ${CMDDIR}/04_OUT_multi_smart.stderr ${TMPDIR}/04_OUT_multi_smart.stderr`
+
+set +x
+
+echo -n "             output VCF file :"
+if [ "$OUT" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+echo -n "             output logs     :"
+if [ "$ERR" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+trap "rm -rf ${TMPDIRS}" EXIT KILL TERM INT HUP
+echo "++++++++++++++++++++++++" >&2
+echo "Tests for vt standardize" >&2
+echo "++++++++++++++++++++++++" >&2
+
+# create temporary directory and ensure cleanup on termination
+CMDDIR=${DIR}/standardize
+TMPDIR=${CMDDIR}/tmp
+mkdir -p ${TMPDIR}
+TMPDIRS+=" $TMPDIR";
+
+#------------------------------------------------------------
+echo "testing standardize against decompose | normalize | uniq"
+#------------------------------------------------------------
+
+if [ "$1" == "debug" ]; then
+    set -x
+fi
+
+${VT} \
+    standardize \
+    ${CMDDIR}/01_IN.vcf \
+    -r ${CMDDIR}/ref.fa \
+    -o ${TMPDIR}/01_OUT.vcf \
+    2>&1 | strip_stderr > ${TMPDIR}/01_OUT.stderr
+
+${VT} decompose -s ${CMDDIR}/01_IN.vcf 2> /dev/null | \
+${VT} normalize -r ${CMDDIR}/ref.fa - 2> /dev/null | \
+${VT} uniq - -o ${TMPDIR}/01_OUT_piped.vcf 2> /dev/null
+
+OUT=`diff ${CMDDIR}/01_OUT.vcf ${TMPDIR}/01_OUT.vcf`
+ERR=`diff ${CMDDIR}/01_OUT.stderr ${TMPDIR}/01_OUT.stderr`
+PIPED=`diff ${TMPDIR}/01_OUT_piped.vcf ${TMPDIR}/01_OUT.vcf`
+
+set +x
+
+echo -n "             output VCF file :"
+if [ "$OUT" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+echo -n "             output logs     :"
+if [ "$ERR" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+echo -n "             piped output    :"
+if [ "$PIPED" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+trap "rm -rf ${TMPDIRS}" EXIT KILL TERM INT HUP
+
+echo "+++++++++++++++++++" >&2
+echo "Tests for vt filter" >&2
+echo "+++++++++++++++++++" >&2
+
+# create temporary directory and ensure cleanup on termination
+CMDDIR=${DIR}/filter
+TMPDIR=${CMDDIR}/tmp
+mkdir -p ${TMPDIR}
+TMPDIRS+=" $TMPDIR";
+
+# Repeats the records of a VCF file, the filter is evaluated per record
+# while profiling the first 10000 records and a batch at a time after.
+repeat_records()
+{
+    awk '/^#/ {print; next} {r[n++]=$0} END {for (i=0; i<2000; ++i) for (j=0; j<n; ++j) print r[j]}' $1
+}
+
+repeat_records ${CMDDIR}/01_IN.vcf > ${TMPDIR}/01_IN_repeated.vcf
+
+# Filters 01_IN.vcf with an expression and compares the records that pass
+# with the expected output, for the single and the repeated records.
+test_filter()
+{
+    NAME=$1
+    FEXP=$2
+
+    echo "testing filter $FEXP"
+
+    if [ "$DEBUG" == "debug" ]; then
+        set -x
+    fi
+
+    ${VT} view -f "${FEXP}" ${CMDDIR}/01_IN.vcf -o ${TMPDIR}/01_OUT_${NAME}.vcf 2> /dev/null
+    ${VT} view -f "${FEXP}" ${TMPDIR}/01_IN_repeated.vcf -o ${TMPDIR}/01_OUT_${NAME}_repeated.vcf 2> /dev/null
+    repeat_records ${CMDDIR}/01_OUT_${NAME}.vcf > ${TMPDIR}/01_OUT_${NAME}_repeated_expected.vcf
+
+    OUT=`diff ${CMDDIR}/01_OUT_${NAME}.vcf ${TMPDIR}/01_OUT_${NAME}.vcf`
+    BATCH=`diff ${TMPDIR}/01_OUT_${NAME}_repeated_expected.vcf ${TMPDIR}/01_OUT_${NAME}_repeated.vcf`
+
+    set +x
+
+    echo -n "             per record      :"
+    if [ "$OUT" == "" ]; then
+        echo " ok"
+    else
+        echo " NOT OK!!!"
+    fi
+
+    echo -n "             batch           :"
+    if [ "$BATCH" == "" ]; then
+        echo " ok"
+    else
+        echo " NOT OK!!!"
+    fi
+}
+
+DEBUG=$1
+
+test_filter count             "COUNT(FMT.GQ>20)>=2"
+test_filter count_not_hom_ref "COUNT(FMT.GT!='0/0')==3"
+test_filter any_hom_alt       "ANY(FMT.GT=='1/1')"
+test_filter any_phased_het    "ANY(FMT.GT==\"0|1\")"
+test_filter any_missing_gt    "ANY(FMT.GT=='./.')"
+test_filter any_haploid_alt   "ANY(FMT.GT=='1')"
+test_filter sum               "SUM(FMT.DP)>=30"
+test_filter mean              "MEAN(FMT.DP)>15"
+test_filter min               "MIN(FMT.GQ)<10"
+test_filter max_float         "MAX(FMT.AB)<0.5"
+test_filter max_and_info      "MAX(FMT.DP)<=12&&N_ALLELE==2"
+
+
+echo "++++++++++++++++++++++" >&2
+echo "Tests for vt ref_cache" >&2
+echo "++++++++++++++++++++++" >&2
+
+# create temporary directory and ensure cleanup on termination
+CMDDIR=${DIR}/ref_cache
+TMPDIR=${CMDDIR}/tmp
+mkdir -p ${TMPDIR}
+TMPDIRS+=" $TMPDIR";
+
+#---------------------------------------------------
+echo "testing normalize with a reference image"
+#---------------------------------------------------
+
+if [ "$1" == "debug" ]; then
+    set -x
+fi
+
+# the image is written next to a copy of the FASTA file and is used in its place
+cp ${CMDDIR}/ref.fa ${TMPDIR}/ref.fa
+${VT} ref_cache ${TMPDIR}/ref.fa -q 2> /dev/null
+
+${VT} \
+    normalize \
+    ${CMDDIR}/01_IN.vcf \
+    -r ${TMPDIR}/ref.fa \
+    -o ${TMPDIR}/01_OUT.vcf \
+    2> /dev/null
+
+OUT=`diff ${CMDDIR}/01_OUT.vcf ${TMPDIR}/01_OUT.vcf`
+IMAGE=`[ -f ${TMPDIR}/ref.fa.vtref ] || echo "no image"`
+
+set +x
+
+echo -n "             output VCF file :"
+if [ "$OUT" == "" ] && [ "$IMAGE" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+#---------------------------------------------------
+echo "testing normalize with a stale reference image"
+#---------------------------------------------------
+
+if [ "$1" == "debug" ]; then
+    set -x
+fi
+
+# 02_ref.fa has the size and sequences of ref.fa but a changed repeat, the
+# image is ignored as the modification time of the FASTA file changed
+cp ${CMDDIR}/02_ref.fa ${TMPDIR}/ref.fa
+touch -d "2001-01-01" ${TMPDIR}/ref.fa
+
+${VT} \
+    normalize \
+    ${CMDDIR}/01_IN.vcf \
+    -r ${TMPDIR}/ref.fa \
+    -o ${TMPDIR}/02_OUT.vcf \
+    2> /dev/null
+
+OUT=`diff ${CMDDIR}/02_OUT.vcf ${TMPDIR}/02_OUT.vcf`
+
+set +x
+
+echo -n "             output VCF file :"
+if [ "$OUT" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+echo "+++++++++++++++++" >&2
+echo "Tests for vt uniq" >&2
+echo "+++++++++++++++++" >&2
+
+# create temporary directory and ensure cleanup on termination
+CMDDIR=${DIR}/uniq
+TMPDIR=${CMDDIR}/tmp
+mkdir -p ${TMPDIR}
+TMPDIRS+=" $TMPDIR";
+
+#-----------------------
+echo "testing uniq --global of non adjacent duplicates"
+#-----------------------
+
+if [ "$1" == "debug" ]; then
+    set -x
+fi
+
+${VT} \
+    uniq \
+    --global \
+    ${CMDDIR}/01_IN.vcf \
+    -o ${TMPDIR}/01_OUT_global.vcf \
+    2>&1 | strip_stderr > ${TMPDIR}/01_OUT_global.stderr
+
+OUT=`diff ${CMDDIR}/01_OUT_global.vcf ${TMPDIR}/01_OUT_global.vcf`
+ERR=`diff ${CMDDIR}/01_OUT_global.stderr ${TMPDIR}/01_OUT_global.stderr`
+
+set +x
+
+echo -n "             output VCF file :"
+if [ "$OUT" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+echo -n "             output logs     :"
+if [ "$ERR" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+# with 2 variants remembered the fingerprints are swapped every 2 variants,
+# duplicates found in the older generation are dropped and the ones that
+# were forgotten are kept
+#-----------------------
+echo "testing uniq --global with few variants remembered"
+#-----------------------
+
+if [ "$1" == "debug" ]; then
+    set -x
+fi
+
+${VT} \
+    uniq \
+    --global -n 2 \
+    ${CMDDIR}/01_IN.vcf \
+    -o ${TMPDIR}/02_OUT_global_swap.vcf \
+    2>&1 | strip_stderr > ${TMPDIR}/02_OUT_global_swap.stderr
+
+OUT=`diff ${CMDDIR}/02_OUT_global_swap.vcf ${TMPDIR}/02_OUT_global_swap.vcf`
+ERR=`diff ${CMDDIR}/02_OUT_global_swap.stderr ${TMPDIR}/02_OUT_global_swap.stderr`
+
+set +x
+
+echo -n "             output VCF file :"
+if [ "$OUT" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+echo -n "             output logs     :"
+if [ "$ERR" == "" ]; then
+    echo " ok"
+else
+    echo " NOT OK!!!"
+fi
+
+trap "rm -rf ${TMPDIRS}" EXIT KILL TERM INT HUP
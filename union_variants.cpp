@@ -107,6 +107,7 @@ class Igor : Program
         sr = new BCFSyncedReader(input_vcf_files, intervals, false);
 
         odw = new BCFOrderedWriter(output_vcf_file, 0);
+        odw->enable_index();
         bcf_hdr_set_version(odw->hdr, "VCFv4.1");
         bcf_hdr_transfer_contigs(sr->hdrs[0], odw->hdr);
         bcf_hdr_append(odw->hdr, "##INFO=<ID=NCENTERS,Number=1,Type=Integer,Description=\"Number of centers with variant evidence.\">");
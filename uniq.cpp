@@ -36,13 +36,21 @@ class Igor : Program
     std::string input_vcf_file;
     std::string output_vcf_file;
     std::vector<GenomeInterval> intervals;
-    
+    bool global;
+    uint32_t max_global_variants;
+
     ///////
     //i/o//
     ///////
     BCFSyncedReader *sr;
+    BCFOrderedReader *odr;
     BCFOrderedWriter *odw;
 
+    //fingerprints of the variants seen in global mode, the older ones
+    //are dropped once the latest reach max_global_variants
+    FingerprintSet *fingerprints;
+    FingerprintSet *old_fingerprints;
+
     std::vector<bcf1_t*> pool;
 
     /////////
@@ -73,12 +81,17 @@ class Igor : Program
             TCLAP::ValueArg<std::string> arg_intervals("i", "i", "intervals []", false, "", "str", cmd);
             TCLAP::ValueArg<std::string> arg_interval_list("I", "I", "file containing list of intervals []", false, "", "file", cmd);
             TCLAP::ValueArg<std::string> arg_output_vcf_file("o", "o", "output VCF file [-]", false, "-", "str", cmd);
+            TCLAP::SwitchArg arg_global("g", "global", "drop duplicates that are not adjacent in an unsorted file,\n"
+                                       "              OLD_VARIANT is not merged [false]", cmd, false);
+            TCLAP::ValueArg<uint32_t> arg_max_global_variants("n", "n", "minimum number of recent variants remembered in global mode [1000000]", false, 1000000, "integer", cmd);
             TCLAP::UnlabeledValueArg<std::string> arg_input_vcf_file("<in.vcf>", "input VCF file", true, "","file", cmd);
 
             cmd.parse(argc, argv);
 
             input_vcf_file = arg_input_vcf_file.getValue();
             output_vcf_file = arg_output_vcf_file.getValue();
+            global = arg_global.getValue();
+            max_global_variants = arg_max_global_variants.getValue();
             parse_intervals(intervals, arg_interval_list.getValue(), arg_intervals.getValue());
         }
         catch (TCLAP::ArgException &e)
@@ -93,12 +106,27 @@ class Igor : Program
         //////////////////////
         //i/o initialization//
         //////////////////////
-        std::vector<std::string> input_vcf_files;
-        input_vcf_files.push_back(input_vcf_file);  
-        sr = new BCFSyncedReader(input_vcf_files, intervals, SYNC_BY_VAR);
-        odw = new BCFOrderedWriter(output_vcf_file, 0);
-        odw->link_hdr(sr->hdrs[0]);
-        odw->write_hdr();
+        if (global)
+        {
+            odr = new BCFOrderedReader(input_vcf_file, intervals);
+            odw = new BCFOrderedWriter(output_vcf_file, 0);
+            odw->enable_index();
+            odw->link_hdr(odr->hdr);
+            odw->write_hdr();
+
+            fingerprints = new FingerprintSet(max_global_variants<<1);
+            old_fingerprints = new FingerprintSet(max_global_variants<<1);
+        }
+        else
+        {
+            std::vector<std::string> input_vcf_files;
+            input_vcf_files.push_back(input_vcf_file);
+            sr = new BCFSyncedReader(input_vcf_files, intervals, SYNC_BY_VAR);
+            odw = new BCFOrderedWriter(output_vcf_file, 0);
+            odw->enable_index();
+            odw->link_hdr(sr->hdrs[0]);
+            odw->write_hdr();
+        }
 
         ////////////////////////
         //stats initialization//
@@ -113,6 +141,12 @@ class Igor : Program
 
     void uniq()
     {
+        if (global)
+        {
+            uniq_global();
+            return;
+        }
+
         std::vector<bcfptr*> crecs;
         while (sr->read_next_position(crecs))
         {
@@ -156,12 +190,51 @@ class Igor : Program
         odw->close();
     };
 
+    /**
+     * Drops variants seen earlier anywhere in the file by their fingerprints.
+     * Memory is bounded by forgetting the variants that were not seen among
+     * the last max_global_variants to max_global_variants*2 variants.
+     */
+    void uniq_global()
+    {
+        bcf1_t *v = bcf_init();
+
+        while (odr->read(v))
+        {
+            uint64_t fingerprint = bcf_variant_fingerprint(v);
+            bool seen = old_fingerprints->contains(fingerprint);
+
+            if (fingerprints->insert(fingerprint) && !seen)
+            {
+                odw->write(v);
+                ++no_unique_variants;
+            }
+
+            if (fingerprints->size()>=max_global_variants)
+            {
+                std::swap(fingerprints, old_fingerprints);
+                fingerprints->clear();
+            }
+
+            ++no_total_variants;
+        }
+
+        bcf_destroy(v);
+        odr->close();
+        odw->close();
+    };
+
     void print_options()
     {
         std::clog << "uniq v" << version << "\n\n";
 
         std::clog << "options:     input VCF file        " << input_vcf_file << "\n";
         std::clog << "         [o] output VCF file       " << output_vcf_file << "\n";
+        if (global)
+        {
+            std::clog << "         [g] global                true\n";
+            std::clog << "         [n] variants remembered   " << max_global_variants << "\n";
+        }
         print_int_op("         [i] intervals             ", intervals);
     }
 
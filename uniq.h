@@ -25,6 +25,7 @@
 #define UNIQ_H
 
 #include "program.h"
+#include "fingerprint_set.h"
 
 void uniq(int argc, char **argv);
 
@@ -175,5 +175,29 @@ bool append_cwd(std::string& path)
     return false;
 };
 
+/**
+ * Gets the name of a temporary file of a program, the process id keeps
+ * the names of concurrent runs apart.  The file is placed in tmp_dir if
+ * given, beside the output file if it is not the standard output and in
+ * $TMPDIR or /tmp otherwise.
+ */
+std::string get_tmp_file_name(std::string tmp_dir, std::string output_file, std::string prefix, std::string suffix)
+{
+    std::stringstream ss;
+    if (tmp_dir!="")
+    {
+        ss << tmp_dir << "/" << prefix << ".";
+    }
+    else if (output_file!="-")
+    {
+        ss << output_file << ".";
+    }
+    else
+    {
+        const char* dir = getenv("TMPDIR");
+        ss << (dir && *dir ? dir : "/tmp") << "/" << prefix << ".";
+    }
+    ss << (int32_t) getpid() << "." << suffix;
 
-
+    return ss.str();
+};
@@ -29,6 +29,7 @@
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <cstdlib>
 #include <cstring>
 #include <vector>
 #include <map>
@@ -68,4 +69,19 @@ bool str2uint32(std::string& s, uint32_t& i);
  */
 bool append_cwd(std::string& path);
 
+/**
+ * Gets the name of a temporary file of a program, the process id keeps
+ * the names of concurrent runs apart.  The file is placed in tmp_dir if
+ * given, beside the output file if it is not the standard output and in
+ * $TMPDIR or /tmp otherwise, e.g.
+ *
+ * tmp_dir/vt_sort.1234.2.bcf
+ * out.vcf.gz.1234.2.bcf
+ * /tmp/vt_sort.1234.2.bcf
+ *
+ * @prefix - prefix of the file name in a temporary directory
+ * @suffix - name of the file within the run
+ */
+std::string get_tmp_file_name(std::string tmp_dir, std::string output_file, std::string prefix, std::string suffix);
+
 #endif
\ No newline at end of file
@@ -30,15 +30,14 @@
  */
 VariantManip::VariantManip(std::string ref_fasta_file)
 {
+    rs = NULL;
+    reference_present = false;
+    norm_seq = {0,0,0};
+    norm_tmp = {0,0,0};
     if (ref_fasta_file!="")
     {
-        fai = fai_load(ref_fasta_file.c_str());
-        if (fai==NULL)
-        {
-            fprintf(stderr, "[%s:%d %s] Cannot load genome index: %s\n", __FILE__, __LINE__, __FUNCTION__, ref_fasta_file.c_str());
-            exit(1);
-        }
-        reference_present = (fai!=NULL);
+        rs = new ReferenceSequence(ref_fasta_file);
+        reference_present = true;
     }
 };
 
@@ -47,7 +46,29 @@ VariantManip::VariantManip(std::string ref_fasta_file)
  */
 VariantManip::VariantManip()
 {
+    rs = NULL;
     reference_present = false;
+    norm_seq = {0,0,0};
+    norm_tmp = {0,0,0};
+}
+
+/**
+ * Destructor.
+ */
+VariantManip::~VariantManip()
+{
+    if (rs) delete rs;
+    if (norm_seq.m) free(norm_seq.s);
+    if (norm_tmp.m) free(norm_tmp.s);
+}
+
+/**
+ * Enables streaming of the reference sequence, for programs
+ * that process records in position sorted order.
+ */
+void VariantManip::set_streaming(bool streaming)
+{
+    if (rs) rs->set_streaming(streaming);
 }
 
 /**
@@ -66,7 +87,7 @@ int32_t VariantManip::is_not_ref_consistent(bcf_hdr_t *h, bcf1_t *v)
     uint32_t rlen = strlen(vcf_ref);
 
     int32_t ref_len = 0;
-    char *ref = faidx_fetch_uc_seq(fai, chrom, pos0, pos0+rlen-1, &ref_len);
+    char *ref = rs->fetch_seq(chrom, pos0+1, pos0+rlen, &ref_len);
     if (!ref)
     {
         fprintf(stderr, "[%s:%d %s] failure to extract base from fasta file: %s:%d-%d\n", __FILE__, __LINE__, __FUNCTION__, chrom, pos0, pos0+rlen-1);
@@ -562,7 +583,7 @@ void VariantManip::right_trim_or_left_extend(std::vector<std::string>& alleles,
             --pos1;
             int ref_len = 0;
 
-            char *ref = faidx_fetch_uc_seq(fai, chrom, pos1-1, pos1-1, &ref_len);
+            char *ref = rs->fetch_seq(chrom, pos1, pos1, &ref_len);
             if (!ref)
             {
                 fprintf(stderr, "[%s:%d %s] failure to extract base from fasta file: %s:%d\n", __FILE__, __LINE__, __FUNCTION__, chrom, pos1-1);
@@ -614,6 +635,301 @@ void VariantManip::left_trim(std::vector<std::string>& alleles, int32_t& pos1, i
     }
 };
 
+namespace
+{
+/**
+ * Returns the length of the common suffix of 2 sequences ending before a and b, up to len bases.
+ */
+int32_t common_suffix_length(const char* a, const char* b, int32_t len)
+{
+    int32_t l = 0;
+#if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+    //the last of 8 bases is the most significant byte of a word
+    for (; l+8<=len; l+=8)
+    {
+        uint64_t x, y;
+        memcpy(&x, a-l-8, 8);
+        memcpy(&y, b-l-8, 8);
+        if (x!=y) return l + (__builtin_clzll(x^y)>>3);
+    }
+#endif
+    while (l<len && a[-l-1]==b[-l-1]) ++l;
+    return l;
+}
+
+/**
+ * Returns the length of the common prefix of 2 sequences, up to len bases.
+ */
+int32_t common_prefix_length(const char* a, const char* b, int32_t len)
+{
+    int32_t l = 0;
+#if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+    //the first of 8 bases is the least significant byte of a word
+    for (; l+8<=len; l+=8)
+    {
+        uint64_t x, y;
+        memcpy(&x, a+l, 8);
+        memcpy(&y, b+l, 8);
+        if (x!=y) return l + (__builtin_ctzll(x^y)>>3);
+    }
+#endif
+    while (l<len && a[l]==b[l]) ++l;
+    return l;
+}
+}
+
+/**
+ * Moves the alleles in the normalization buffer to have
+ * room for at least headroom bases of left extension.
+ */
+void VariantManip::reserve_norm_headroom(int32_t headroom)
+{
+    int32_t n = norm_beg.size();
+    norm_tmp.l = 0;
+    for (int32_t i=0; i<n; ++i)
+    {
+        int32_t len = norm_end[i]-norm_beg[i];
+        ks_resize(&norm_tmp, norm_tmp.l+headroom+len+1);
+        memcpy(norm_tmp.s+norm_tmp.l+headroom, norm_seq.s+norm_beg[i], len);
+        norm_beg[i] = norm_tmp.l+headroom;
+        norm_end[i] = norm_beg[i]+len;
+        norm_tmp.l += headroom+len;
+    }
+
+    kstring_t tmp = norm_seq;
+    norm_seq = norm_tmp;
+    norm_tmp = tmp;
+}
+
+/**
+ * Normalizes the alleles of a variant as right_trim_or_left_extend()
+ * followed by left_trim() without allocating per variant.  The alleles
+ * are trimmed in bulk by comparing 8 bases at a time.
+ *
+ * If the variant changes, returns true with the comma separated
+ * alleles in new_alleles and the position in pos1.
+ */
+bool VariantManip::normalize(bcf1_t *v, const char* chrom, int32_t& pos1, kstring_t *new_alleles,
+                             int32_t& left_extended, int32_t& right_trimmed, int32_t& left_trimmed)
+{
+    left_extended = right_trimmed = left_trimmed = 0;
+
+    int32_t n = bcf_get_n_allele(v);
+    if (n==1) return false;
+
+    char** alleles = bcf_get_allele(v);
+    norm_beg.resize(n);
+    norm_end.resize(n);
+    int32_t headroom = 16;
+    norm_seq.l = 0;
+    for (int32_t i=0; i<n; ++i)
+    {
+        int32_t len = strlen(alleles[i]);
+        ks_resize(&norm_seq, norm_seq.l+headroom+len+1);
+        memcpy(norm_seq.s+norm_seq.l+headroom, alleles[i], len);
+        norm_beg[i] = norm_seq.l+headroom;
+        norm_end[i] = norm_beg[i]+len;
+        norm_seq.l += headroom+len;
+    }
+    char* seq = norm_seq.s;
+    int32_t room = headroom;
+
+    while (true)
+    {
+        //right trim the common suffix, leaving a base at the start of the contig
+        int32_t min_len = norm_end[0]-norm_beg[0];
+        for (int32_t i=1; i<n; ++i)
+        {
+            min_len = std::min(min_len, norm_end[i]-norm_beg[i]);
+        }
+        int32_t trim = pos1<=1 ? min_len-1 : min_len;
+        for (int32_t i=1; i<n && trim>0; ++i)
+        {
+            trim = common_suffix_length(seq+norm_end[0], seq+norm_end[i], trim);
+        }
+
+        if (trim>0)
+        {
+            for (int32_t i=0; i<n; ++i) norm_end[i] -= trim;
+            right_trimmed += trim;
+            min_len -= trim;
+        }
+
+        if (min_len>0 || pos1<=1) break;
+
+        //left extend the emptied alleles
+        if (!room)
+        {
+            reserve_norm_headroom(headroom<<=1);
+            seq = norm_seq.s;
+            room = headroom;
+        }
+
+        --pos1;
+        norm_chrom.assign(chrom);
+        char base = rs->fetch_base(norm_chrom, pos1);
+        for (int32_t i=0; i<n; ++i) seq[--norm_beg[i]] = base;
+        --room;
+        ++left_extended;
+    }
+
+    //left trim the common prefix, leaving a base in each allele
+    int32_t min_len = norm_end[0]-norm_beg[0];
+    for (int32_t i=1; i<n; ++i)
+    {
+        min_len = std::min(min_len, norm_end[i]-norm_beg[i]);
+    }
+    int32_t trim = min_len-1;
+    for (int32_t i=1; i<n && trim>0; ++i)
+    {
+        trim = common_prefix_length(seq+norm_beg[0], seq+norm_beg[i], trim);
+    }
+    if (trim>0)
+    {
+        for (int32_t i=0; i<n; ++i) norm_beg[i] += trim;
+        pos1 += trim;
+        left_trimmed = trim;
+    }
+
+    if (!left_extended && !right_trimmed && !left_trimmed) return false;
+
+    new_alleles->l = 0;
+    for (int32_t i=0; i<n; ++i)
+    {
+        if (i) kputc(',', new_alleles);
+        kputsn(seq+norm_beg[i], norm_end[i]-norm_beg[i], new_alleles);
+    }
+
+    return true;
+}
+
+/**
+ * Normalizes a record of the given type in place as in vt normalize
+ * and counts it in norm_stats.  The original variant is recorded in
+ * the INFO field OLD_VARIANT.  A REF that is inconsistent with the
+ * reference either fails or skips normalization with a warning,
+ * depending on the strict level.
+ *
+ * @strict_level - 0 do not fail, 1 fail on unmasked inconsistencies, 2 fail on all inconsistencies
+ * @old_alleles  - buffer for the original variant
+ * @new_alleles  - buffer for the normalized alleles
+ */
+void VariantManip::normalize_record(bcf_hdr_t *h, bcf1_t *v, int32_t type, int32_t strict_level,
+                                    kstring_t *old_alleles, kstring_t *new_alleles)
+{
+    int32_t left_extended = 0;
+    int32_t left_trimmed = 0;
+    int32_t right_trimmed = 0;
+
+    int32_t is_not_ref_consistent = 0;
+    if (type!=VT_SNP && (is_not_ref_consistent = this->is_not_ref_consistent(h,v)))
+    {
+        if (is_not_ref_consistent > (2-strict_level))
+        {
+            fprintf(stderr, "[%s:%d %s] Normalization not performed due to inconsistent reference sequences. (use -n or -m option to relax this)\n", __FILE__, __LINE__, __FUNCTION__);
+            exit(1);
+        }
+        else
+        {
+            fprintf(stderr, "[%s:%d %s] Normalization skipped due to inconsistent reference sequences\n", __FILE__, __LINE__, __FUNCTION__);
+        }
+    }
+
+    if (!is_not_ref_consistent && !(type&VT_SV) && !(type&VT_VNTR) && !is_normalized(v))
+    {
+        const char* chrom = bcf_get_chrom(h, v);
+        int32_t pos1 = bcf_get_pos1(v);
+
+        for (size_t i=0; i<bcf_get_n_allele(v); ++i)
+        {
+            char *s = bcf_get_alt(v, i);
+            while (*s)
+            {
+                *s = toupper(*s);
+                ++s;
+            }
+        }
+
+        if (normalize(v, chrom, pos1, new_alleles, left_extended, right_trimmed, left_trimmed))
+        {
+            old_alleles->l = 0;
+            bcf_variant2string(h, v, old_alleles);
+            bcf_update_info_string(h, v, "OLD_VARIANT", old_alleles->s);
+
+            bcf_set_pos1(v, pos1);
+            bcf_update_alleles_str(h, v, new_alleles->s);
+
+            if (bcf_get_n_allele(v)==2)
+            {
+                if (left_extended)
+                {
+                    if (right_trimmed>left_extended)
+                    {
+                        ++norm_stats.no_rt_la;
+                    }
+                    else
+                    {
+                        ++norm_stats.no_la;
+                    }
+                }
+                else
+                {
+                    if (left_trimmed && right_trimmed>left_extended)
+                    {
+                        ++norm_stats.no_lt_rt;
+                    }
+                    else if (left_trimmed)
+                    {
+                        ++norm_stats.no_lt;
+                    }
+                    else if (right_trimmed>left_extended)
+                    {
+                        ++norm_stats.no_rt;
+                    }
+                }
+            }
+            else
+            {
+                if (left_extended)
+                {
+                    if (right_trimmed>left_extended)
+                    {
+                        ++norm_stats.no_multi_rt_la;
+                    }
+                    else
+                    {
+                        ++norm_stats.no_multi_la;
+                    }
+                }
+                else
+                {
+                    if (left_trimmed && right_trimmed>left_extended)
+                    {
+                        ++norm_stats.no_multi_lt_rt;
+                    }
+                    else if (left_trimmed)
+                    {
+                        ++norm_stats.no_multi_lt;
+                    }
+                    else if (right_trimmed>left_extended)
+                    {
+                        ++norm_stats.no_multi_rt;
+                    }
+                }
+            }
+        }
+    }
+
+    if (type==VT_REF)
+    {
+        ++norm_stats.no_refs;
+    }
+    else
+    {
+        ++norm_stats.no_variants;
+    }
+}
+
 /**
  * Generates a probing haplotype with flanks around the variant of interest.
  * Flanks are equal length
@@ -648,7 +964,7 @@ void VariantManip::generate_probes(const char* chrom,
         int32_t ref_len;
         while (bases.size()<4 || preamble.size()<min_flank_length)
         {
-            base = faidx_fetch_uc_seq(fai, const_cast<char*>(chrom), pos1-1, pos1-1, &ref_len);
+            base = rs->fetch_seq(chrom, pos1, pos1, &ref_len);
             preamble.append(1,base[0]);
             bases[base[0]] = 1;
             if (ref_len>0) free(base);
@@ -660,7 +976,7 @@ void VariantManip::generate_probes(const char* chrom,
         uint32_t alleleLength = alleles[0].size();
         while (bases.size()<4 || postamble.size()<min_flank_length)
         {
-            base = faidx_fetch_uc_seq(fai, const_cast<char*>(chrom), pos1+alleleLength+i, pos1+alleleLength+i, &ref_len);
+            base = rs->fetch_seq(chrom, pos1+alleleLength+i+1, pos1+alleleLength+i+1, &ref_len);
             postamble.append(1,base[0]);
             bases[base[0]] = 1;
             if (ref_len>0) free(base);
@@ -707,7 +1023,7 @@ void VariantManip::generate_probes(const char* chrom,
         int32_t ref_len = 0;
         while (bases.size()<4 && preamble.size()<min_flank_length)
         {
-            base = faidx_fetch_uc_seq(fai, const_cast<char*>(chrom), pos1-i-1, pos1-i-1, &ref_len);
+            base = rs->fetch_seq(chrom, pos1-i, pos1-i, &ref_len);
             preamble.append(1,base[0]);
             bases[base[0]] = 1;
             ++i;
@@ -756,7 +1072,7 @@ void VariantManip::generate_probes(const char* chrom,
                 {
                     int32_t start1 = (pos1+length-alleles[i].size()+alleles[0].size()-1);
                     int32_t ref_len;
-                    char* base = faidx_fetch_uc_seq(fai, const_cast<char*>(chrom), start1 , start1, &ref_len);
+                    char* base = rs->fetch_seq(chrom, start1+1, start1+1, &ref_len);
                     probes[i].append(1, base[0]);
                     if (ref_len>0) free(base);
                 }
@@ -26,18 +26,78 @@
 
 #include "hts_utils.h"
 #include "hts_utils.h"
+#include "reference_sequence.h"
 #include "variant.h"
 #include "allele.h"
 
+/**
+ * Counts of records by the kind of normalization, see VariantManip::normalize_record().
+ */
+class NormalizationStats
+{
+    public:
+    uint32_t no_variants;
+    uint32_t no_refs;
+
+    uint32_t no_lt;    //# left trimmed
+    uint32_t no_rt;    //# right trimmed
+    uint32_t no_lt_rt; //# left trimmed and right trimmed
+    uint32_t no_rt_la; //# right trimmed and left aligned
+    uint32_t no_la;    //# left aligned
+
+    uint32_t no_multi_lt;    //# left trimmed
+    uint32_t no_multi_rt;    //# right trimmed
+    uint32_t no_multi_lt_rt; //# left trimmed and right trimmed
+    uint32_t no_multi_rt_la; //# right trimmed and left aligned
+    uint32_t no_multi_la;    //# left aligned
+
+    NormalizationStats()
+    {
+        no_variants = no_refs = 0;
+        no_lt = no_rt = no_lt_rt = no_rt_la = no_la = 0;
+        no_multi_lt = no_multi_rt = no_multi_lt_rt = no_multi_rt_la = no_multi_la = 0;
+    };
+
+    /**
+     * Adds the counts of another set of stats.
+     */
+    void add(NormalizationStats& stats)
+    {
+        no_variants += stats.no_variants;
+        no_refs += stats.no_refs;
+        no_lt += stats.no_lt;
+        no_rt += stats.no_rt;
+        no_lt_rt += stats.no_lt_rt;
+        no_rt_la += stats.no_rt_la;
+        no_la += stats.no_la;
+        no_multi_lt += stats.no_multi_lt;
+        no_multi_rt += stats.no_multi_rt;
+        no_multi_lt_rt += stats.no_multi_lt_rt;
+        no_multi_rt_la += stats.no_multi_rt_la;
+        no_multi_la += stats.no_multi_la;
+    };
+};
+
 /**
  * Methods for manipulating variants
  */
 class VariantManip
 {
     public:
-    faidx_t *fai;
+    ReferenceSequence *rs;
     bool reference_present;
 
+    //allele buffers for normalize(), allele i is norm_seq.s[norm_beg[i]..norm_end[i])
+    //with room for left extension before norm_beg[i]
+    kstring_t norm_seq;
+    kstring_t norm_tmp;
+    std::vector<int32_t> norm_beg;
+    std::vector<int32_t> norm_end;
+    std::string norm_chrom;
+
+    //stats of normalize_record()
+    NormalizationStats norm_stats;
+
     /**
      * Constructor.
      *
@@ -50,6 +110,17 @@ class VariantManip
      */
     VariantManip();
 
+    /**
+     * Destructor.
+     */
+    ~VariantManip();
+
+    /**
+     * Enables streaming of the reference sequence, for programs
+     * that process records in position sorted order.
+     */
+    void set_streaming(bool streaming);
+
     /**
      * Classifies variants.
      */
@@ -86,6 +157,31 @@ class VariantManip
      */
     static void left_trim(std::vector<std::string>& alleles, int32_t& pos1, int32_t& left_trimmed);
 
+    /**
+     * Normalizes the alleles of a variant as right_trim_or_left_extend()
+     * followed by left_trim() without allocating per variant.  The alleles
+     * are trimmed in bulk by comparing 8 bases at a time.
+     *
+     * If the variant changes, returns true with the comma separated
+     * alleles in new_alleles and the position in pos1.
+     */
+    bool normalize(bcf1_t *v, const char* chrom, int32_t& pos1, kstring_t *new_alleles,
+                   int32_t& left_extended, int32_t& right_trimmed, int32_t& left_trimmed);
+
+    /**
+     * Normalizes a record of the given type in place as in vt normalize
+     * and counts it in norm_stats.  The original variant is recorded in
+     * the INFO field OLD_VARIANT.  A REF that is inconsistent with the
+     * reference either fails or skips normalization with a warning,
+     * depending on the strict level.
+     *
+     * @strict_level - 0 do not fail, 1 fail on unmasked inconsistencies, 2 fail on all inconsistencies
+     * @old_alleles  - buffer for the original variant
+     * @new_alleles  - buffer for the normalized alleles
+     */
+    void normalize_record(bcf_hdr_t *h, bcf1_t *v, int32_t type, int32_t strict_level,
+                          kstring_t *old_alleles, kstring_t *new_alleles);
+
     /**
      * Generates a probing haplotype with flanks around the variant of interest.
      */
@@ -111,6 +207,11 @@ class VariantManip
                         std::vector<std::string>& alleles,
                         std::vector<std::string>& probes);
 
+    /**
+     * Moves the alleles in the normalization buffer to have
+     * room for at least headroom bases of left extension.
+     */
+    void reserve_norm_headroom(int32_t headroom);
 };
 
 #endif
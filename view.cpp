@@ -142,6 +142,7 @@ class Igor : Program
         
         odr = new BCFOrderedReader(input_vcf_file, intervals);
         odw = new BCFOrderedWriter(output_vcf_file, sort_window_size, compression_level);
+        odw->enable_index();
         if (no_subset_samples==-1)
         {
             odw->link_hdr(odr->hdr);
@@ -181,47 +182,76 @@ class Igor : Program
 
         if (print_header || output_vcf_file != "-") odw->write_hdr();
 
-        bcf1_t *v = odw->get_bcf1_from_pool();
         bcf_hdr_t *h = odr->hdr;
-        Variant variant;
-        
-        while (odr->read(v))
-        {
-//            bcf_print(h,v);
 
-            if (stream_selection)
+        //records are read in batches so that the filter is evaluated a batch at a time
+        std::vector<bcf1_t*> batch(VT_FILTER_BATCH_RECORDS, NULL);
+        std::vector<Variant> variants(VT_FILTER_BATCH_RECORDS);
+        std::vector<bool> pass;
+        bool eof = false;
+
+        while (!eof)
+        {
+            int32_t n = 0;
+            while (n<VT_FILTER_BATCH_RECORDS)
             {
-                bcf_unpack(v, BCF_UN_STR);
-                std::string chrom = bcf_get_chrom(odr->hdr,v);
-                int32_t start1 = bcf_get_pos1(v);
-                int32_t end1 = bcf_get_end1(v);
+                if (!batch[n]) batch[n] = odw->get_bcf1_from_pool();
+                bcf1_t *v = batch[n];
 
-                if (!orom_regions->overlaps_with(chrom, start1-left_window, end1+right_window))
+                if (!odr->read(v))
                 {
-                    continue;
+                    eof = true;
+                    break;
                 }
-            }
 
-            if (filter_exists)
-            {
-                vm->classify_variant(h, v, variant);
-                if (!filter.apply(h, v, &variant, false))
+                if (stream_selection)
                 {
-                    continue;
+                    bcf_unpack(v, BCF_UN_STR);
+                    std::string chrom = bcf_get_chrom(odr->hdr,v);
+                    int32_t start1 = bcf_get_pos1(v);
+                    int32_t end1 = bcf_get_end1(v);
+
+                    if (!orom_regions->overlaps_with(chrom, start1-left_window, end1+right_window))
+                    {
+                        continue;
+                    }
+                }
+
+                if (filter_exists)
+                {
+                    vm->classify_variant(h, v, variants[n]);
                 }
+
+                ++n;
             }
 
-            if (no_subset_samples==0)
+            if (filter_exists)
             {
-                bcf_subset(odw->hdr, v, 0, 0);
-                //maybe add some additional adhoc fixing for BCF files that do not have a complete header.
+                filter.apply(h, &batch[0], &variants[0], n, pass, false);
             }
-            odw->write(v);
-            if (sort_window_size)
+
+            for (int32_t k=0; k<n; ++k)
             {
-                v = odw->get_bcf1_from_pool();
+                if (filter_exists && !pass[k])
+                {
+                    continue;
+                }
+
+                bcf1_t *v = batch[k];
+                if (no_subset_samples==0)
+                {
+                    bcf_subset(odw->hdr, v, 0, 0);
+                    //maybe add some additional adhoc fixing for BCF files that do not have a complete header.
+                }
+                odw->write(v);
+
+                //the writer keeps records that are sorted
+                if (sort_window_size)
+                {
+                    batch[k] = NULL;
+                }
+                ++no_variants;
             }
-            ++no_variants;
         }
 
         odw->close();
@@ -35,6 +35,7 @@ VNTRConsolidator::VNTRConsolidator(std::string& input_vcf_file, std::vector<Geno
     this->output_vcf_file = output_vcf_file;
     odr = new BCFOrderedReader(input_vcf_file, intervals);
     odw = new BCFOrderedWriter(output_vcf_file, 3000);
+    odw->enable_index();
     odw->link_hdr(odr->hdr);
     bcf_hdr_append(odw->hdr, "##FILTER=<ID=shorter_vntr,Description=\"Another VNTR overlaps with this VNTR.\">");
     //to be removed later
@@ -36,6 +36,7 @@ VNTRExtractor::VNTRExtractor(std::string& input_vcf_file, std::vector<GenomeInte
     this->output_vcf_file = output_vcf_file;
     odr = new BCFOrderedReader(input_vcf_file, intervals);
     odw = new BCFOrderedWriter(output_vcf_file, 2*buffer_window_allowance);
+    odw->enable_index();
     odw->link_hdr(odr->hdr);
 
     //for adding empty genotype fields for a VCF file with individual information
@@ -120,7 +120,9 @@ class Igor : Program
         //i/o initialization//
         //////////////////////
         odr = new BCFOrderedReader(input_vcf_file, intervals);
+        if (get_n_hts_threads()>1) odr->enable_prefetch(BCF_UN_INFO);
         odw = new BCFOrderedWriter(output_vcf_file, window_size);
+        odw->enable_index();
         odw->link_hdr(odr->hdr);
         bcf_hdr_append(odw->hdr, "##INFO=<ID=VNTR_OVERLAP_VARIANT,Number=.,Type=String,Description=\"Original chr:pos:ref:alt variant that overlaps with a VNTR\">\n");
         odw->write_hdr();